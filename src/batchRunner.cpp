@@ -0,0 +1,300 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include "batchRunner.h"
+
+// Registers a setting may name instead of an address
+static const struct
+{
+  const char *name;
+  unsigned short address;
+} registerNames[] =
+{
+  { "R0", R0 }, { "R1", R1 }, { "R2", R2 }, { "R3", R3 }, { "R4", R4 }, { "R5", R5 },
+  { "R6", SP }, { "SP", SP }, { "R7", PC }, { "PC", PC }, { "PS", PS }
+};
+
+BatchRunner::BatchRunner()/*{{{*/
+{
+  this->threads = std::thread::hardware_concurrency();
+  this->threads = this->threads ? this->threads : 1;
+  this->translated = false;
+  this->traced = false;
+  this->traceIndexed = false;
+  this->traceCompressed = false;
+  this->tracePolicy = traceBlock;
+  this->traceName = "trace";
+  this->seconds = 0;
+}
+/*}}}*/
+
+// Traced jobs write to name-0001.bin, name-0002.bin and so on
+void BatchRunner::SetTrace(bool enabled, bool indexed, bool compressed, TraceFullPolicy policy, const std::string &name)/*{{{*/
+{
+  this->traced = enabled;
+  this->traceIndexed = indexed;
+  this->traceCompressed = compressed;
+  this->tracePolicy = policy;
+  this->traceName = name;
+}
+/*}}}*/
+
+/*
+ * Reads the job list at path, see batchRunner.h, false with Error() naming
+ * the line if any of it cannot be understood.
+ */
+bool BatchRunner::ReadJobs(const std::string &path)/*{{{*/
+{
+  std::ifstream list(path.c_str());
+  std::string text;
+  unsigned int line = 0;
+
+  if (!list)
+  {
+    this->error = path + ": cannot open the job list";
+    return false;
+  }
+
+  while (std::getline(list, text))
+  {
+    std::stringstream words(text);
+    std::ostringstream where;
+    std::string word;
+    where << path << ":" << ++line;
+
+    if (!(words >> word) || word[0] == '#')
+    {
+      continue;
+    }
+
+    BatchJob job = BatchJob();
+    job.path = word;
+    job.budget = BATCH_BUDGET;
+
+    while (words >> word)
+    {
+      if (word.find('=') != std::string::npos)
+      {
+        if (!this->ParseSetting(word, job, where.str()))
+        {
+          return false;
+        }
+
+        job.variant += job.variant.empty() ? word : " " + word;
+        continue;
+      }
+
+      char *end = NULL;
+      job.budget = std::strtoull(word.c_str(), &end, 10);
+
+      if (*end != '\0' || job.budget == 0 || !job.settings.empty())
+      {
+        this->error = where.str() + ": expected a budget of instructions before the settings, not '" + word + "'";
+        return false;
+      }
+    }
+
+    this->jobs.push_back(job);
+  }
+
+  if (this->jobs.empty())
+  {
+    this->error = path + ": there are no jobs in the list";
+    return false;
+  }
+
+  return true;
+}
+/*}}}*/
+
+// A register name or octal address, = and an octal word
+bool BatchRunner::ParseSetting(const std::string &setting, BatchJob &job, const std::string &where)/*{{{*/
+{
+  std::string name = setting.substr(0, setting.find('='));
+  std::string value = setting.substr(name.size() + 1);
+  unsigned long address = 0x10000;
+  char *end = NULL;
+
+  for (unsigned int i = 0; i < sizeof(registerNames) / sizeof(registerNames[0]); ++i)
+  {
+    if (name == registerNames[i].name)
+    {
+      address = registerNames[i].address;
+    }
+  }
+
+  if (address > 0xFFFF && !name.empty())
+  {
+    address = std::strtoul(name.c_str(), &end, 8);
+    address = (*end != '\0' || (address & 1)) ? 0x10000 : address;
+  }
+
+  unsigned long word = value.empty() ? 0x10000 : std::strtoul(value.c_str(), &end, 8);
+
+  if (address > 0xFFFF || word > 0xFFFF || *end != '\0')
+  {
+    this->error = where + ": '" + setting + "' is not a register or even octal address set to an octal word";
+    return false;
+  }
+
+  job.settings.push_back(std::make_pair(static_cast<unsigned short>(address), static_cast<unsigned short>(word)));
+  return true;
+}
+/*}}}*/
+
+/*
+ * Runs every job to HALT or the end of its budget on the worker threads,
+ * one job per thread at a time.
+ */
+void BatchRunner::Run()/*{{{*/
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  unsigned int workers = this->threads < this->jobs.size() ? this->threads : this->jobs.size();
+  std::vector<std::thread> pool;
+  this->queues.clear();
+
+  for (unsigned int worker = 0; worker < workers; ++worker)
+  {
+    this->queues.emplace_back();
+  }
+
+  for (unsigned int job = 0; job < this->jobs.size(); ++job)
+  {
+    this->queues[job % workers].jobs.push_back(job);
+  }
+
+  for (unsigned int worker = 0; worker < workers; ++worker)
+  {
+    pool.push_back(std::thread([this, worker]()
+    {
+      unsigned int job;
+
+      while (this->NextJob(worker, job))
+      {
+        this->RunJob(job);
+      }
+    }));
+  }
+
+  for (std::vector<std::thread>::iterator worker = pool.begin(); worker != pool.end(); ++worker)
+  {
+    worker->join();
+  }
+
+  this->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+/*}}}*/
+
+// The front of the worker's own queue, or else the back of another's
+bool BatchRunner::NextJob(unsigned int worker, unsigned int &job)/*{{{*/
+{
+  for (unsigned int offset = 0; offset < this->queues.size(); ++offset)
+  {
+    Queue &queue = this->queues[(worker + offset) % this->queues.size()];
+    std::lock_guard<std::mutex> hold(queue.lock);
+
+    if (!queue.jobs.empty())
+    {
+      job = offset == 0 ? queue.jobs.front() : queue.jobs.back();
+      offset == 0 ? queue.jobs.pop_front() : queue.jobs.pop_back();
+      return true;
+    }
+  }
+
+  return false;
+}
+/*}}}*/
+
+void BatchRunner::RunJob(unsigned int number)/*{{{*/
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  BatchJob &job = this->jobs[number];
+  Memory *memory = new Memory();
+  job.loaded = memory->LoadImage(job.path);
+
+  if (!job.loaded)
+  {
+    delete memory;
+    return;
+  }
+
+  char name[16];
+  std::snprintf(name, sizeof(name), "-%04u", number + 1);
+  memory->SetTraceEnabled(this->traced);
+  memory->SetTraceIndexed(this->traceIndexed);
+  memory->SetTraceRing(TRACE_RING_BYTES, this->tracePolicy);
+  memory->SetTraceCompressed(this->traceCompressed);
+  memory->SetTraceName(this->traceName + name);
+  CPU *cpu = new CPU(memory);
+
+  if (this->translated)
+  {
+    cpu->EnableTranslation();
+  }
+
+  // The registers only answer once the CPU has attached them
+  for (unsigned int i = 0; i < job.settings.size(); ++i)
+  {
+    memory->WriteAddress(job.settings[i].first, job.settings[i].second);
+  }
+
+  RunResult result = cpu->Run(job.budget, 0);
+  job.reason = result.reason;
+  job.instructions = result.executed;
+  job.cycles = cpu->Cycles() - memory->InitialCycles();
+
+  for (unsigned int i = 0; i < 8; ++i)
+  {
+    job.registers[i] = memory->ReadAddress(R0 + 4 * i);
+  }
+
+  job.registers[8] = memory->ReadPS();
+
+  // Takes the memory and its trace with it
+  delete cpu;
+  job.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+/*}}}*/
+
+// One line per job in list order, then the totals
+void BatchRunner::PrintSummary() const/*{{{*/
+{
+  unsigned long long instructions = 0;
+  unsigned int halted = 0;
+  unsigned int failed = 0;
+
+  std::printf("%5s %-7s %12s %12s %6s %6s %6s %6s %9s %8s  %s\n", "Job", "Stop", "Instructions", "Cycles", "R0",
+              "R1", "PC", "PS", "Host ms", "MIPS", "Program");
+
+  for (unsigned int number = 0; number < this->jobs.size(); ++number)
+  {
+    const BatchJob &job = this->jobs[number];
+
+    if (!job.loaded)
+    {
+      std::printf("%5u %-7s %12s %12s %6s %6s %6s %6s %9s %8s  %s\n", number + 1, "no load", "-", "-", "-", "-", "-",
+                  "-", "-", "-", job.path.c_str());
+      ++failed;
+      continue;
+    }
+
+    const char *stop = job.reason == StopReason::Halt ? "HALT" : "budget";
+    instructions += job.instructions;
+    halted += job.reason == StopReason::Halt;
+
+    std::printf("%5u %-7s %12llu %12llu %06o %06o %06o %06o %9.3f %8.2f  %s%s%s\n", number + 1, stop,
+                job.instructions, job.cycles, job.registers[0], job.registers[1], job.registers[7],
+                job.registers[8], job.seconds * 1000, job.seconds > 0 ? job.instructions / job.seconds / 1e6 : 0.0,
+                job.path.c_str(), job.variant.empty() ? "" : " ", job.variant.c_str());
+  }
+
+  std::printf("\n%u jobs on %u threads: %u halted, %u ran out of budget, %u did not load\n",
+              static_cast<unsigned int>(this->jobs.size()), static_cast<unsigned int>(this->queues.size()), halted,
+              static_cast<unsigned int>(this->jobs.size()) - halted - failed, failed);
+  std::printf("%llu instructions in %.3f s, %.2f MIPS across all threads\n", instructions, this->seconds,
+              this->seconds > 0 ? instructions / this->seconds / 1e6 : 0.0);
+}
+/*}}}*/
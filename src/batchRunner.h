@@ -0,0 +1,80 @@
+#ifndef BATCHRUNNER_H
+#define BATCHRUNNER_H
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "cpu.h"
+
+// Instructions a job may run when its line gives no budget
+#define BATCH_BUDGET 100000000ULL
+
+// One line of a job list and what became of it
+struct BatchJob
+{
+  std::string path;
+  unsigned long long budget;
+  std::vector<std::pair<unsigned short, unsigned short> > settings;   // Address and word
+  std::string variant;          // The settings as written
+  bool loaded;
+  StopReason reason;
+  unsigned long long instructions;
+  unsigned long long cycles;
+  unsigned short registers[9];  // R0-R7 then PS
+  double seconds;
+};
+
+/*
+ * Runs many simulations at once, each with its own Memory and CPU.  A job
+ * list holds one job per line:
+ *   tests/sort.obj 5000000 R0=100 1000=17
+ * the program file, then optionally the most instructions it may run and
+ * words to store before it starts, registers by name or octal addresses,
+ * the values octal too.  The same program on several lines with different
+ * settings gives variants of it.  Blank lines and lines starting with #
+ * are skipped.
+ *
+ * Each worker thread has a queue of jobs, dealt out in turn.  It takes
+ * from the front of its own and, once that is empty, steals from the back
+ * of another's, so one long job does not hold up the rest of its queue.
+ * Traced jobs write to files named after the trace name and the number of
+ * the job.
+ */
+class BatchRunner
+{
+  public:
+    BatchRunner();
+    bool ReadJobs(const std::string &path);
+    void SetThreads(unsigned int threads) { this->threads = threads ? threads : 1; };
+    void SetTranslated(bool translated) { this->translated = translated; };
+    void SetTrace(bool enabled, bool indexed, bool compressed, TraceFullPolicy policy, const std::string &name);
+    void Run();
+    void PrintSummary() const;
+    unsigned int Jobs() const { return jobs.size(); };
+    const std::string &Error() const { return error; };
+
+  private:
+    struct Queue
+    {
+      std::mutex lock;
+      std::deque<unsigned int> jobs;
+    };
+
+    bool ParseSetting(const std::string &setting, BatchJob &job, const std::string &where);
+    bool NextJob(unsigned int worker, unsigned int &job);
+    void RunJob(unsigned int number);
+    std::vector<BatchJob> jobs;
+    std::deque<Queue> queues;   // One per worker
+    std::string error;
+    unsigned int threads;
+    bool translated;
+    bool traced;
+    bool traceIndexed;
+    bool traceCompressed;
+    TraceFullPolicy tracePolicy;
+    std::string traceName;
+    double seconds;             // Of the whole batch
+};
+#endif // BATCHRUNNER_H
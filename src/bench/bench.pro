@@ -0,0 +1,21 @@
+# Console benchmarks of the simulator core, no Qt needed
+TEMPLATE = app
+TARGET = enginebench
+CONFIG += console thread
+CONFIG -= qt app_bundle
+
+QMAKE_CXXFLAGS += -g -std=gnu++11 -Wall -Wpedantic
+LIBS += -lz
+
+HEADERS += ../cpu.h \
+    ../imageLoader.h \
+    ../memory.h \
+    ../snapshot.h \
+    ../traceWriter.h \
+    ../translator.h
+SOURCES += engineBench.cpp \
+    ../cpu.cpp \
+    ../imageLoader.cpp \
+    ../memory.cpp \
+    ../traceWriter.cpp \
+    ../translator.cpp
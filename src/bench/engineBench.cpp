@@ -0,0 +1,154 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "../cpu.h"
+
+/******************************************************************************
+ *
+ *                        PDP 11/20 ENGINE BENCHMARK
+ *
+ *****************************************************************************/
+
+// Written by the traced runs and removed at the end
+#define TRACE_NAME "enginebench"
+
+enum Engine
+{
+  engineRun,                    // CPU::Run(), the batch engine
+  engineFDE,                    // CPU::FDE() called once per instruction
+  engineTranslated              // CPU::Run() with translation on, traced runs stay interpreted
+};
+
+void PrintUsage()
+{
+  std::cout << "Usage: enginebench {OPTIONAL}<-r runs> {REQUIRED}<program file>" << std::endl;
+  std::cout << "  -r  runs of each engine, the best one counts, default 10" << std::endl;
+  std::cout << "Runs the program to HALT under Run(), FDE() and Run() translating, with and without a trace," << std::endl;
+  std::cout << "  and prints guest instructions per second for each, what leaving the trace out gains" << std::endl;
+  std::cout << "  and what translating gains over interpreting" << std::endl;
+}
+
+/*
+ * One run from a freshly loaded program, loading is not timed.  Returns
+ * the seconds taken and the instructions executed, 0 if it did not load.
+ */
+double TimeRun(const std::string &path, Engine engine, bool traced, unsigned long long &instructions)/*{{{*/
+{
+  Memory *memory = new Memory();
+
+  if (!memory->LoadImage(path))
+  {
+    delete memory;
+    return 0;
+  }
+
+  memory->SetTraceEnabled(traced);
+  memory->SetTraceName(TRACE_NAME);
+  CPU *cpu = new CPU(memory);
+
+  if (engine == engineTranslated)
+  {
+    cpu->EnableTranslation();
+  }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  if (engine != engineFDE)
+  {
+    cpu->Run(UNLIMITED_BUDGET, 0);
+  }
+
+  else
+  {
+    while (cpu->FDE() > 0)
+    {
+    }
+  }
+
+  // The trace is only done once the writer thread has it all on disk
+  memory->CloseTrace();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  instructions = cpu->InstructionCount();
+  delete cpu;
+  return seconds;
+}
+/*}}}*/
+
+/******************************************************************************
+ *
+ *                                BEGIN MAIN
+ *
+ *****************************************************************************/
+int main(int argc, char *argv[])
+{
+  unsigned int runs = 10;
+  std::string path;
+
+  //Parse command line arguments/*{{{*/
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string arg = argv[i];
+
+    if (arg == "-r" && i + 1 < argc)
+    {
+      runs = std::atoi(argv[++i]);
+    }
+
+    else if (path.empty() && arg[0] != '-')
+    {
+      path = arg;
+    }
+
+    else
+    {
+      PrintUsage();
+      return 0;
+    }
+  }
+
+  if (path.empty() || runs == 0)
+  {
+    PrintUsage();
+    return 0;
+  }
+  /*}}}*/
+
+  static const char *names[] = { "Run()", "FDE()", "Run() -j" };
+  double mips[3][2];
+
+  std::printf("%s, best of %u runs\n\n", path.c_str(), runs);
+  std::printf("%-9s %-9s %14s %10s %10s\n", "Engine", "Trace", "Instructions", "Best ms", "MIPS");
+
+  for (int engine = engineRun; engine <= engineTranslated; ++engine)
+  {
+    for (int traced = 1; traced >= 0; --traced)
+    {
+      unsigned long long instructions = 0;
+      double best = 0;
+
+      for (unsigned int run = 0; run < runs; ++run)
+      {
+        double seconds = TimeRun(path, static_cast<Engine>(engine), traced, instructions);
+
+        if (seconds == 0)
+        {
+          return -2;
+        }
+
+        best = (run == 0 || seconds < best) ? seconds : best;
+      }
+
+      mips[engine][traced] = instructions / best / 1e6;
+      std::printf("%-9s %-9s %14llu %10.3f %10.2f\n", names[engine], traced ? "traced" : "untraced", instructions,
+                  best * 1000, mips[engine][traced]);
+    }
+  }
+
+  std::printf("\nUntraced speedup: Run() %.2fx, FDE() %.2fx\n", mips[engineRun][0] / mips[engineRun][1],
+              mips[engineFDE][0] / mips[engineFDE][1]);
+  std::printf("Translated over interpreted, untraced Run(): %.2fx\n", mips[engineTranslated][0] / mips[engineRun][0]);
+  std::remove(TRACE_NAME ".bin");
+  return 0;
+}
@@ -0,0 +1,139 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "../cpu.h"
+
+/******************************************************************************
+ *
+ *                     PDP 11/20 OPERAND FETCH BENCHMARK
+ *
+ *****************************************************************************/
+
+// Every pointer the modes follow lands in RAM filled with this word
+#define FILL_START 010000U
+#define FILL_END 060000U
+#define FILL_WORD 020000U
+
+// Fetches between putting R1 and the PC back, so the stepping modes stay in the fill
+#define RESET_EVERY 256
+
+// The specifiers timed, R1 for the general modes and the PC for its own four
+static const struct
+{
+  unsigned short spec;
+  const char *name;
+} modes[] =
+{
+  { 001, "R1" }, { 011, "(R1)" }, { 021, "(R1)+" }, { 031, "@(R1)+" }, { 041, "-(R1)" }, { 051, "@-(R1)" },
+  { 061, "X(R1)" }, { 071, "@X(R1)" }, { 027, "#n" }, { 037, "@#n" }, { 067, "X(PC)" }, { 077, "@X(PC)" }
+};
+
+void PrintUsage()
+{
+  std::cout << "Usage: operandbench {OPTIONAL}<-n fetches>" << std::endl;
+  std::cout << "  -n  fetches timed for each mode and width, default 10000000" << std::endl;
+  std::cout << "Times the operand reader the decoder picks for each addressing mode, trace off, and prints" << std::endl;
+  std::cout << "  nanoseconds per fetch for word and byte operands" << std::endl;
+}
+
+/*
+ * Calls the reader for spec fetches times through the same pointer to
+ * member the decoded instruction holds.  Returns nanoseconds per fetch,
+ * or a negative number if a fetch trapped: the core steps byte @(R1)+
+ * and @-(R1) by one, so their second pointer is at an odd address.
+ */
+double TimeReader(Memory *memory, unsigned short spec, Width width, unsigned long fetches)/*{{{*/
+{
+  OperandReader reader = memory->Reader(spec, width);
+  volatile unsigned short sink = 0;
+  unsigned short sum = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  try
+  {
+    for (unsigned long done = 0; done < fetches; done += RESET_EVERY)
+    {
+      memory->WriteAddress(R1, FILL_WORD);
+      memory->WriteAddress(PC, FILL_WORD);
+
+      for (int i = 0; i < RESET_EVERY; ++i)
+      {
+        sum += (memory->*reader)();
+      }
+    }
+  }
+
+  catch (const MemoryAbort &error)
+  {
+    return -1;
+  }
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  sink = sum;
+  (void) sink;
+  return seconds * 1e9 / fetches;
+}
+/*}}}*/
+
+/******************************************************************************
+ *
+ *                                BEGIN MAIN
+ *
+ *****************************************************************************/
+int main(int argc, char *argv[])
+{
+  unsigned long fetches = 10000000;
+
+  //Parse command line arguments/*{{{*/
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string arg = argv[i];
+
+    if (arg == "-n" && i + 1 < argc)
+    {
+      fetches = std::strtoul(argv[++i], NULL, 10);
+    }
+
+    else
+    {
+      PrintUsage();
+      return 0;
+    }
+  }
+
+  if (fetches < RESET_EVERY)
+  {
+    PrintUsage();
+    return 0;
+  }
+  /*}}}*/
+
+  // Rounded to whole resets so every fetch counted is one made
+  fetches -= fetches % RESET_EVERY;
+  Memory *memory = new Memory();
+  memory->SetTraceEnabled(false);
+  CPU *cpu = new CPU(memory);
+
+  for (unsigned short address = FILL_START; address < FILL_END; address += 2)
+  {
+    memory->WriteAddress(address, FILL_WORD);
+  }
+
+  std::printf("%lu fetches per mode, trace off\n\n", fetches);
+  std::printf("%-6s %-8s %10s %10s\n", "Spec", "Mode", "Word ns", "Byte ns");
+
+  for (unsigned int i = 0; i < sizeof(modes) / sizeof(modes[0]); ++i)
+  {
+    double word = TimeReader(memory, modes[i].spec, wordWidth, fetches);
+    double byte = TimeReader(memory, modes[i].spec, byteWidth, fetches);
+    std::printf("%02o     %-8s ", modes[i].spec, modes[i].name);
+    word < 0 ? std::printf("%10s ", "traps") : std::printf("%10.2f ", word);
+    byte < 0 ? std::printf("%10s\n", "traps") : std::printf("%10.2f\n", byte);
+  }
+
+  // Takes the memory with it
+  delete cpu;
+  return 0;
+}
@@ -0,0 +1,424 @@
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include "cacheSimulator.h"
+
+// Records read from the trace per batch
+#define BATCH (1U << 22)
+
+// Transaction::write in memory.h
+#define WRITE 1
+
+// Empty line in a set
+#define INVALID 0xFFFFFFFFU
+
+static unsigned int Log2(unsigned int value)
+{
+  unsigned int shift = 0;
+
+  while ((1U << shift) < value)
+  {
+    ++shift;
+  }
+
+  return shift;
+}
+
+// A share of the configurations, run over every batch in turn
+class CacheJob
+{
+  public:
+    virtual ~CacheJob() {};
+    virtual void Simulate(const TraceAccess *accesses, unsigned int count) = 0;
+};
+
+/*
+ * One configuration, simulated line by line.  Each line keeps the time it
+ * was last used for LRU or filled for FIFO, the oldest in a set is the one
+ * replaced.
+ */
+class DirectCache : public CacheJob/*{{{*/
+{
+  public:
+    DirectCache(const CacheConfig &config, CacheResult &result);
+    void Simulate(const TraceAccess *accesses, unsigned int count);
+
+  private:
+    CacheConfig config;
+    CacheResult &result;
+    unsigned int lineShift;
+    unsigned int setMask;
+    std::vector<unsigned int> tags;     // [set * ways + way]
+    std::vector<unsigned long long> stamps;
+    std::vector<bool> dirty;
+    unsigned long long clock;
+    unsigned int random;
+};
+
+DirectCache::DirectCache(const CacheConfig &config, CacheResult &result) : result(result)
+{
+  unsigned int sets = config.size / (config.lineBytes * config.ways);
+  this->config = config;
+  this->lineShift = Log2(config.lineBytes);
+  this->setMask = sets - 1;
+  this->tags.assign(sets * config.ways, INVALID);
+  this->stamps.assign(sets * config.ways, 0);
+  this->dirty.assign(sets * config.ways, false);
+  this->clock = 0;
+  this->random = 2463534242U;
+}
+
+void DirectCache::Simulate(const TraceAccess *accesses, unsigned int count)
+{
+  unsigned int ways = this->config.ways;
+
+  for (const TraceAccess *access = accesses; access < accesses + count; ++access)
+  {
+    unsigned int line = access->address >> this->lineShift;
+    unsigned int base = (line & this->setMask) * ways;
+    unsigned int way = 0;
+    ++this->clock;
+    ++this->result.accesses[access->type];
+
+    if (access->type == WRITE && this->config.write != writeBack)
+    {
+      ++this->result.writeThroughs;
+    }
+
+    while (way < ways && this->tags[base + way] != line)
+    {
+      ++way;
+    }
+
+    if (way < ways)
+    {
+      if (this->config.replacement == replaceLRU)
+      {
+        this->stamps[base + way] = this->clock;
+      }
+
+      if (access->type == WRITE && this->config.write == writeBack)
+      {
+        this->dirty[base + way] = true;
+      }
+
+      continue;
+    }
+
+    ++this->result.misses[access->type];
+
+    if (access->type == WRITE && this->config.write == writeThroughNoAllocate)
+    {
+      continue;
+    }
+
+    // Fill an empty line if there is one, otherwise evict
+    unsigned int victim = 0;
+
+    for (way = 0; way < ways; ++way)
+    {
+      if (this->tags[base + way] == INVALID)
+      {
+        victim = way;
+        break;
+      }
+
+      if (this->stamps[base + way] < this->stamps[base + victim])
+      {
+        victim = way;
+      }
+    }
+
+    if (way == ways && this->config.replacement == replaceRandom)
+    {
+      this->random ^= this->random << 13;
+      this->random ^= this->random >> 17;
+      this->random ^= this->random << 5;
+      victim = this->random % ways;
+    }
+
+    if (this->dirty[base + victim])
+    {
+      ++this->result.writeBacks;
+    }
+
+    ++this->result.lineFills;
+    this->tags[base + victim] = line;
+    this->stamps[base + victim] = this->clock;
+    this->dirty[base + victim] = access->type == WRITE && this->config.write == writeBack;
+  }
+}
+/*}}}*/
+
+/*
+ * Every LRU write-allocate configuration with one line size and number of
+ * sets, from a single LRU stack per set (Mattson et al.).  An access found
+ * at depth d in its set's stack hits in every cache of more than d ways
+ * and misses in the rest, so one histogram of depths gives the misses for
+ * all of them.  Write-backs come out of the same pass: each stack entry
+ * records the depth below which it is clean, and an entry pushed from
+ * depth n - 1 to n is what an n-way cache evicts.
+ */
+class StackGroup : public CacheJob/*{{{*/
+{
+  public:
+    StackGroup(unsigned int lineBytes, unsigned int sets);
+    void Add(unsigned int ways, CacheResult *result, WritePolicy write);
+    void Simulate(const TraceAccess *accesses, unsigned int count);
+    void Finish();
+
+  private:
+    struct Entry
+    {
+      unsigned int line;
+      unsigned int cleanWays;   // Dirty only in caches of more ways than this
+    };
+
+    struct Member
+    {
+      unsigned int ways;
+      CacheResult *result;
+      WritePolicy write;
+    };
+
+    unsigned int lineShift;
+    unsigned int setMask;
+    unsigned int depth;         // Most ways of any member
+    std::vector<std::vector<Entry> > stacks;
+    std::vector<Member> members;
+    std::vector<unsigned long long> hits[3];    // By type and depth
+    std::vector<unsigned long long> writeBacks; // By ways
+    unsigned long long accesses[3];
+};
+
+StackGroup::StackGroup(unsigned int lineBytes, unsigned int sets)
+{
+  this->lineShift = Log2(lineBytes);
+  this->setMask = sets - 1;
+  this->depth = 0;
+  this->stacks.resize(sets);
+  std::memset(this->accesses, 0, sizeof(this->accesses));
+}
+
+void StackGroup::Add(unsigned int ways, CacheResult *result, WritePolicy write)
+{
+  Member member = { ways, result, write };
+  this->members.push_back(member);
+
+  if (ways > this->depth)
+  {
+    this->depth = ways;
+
+    for (int type = 0; type < 3; ++type)
+    {
+      this->hits[type].resize(ways, 0);
+    }
+
+    this->writeBacks.resize(ways + 1, 0);
+  }
+}
+
+void StackGroup::Simulate(const TraceAccess *accesses, unsigned int count)
+{
+  for (const TraceAccess *access = accesses; access < accesses + count; ++access)
+  {
+    unsigned int line = access->address >> this->lineShift;
+    std::vector<Entry> &stack = this->stacks[line & this->setMask];
+    unsigned int found = 0;
+    ++this->accesses[access->type];
+
+    while (found < stack.size() && stack[found].line != line)
+    {
+      ++found;
+    }
+
+    Entry entry = { line, INVALID };
+
+    if (found < stack.size())
+    {
+      ++this->hits[access->type][found];
+      entry = stack[found];
+
+      // Caches of up to found ways missed and load the line clean
+      if (entry.cleanWays < found)
+      {
+        entry.cleanWays = found;
+      }
+    }
+
+    else if (stack.size() < this->depth)
+    {
+      stack.push_back(entry);
+    }
+
+    else
+    {
+      // The bottom entry drops out of the largest cache
+      if (stack[found - 1].cleanWays < this->depth)
+      {
+        ++this->writeBacks[this->depth];
+      }
+
+      --found;
+    }
+
+    if (access->type == WRITE)
+    {
+      entry.cleanWays = 0;
+    }
+
+    // Everything above moves down one, out of the cache with that many ways
+    for (unsigned int position = found; position > 0; --position)
+    {
+      stack[position] = stack[position - 1];
+
+      if (position > stack[position].cleanWays)
+      {
+        ++this->writeBacks[position];
+      }
+    }
+
+    stack[0] = entry;
+  }
+}
+
+// Hands each member its share of the histogram
+void StackGroup::Finish()
+{
+  for (std::vector<Member>::iterator member = this->members.begin(); member != this->members.end(); ++member)
+  {
+    CacheResult &result = *member->result;
+
+    for (int type = 0; type < 3; ++type)
+    {
+      unsigned long long hits = 0;
+
+      for (unsigned int depth = 0; depth < member->ways; ++depth)
+      {
+        hits += this->hits[type][depth];
+      }
+
+      result.accesses[type] = this->accesses[type];
+      result.misses[type] = this->accesses[type] - hits;
+      result.lineFills += result.misses[type];
+    }
+
+    if (member->write == writeBack)
+    {
+      result.writeBacks = this->writeBacks[member->ways];
+    }
+
+    else
+    {
+      result.writeThroughs = this->accesses[WRITE];
+    }
+  }
+}
+/*}}}*/
+
+CacheSimulator::CacheSimulator(const std::vector<CacheConfig> &configs)/*{{{*/
+{
+  this->configs = configs;
+  this->results.resize(configs.size());
+  std::memset(&this->results[0], 0, configs.size() * sizeof(CacheResult));
+  this->stackJobs = 0;
+
+  std::vector<StackGroup *> groups;
+  std::vector<unsigned int> keys;
+
+  for (unsigned int index = 0; index < configs.size(); ++index)
+  {
+    const CacheConfig &config = configs[index];
+
+    if (config.replacement != replaceLRU || config.write == writeThroughNoAllocate)
+    {
+      this->jobs.push_back(new DirectCache(config, this->results[index]));
+      continue;
+    }
+
+    // Grouped on line size and sets, both powers of two
+    unsigned int sets = config.size / (config.lineBytes * config.ways);
+    unsigned int key = (Log2(config.lineBytes) << 16) | Log2(sets);
+    unsigned int group = 0;
+
+    while (group < keys.size() && keys[group] != key)
+    {
+      ++group;
+    }
+
+    if (group == keys.size())
+    {
+      keys.push_back(key);
+      groups.push_back(new StackGroup(config.lineBytes, sets));
+      this->jobs.push_back(groups.back());
+      ++this->stackJobs;
+    }
+
+    groups[group]->Add(config.ways, &this->results[index], config.write);
+  }
+}
+/*}}}*/
+
+CacheSimulator::~CacheSimulator()/*{{{*/
+{
+  for (std::vector<CacheJob *>::iterator job = this->jobs.begin(); job != this->jobs.end(); ++job)
+  {
+    delete *job;
+  }
+}
+/*}}}*/
+
+/*
+ * Reads the whole trace through every configuration, false if reading it
+ * failed part way.  While the workers run through one batch this thread
+ * reads the next.
+ */
+bool CacheSimulator::Run(TraceReader &reader, unsigned int threads)/*{{{*/
+{
+  std::vector<TraceAccess> batches[2];
+  batches[0].resize(BATCH);
+  batches[1].resize(BATCH);
+  unsigned int count = reader.Read(&batches[0][0], BATCH);
+  int current = 0;
+
+  while (count > 0)
+  {
+    std::vector<std::thread> workers;
+    std::atomic<unsigned int> next(0);
+    const TraceAccess *accesses = &batches[current][0];
+
+    for (unsigned int worker = 0; worker < threads; ++worker)
+    {
+      workers.push_back(std::thread([this, accesses, count, &next]()
+      {
+        for (unsigned int job = next++; job < this->jobs.size(); job = next++)
+        {
+          this->jobs[job]->Simulate(accesses, count);
+        }
+      }));
+    }
+
+    current ^= 1;
+    unsigned int following = reader.Read(&batches[current][0], BATCH);
+
+    for (std::vector<std::thread>::iterator worker = workers.begin(); worker != workers.end(); ++worker)
+    {
+      worker->join();
+    }
+
+    count = following;
+  }
+
+  for (std::vector<CacheJob *>::iterator job = this->jobs.begin(); job != this->jobs.end(); ++job)
+  {
+    StackGroup *group = dynamic_cast<StackGroup *>(*job);
+
+    if (group)
+    {
+      group->Finish();
+    }
+  }
+
+  return reader.Error().empty();
+}
+/*}}}*/
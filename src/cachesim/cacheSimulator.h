@@ -0,0 +1,70 @@
+#ifndef CACHESIMULATOR_H
+#define CACHESIMULATOR_H
+
+#include <string>
+#include <vector>
+#include "../traceReader.h"
+
+// Which line a full set gives up
+enum ReplacementPolicy
+{
+  replaceLRU,
+  replaceFIFO,
+  replaceRandom
+};
+
+// What a write does, the first two allocate a line when they miss
+enum WritePolicy
+{
+  writeBack,
+  writeThrough,
+  writeThroughNoAllocate
+};
+
+struct CacheConfig
+{
+  unsigned int size;            // Bytes of data
+  unsigned int ways;
+  unsigned int lineBytes;
+  ReplacementPolicy replacement;
+  WritePolicy write;
+};
+
+// Counts indexed by Transaction: reads, writes and instruction fetches
+struct CacheResult
+{
+  unsigned long long accesses[3];
+  unsigned long long misses[3];
+  unsigned long long lineFills;         // Lines read from memory
+  unsigned long long writeBacks;        // Dirty lines written back on eviction
+  unsigned long long writeThroughs;     // Writes passed straight to memory
+};
+
+class CacheJob;
+
+/*
+ * Runs one trace through any number of cache configurations in a single
+ * pass.  Each batch of records is read once and shared by worker threads,
+ * which take the configurations between them; the next batch is read
+ * while they work.  All LRU write-allocate configurations with the same
+ * line size and number of sets are one job, which finds every one of their
+ * results from the LRU stack distance of each access.  The rest are
+ * simulated one at a time.
+ */
+class CacheSimulator
+{
+  public:
+    CacheSimulator(const std::vector<CacheConfig> &configs);
+    ~CacheSimulator();
+    bool Run(TraceReader &reader, unsigned int threads);
+    const CacheResult &Result(unsigned int config) const { return results[config]; };
+    unsigned int StackJobs() const { return stackJobs; };
+    unsigned int Jobs() const { return jobs.size(); };
+
+  private:
+    std::vector<CacheConfig> configs;
+    std::vector<CacheResult> results;
+    std::vector<CacheJob *> jobs;
+    unsigned int stackJobs;
+};
+#endif // CACHESIMULATOR_H
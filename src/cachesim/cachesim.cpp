@@ -0,0 +1,326 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cacheSimulator.h"
+
+/******************************************************************************
+ *
+ *                        PDP 11/20 TRACE CACHE SIMULATOR
+ *
+ *****************************************************************************/
+
+void PrintUsage()
+{
+  std::cout << "Usage: cachesim {OPTIONAL}<-s sizes> {OPTIONAL}<-a ways> {OPTIONAL}<-l line sizes> {OPTIONAL}<-r replacement> {OPTIONAL}<-w write policies> {OPTIONAL}<-j threads> {REQUIRED}<trace>" << std::endl;
+  std::cout << "  -s  cache sizes in bytes, K for kilobytes, default 1K,2K,4K,8K" << std::endl;
+  std::cout << "  -a  associativities, full for a single set, default 1,2,4,8" << std::endl;
+  std::cout << "  -l  line sizes in bytes, default 8,16,32" << std::endl;
+  std::cout << "  -r  replacement policies out of lru, fifo and random, default lru" << std::endl;
+  std::cout << "  -w  write policies out of wb (write back), wt (write through) and wtna (write through, no allocate), default wb" << std::endl;
+  std::cout << "  -j  worker threads, default one per core" << std::endl;
+  std::cout << "Every combination is simulated in one pass over the trace, which is trace.txt, trace.bin or trace-0000.z" << std::endl;
+}
+
+// Splits a comma separated list
+std::vector<std::string> Split(const std::string &list)/*{{{*/
+{
+  std::vector<std::string> items;
+  std::stringstream stream(list);
+  std::string item;
+
+  while (std::getline(stream, item, ','))
+  {
+    items.push_back(item);
+  }
+
+  return items;
+}
+/*}}}*/
+
+// A positive power of two, 0 for anything else; a K suffix multiplies by 1024
+unsigned int ParseSize(const std::string &text)/*{{{*/
+{
+  char *end = NULL;
+  unsigned long value = std::strtoul(text.c_str(), &end, 10);
+
+  if (end != text.c_str() && (*end == 'K' || *end == 'k'))
+  {
+    value *= 1024;
+    ++end;
+  }
+
+  if (end == text.c_str() || *end != '\0' || value == 0 || value > 0x10000 || (value & (value - 1)) != 0)
+  {
+    return 0;
+  }
+
+  return value;
+}
+/*}}}*/
+
+std::string Describe(const CacheConfig &config)/*{{{*/
+{
+  static const char *replacements[] = { "lru", "fifo", "random" };
+  static const char *writes[] = { "wb", "wt", "wtna" };
+  char text[64];
+  unsigned int lines = config.size / config.lineBytes;
+
+  if (config.ways == lines)
+  {
+    std::snprintf(text, sizeof(text), "%5uB full  %3uB %-6s %-4s", config.size, config.lineBytes,
+                  replacements[config.replacement], writes[config.write]);
+  }
+
+  else
+  {
+    std::snprintf(text, sizeof(text), "%5uB %3u-way %3uB %-6s %-4s", config.size, config.ways, config.lineBytes,
+                  replacements[config.replacement], writes[config.write]);
+  }
+
+  return text;
+}
+/*}}}*/
+
+/******************************************************************************
+ *
+ *                                BEGIN MAIN
+ *
+ *****************************************************************************/
+int main(int argc, char *argv[])
+{
+  std::string sizeList = "1K,2K,4K,8K";
+  std::string waysList = "1,2,4,8";
+  std::string lineList = "8,16,32";
+  std::string replacementList = "lru";
+  std::string writeList = "wb";
+  unsigned int threads = std::thread::hardware_concurrency();
+  std::string tracePath;
+
+  //Parse command line arguments/*{{{*/
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string arg = argv[i];
+
+    if (arg.size() == 2 && arg[0] == '-' && i + 1 < argc)
+    {
+      std::string value = argv[++i];
+
+      switch (arg[1])
+      {
+        case 's': sizeList = value; continue;
+        case 'a': waysList = value; continue;
+        case 'l': lineList = value; continue;
+        case 'r': replacementList = value; continue;
+        case 'w': writeList = value; continue;
+        case 'j': threads = std::atoi(value.c_str()); continue;
+        default: break;
+      }
+    }
+
+    else if (tracePath.empty() && arg[0] != '-')
+    {
+      tracePath = arg;
+      continue;
+    }
+
+    PrintUsage();
+    return 0;
+  }
+
+  if (tracePath.empty())
+  {
+    PrintUsage();
+    return 0;
+  }
+
+  if (threads == 0)
+  {
+    threads = 1;
+  }
+  /*}}}*/
+
+  //Build every configuration out of the lists/*{{{*/
+  std::vector<unsigned int> sizes;
+  std::vector<unsigned int> ways;       // 0 for fully associative
+  std::vector<unsigned int> lineSizes;
+  std::vector<ReplacementPolicy> replacements;
+  std::vector<WritePolicy> writes;
+  std::vector<std::string> items = Split(sizeList);
+
+  for (unsigned int i = 0; i < items.size(); ++i)
+  {
+    sizes.push_back(ParseSize(items[i]));
+  }
+
+  items = Split(waysList);
+
+  for (unsigned int i = 0; i < items.size(); ++i)
+  {
+    ways.push_back(items[i] == "full" ? 0 : ParseSize(items[i]));
+
+    if (items[i] != "full" && ways.back() == 0)
+    {
+      std::cout << "Sizes, associativities and line sizes must be powers of two!" << std::endl;
+      PrintUsage();
+      return 0;
+    }
+  }
+
+  items = Split(lineList);
+
+  for (unsigned int i = 0; i < items.size(); ++i)
+  {
+    lineSizes.push_back(ParseSize(items[i]));
+  }
+
+  items = Split(replacementList);
+
+  for (unsigned int i = 0; i < items.size(); ++i)
+  {
+    if (items[i] == "lru")
+    {
+      replacements.push_back(replaceLRU);
+    }
+
+    else if (items[i] == "fifo")
+    {
+      replacements.push_back(replaceFIFO);
+    }
+
+    else if (items[i] == "random")
+    {
+      replacements.push_back(replaceRandom);
+    }
+
+    else
+    {
+      std::cout << "Unknown replacement policy " << items[i] << "!" << std::endl;
+      PrintUsage();
+      return 0;
+    }
+  }
+
+  items = Split(writeList);
+
+  for (unsigned int i = 0; i < items.size(); ++i)
+  {
+    if (items[i] == "wb")
+    {
+      writes.push_back(writeBack);
+    }
+
+    else if (items[i] == "wt")
+    {
+      writes.push_back(writeThrough);
+    }
+
+    else if (items[i] == "wtna")
+    {
+      writes.push_back(writeThroughNoAllocate);
+    }
+
+    else
+    {
+      std::cout << "Unknown write policy " << items[i] << "!" << std::endl;
+      PrintUsage();
+      return 0;
+    }
+  }
+
+  for (unsigned int i = 0; i < sizes.size(); ++i)
+  {
+    if (sizes[i] == 0)
+    {
+      std::cout << "Sizes, associativities and line sizes must be powers of two!" << std::endl;
+      PrintUsage();
+      return 0;
+    }
+  }
+
+  for (unsigned int i = 0; i < lineSizes.size(); ++i)
+  {
+    if (lineSizes[i] == 0)
+    {
+      std::cout << "Sizes, associativities and line sizes must be powers of two!" << std::endl;
+      PrintUsage();
+      return 0;
+    }
+  }
+
+  // Combinations where a set would not fit in the cache are left out
+  std::vector<CacheConfig> configs;
+
+  for (unsigned int s = 0; s < sizes.size(); ++s)
+  {
+    for (unsigned int a = 0; a < ways.size(); ++a)
+    {
+      for (unsigned int l = 0; l < lineSizes.size(); ++l)
+      {
+        unsigned int lines = sizes[s] / lineSizes[l];
+        unsigned int setWays = ways[a] == 0 ? lines : ways[a];
+
+        if (lines == 0 || setWays > lines)
+        {
+          continue;
+        }
+
+        for (unsigned int r = 0; r < replacements.size(); ++r)
+        {
+          for (unsigned int w = 0; w < writes.size(); ++w)
+          {
+            CacheConfig config = { sizes[s], setWays, lineSizes[l], replacements[r], writes[w] };
+            configs.push_back(config);
+          }
+        }
+      }
+    }
+  }
+
+  if (configs.empty())
+  {
+    std::cout << "No cache fits those sizes!" << std::endl;
+    return 0;
+  }
+  /*}}}*/
+
+  TraceReader reader;
+
+  if (!reader.Open(tracePath))
+  {
+    std::cout << "Problem with the trace: " << reader.Error() << ", exiting..." << std::endl;
+    return -2;
+  }
+
+  CacheSimulator simulator(configs);
+
+  if (!simulator.Run(reader, threads))
+  {
+    std::cout << "Problem with the trace: " << reader.Error() << ", exiting..." << std::endl;
+    return -2;
+  }
+
+  //Print the results/*{{{*/
+  std::printf("%u configurations in %u jobs, %u of them LRU stack groups, on %u threads\n\n",
+              static_cast<unsigned int>(configs.size()), simulator.Jobs(), simulator.StackJobs(), threads);
+  std::printf("%-32s %10s %10s %10s %10s %8s %10s %10s %10s\n", "Cache", "Accesses", "Read miss", "Write miss",
+              "Fetch miss", "Miss %", "Fills", "Writebacks", "Write thr");
+
+  for (unsigned int i = 0; i < configs.size(); ++i)
+  {
+    const CacheResult &result = simulator.Result(i);
+    unsigned long long accesses = result.accesses[0] + result.accesses[1] + result.accesses[2];
+    unsigned long long misses = result.misses[0] + result.misses[1] + result.misses[2];
+
+    std::printf("%-32s %10llu %10llu %10llu %10llu %8.3f %10llu %10llu %10llu\n", Describe(configs[i]).c_str(),
+                accesses, result.misses[0], result.misses[1], result.misses[2],
+                accesses ? 100.0 * misses / accesses : 0.0, result.lineFills, result.writeBacks,
+                result.writeThroughs);
+  }
+  /*}}}*/
+
+  return 0;
+}
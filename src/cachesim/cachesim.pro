@@ -0,0 +1,15 @@
+# Console cache simulator for the simulator's memory traces, no Qt needed
+TEMPLATE = app
+TARGET = cachesim
+CONFIG += console thread
+CONFIG -= qt app_bundle
+
+QMAKE_CXXFLAGS += -g -std=gnu++11 -Wall -Wpedantic
+LIBS += -lz
+
+HEADERS += cacheSimulator.h \
+    ../traceReader.h \
+    ../traceWriter.h
+SOURCES += cachesim.cpp \
+    cacheSimulator.cpp \
+    ../traceReader.cpp
@@ -1,8 +1,8 @@
 #include <iostream>
+#include <thread>
 #include "cpu.h"
+#include "translator.h"
 
-#define src 3
-#define dst 1
 #define clr 0
 #define set 1
 #define Zbit 04
@@ -13,17 +13,64 @@
 #define WORD 0x8000
 #define BYTE 0x0080
 
+// Operand fields of the instruction word
+#define SRC(instruction) (((instruction) >> 6) & 077)
+#define DST(instruction) ((instruction) & 077)
+
+// Instructions a translated loop may retire before handing back control
+#define TRANSLATED_BUDGET 65536ULL
+
+// Instructions between checks of guest time against host time when pacing
+#define PACE_INTERVAL 1024
+
 CPU::CPU(Memory *memory)/*{{{*/
 {
   this->debugLevel = Verbosity::off;
-  this->instructionCount = 0;
+  this->instructionCount = memory->InitialInstructions();
+  this->cycleCount = memory->InitialCycles();
+  this->dispatchTable = DispatchTable();
+  this->timingTable = TimingTable();
+  this->decodeCache = new DecodedInstruction[IO_PAGE / 2]();
+  this->decodeCacheHits = 0;
+  this->decodeCacheMisses = 0;
+  this->translator = NULL;
+  this->breakMap = new unsigned char[4096]();
+  this->breakpoints = 0;
+  this->flagOp = FlagOp::None;
+  this->flagResult = 0;
+  this->flagSrc = 0;
+  this->flagDst = 0;
+  this->pacing = false;
+  this->paceCycles = 0;
   this->memory = memory;
+  this->memory->AttachRegisters(this->reg);
+  this->memory->SetCodeObserver(this);
+  this->memory->SetConditionCodeSource(this);
 }
 /*}}}*/
 
 CPU::~CPU()/*{{{*/
 {
   delete this->memory;
+  delete [] this->decodeCache;
+  delete this->translator;
+  delete [] this->breakMap;
+}
+/*}}}*/
+
+/*
+ * Each engine is compiled once per Instrumentation, so the one that runs
+ * without a trace or state dumps has no trace or debug code in it at all.
+ * Memory does the same for the operand accessors it hands the decoder.
+ */
+Instrumentation CPU::Instrumented() const/*{{{*/
+{
+  if (debugLevel == Verbosity::verbose)
+  {
+    return instrumentVerbose;
+  }
+
+  return memory->TraceEnabled() ? instrumentTrace : instrumentNone;
 }
 /*}}}*/
 
@@ -31,1004 +78,1539 @@ CPU::~CPU()/*{{{*/
  * Takes in the program counter register value in order to
  * be able to fetch, decode, and execute the next instruction
  * .
- */ 
+ */
 int CPU::FDE()/*{{{*/
 {
-  unsigned short instruction = 0;   // Instruction word buffer
-  unsigned short iB[6];             // Dissected instruction word
+  switch (this->Instrumented())
+  {
+    case instrumentVerbose:
+      return this->Step<instrumentVerbose>();
+
+    case instrumentTrace:
+      return this->Step<instrumentTrace>();
+
+    default:
+      return this->Step<instrumentNone>();
+  }
+}
+/*}}}*/
+
+template <Instrumentation INSTRUMENT>
+int CPU::Step()/*{{{*/
+{
+  // Instruction fetch/*{{{*/
 
-  // Lambda declarations and definitions/*{{{*/
-  auto address = [&] (const int i) { return (iB[i] << 3) + iB[i - 1]; };
-  auto update_flags = [&] (unsigned short i, unsigned short bit) 
+  try
   {
-    if (i == 0) { 
-      unsigned short temp = memory->ReadPS();
-      temp = temp & ~(bit);
-      memory->WritePS(temp);
-    }
-    else {
-      unsigned short temp = memory->ReadPS();
-      temp = temp | bit;
-      memory->WritePS(temp);
+    // Fetch the instruction and increment PC
+    const DecodedInstruction &decoded = this->Fetch<INSTRUMENT>(memory->RetrievePC());
+    ++this->instructionCount;
+    this->cycleCount += decoded.cycles;
+    memory->IncrementPC();
+
+    // Optional instruction fetch state dump
+    if (INSTRUMENT == instrumentVerbose)
+    {
+      this->DumpState(decoded);
     }
-  };
-  auto resultIsZero = [&] (unsigned short result) \
-  { result == 0? update_flags(1,Zbit) : update_flags(0,Zbit); };  // Update Zbit where result is zero
-  auto resultLTZero = [&] (unsigned short result) { result & WORD? \
-    update_flags(1,Nbit) : update_flags(0,Nbit); };                 // Update Nbit where result is negative
-  auto resultMSBIsOne = [&] (unsigned short result) { result >> 15 > 0? \
-    update_flags(1,Nbit) : update_flags(0,Nbit); };                 // Update Nbit where result MSB is 1 (negative)
-  auto NOP = [] () {;}; // For NOPping
-  /*}}}*/
+    /*}}}*/
 
-  // Instruction fetch/*{{{*/
+    // Execute
+    return (this->*decoded.handler)(decoded);
+  }
 
-  // Fetch the instruction and increment PC
-  instruction = this->memory->ReadInstruction();
-  ++this->instructionCount;
-  memory->IncrementPC();
+  catch (const MemoryAbort &error)
+  {
+    return this->Trap(error.vector) ? 1 : 0;
+  }
+}
+/*}}}*/
 
-  // Optional instruction fetch state dump/*{{{*/
-  if (debugLevel == Verbosity::verbose)
+/*
+ * Threaded-code engine.  Runs until an instruction returns a status of 0
+ * (HALT or an unrecognized word), the same stop condition and warnings as
+ * the console loop around FDE().  Each handler label ends with its
+ * own copy of the fetch and dispatch sequence and jumps straight to the
+ * next handler through a computed goto, so there is no call and return
+ * per instruction and every handler gets its own indirect branch for the
+ * host's predictor to learn.  A bus error unwinds out of the handlers,
+ * traps, and dispatching starts over.
+ */
+int CPU::RunThreaded()/*{{{*/
+{
+  switch (this->Instrumented())
   {
-    std::cout << "********************************************************************************" << std::endl;
-    std::cout << "                                        BREAK" << std::endl;
-    std::cout << "********************************************************************************" << std::endl;
-    std::cout << std::endl;
-    std::cout << std::endl;
-    std::cout << std::endl;
-    std::cout << "********************************************************************************" << std::endl;
-    std::cout << std::endl;
-    std::cout << "                              INSTRUCTION #" << std::dec << this->instructionCount << std::endl;
-    std::cout << std::endl;
-    std::cout << "********************************************************************************" << std::endl;
-    std::cout << "Fetched instruction: " << std::oct << instruction << std::endl;
-    std::cout << std::endl;
-    this->memory->RegDump();
+    case instrumentVerbose:
+      return this->RunThreadedWith<instrumentVerbose>();
+
+    case instrumentTrace:
+      return this->RunThreadedWith<instrumentTrace>();
+
+    default:
+      return this->RunThreadedWith<instrumentNone>();
   }
-  /*}}}*/
-  /*}}}*/
+}
+/*}}}*/
 
-  // Decode & execute/*{{{*/
-  iB[0] = (instruction & 0000007);
-  iB[1] = (instruction & 0000070) >> 3; 
-  iB[2] = (instruction & 0000700) >> 6;
-  iB[3] = (instruction & 0007000) >> 9;
-  iB[4] = (instruction & 0070000) >> 12;
-  iB[5] = (instruction & 0700000) >> 15; // This is actually only giving us the final bit of the 16-bit word
-  unsigned short tmp      = 0; // Use for holding temperary values for instruction operations
-  unsigned short offset   = 0; // Used to hold the PC value for offsetting in cases of branching
-  unsigned short src_temp = 0; // Used for storing temporary source values
-  unsigned short dst_temp = 0; // Used for storing temporary destination values
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+template <Instrumentation INSTRUMENT>
+int CPU::RunThreadedWith()/*{{{*/
+{
+#define LABEL_ENTRY(name) &&threaded_##name,
+  static const void *labels[] =
+  {
+    INSTRUCTION_LIST(LABEL_ENTRY)
+  };
+#undef LABEL_ENTRY
 
-  //condition bit operation, system instruction, or branch/*{{{*/
-  if(iB[4] == 0 && iB[3] <= 3)
+  const DecodedInstruction *decoded;
+  int status;
+
+#define DISPATCH() \
+  decoded = &this->Fetch<INSTRUMENT>(memory->RetrievePC()); \
+  ++this->instructionCount; \
+  this->cycleCount += decoded->cycles; \
+  memory->IncrementPC(); \
+  if (INSTRUMENT == instrumentVerbose) \
+  { \
+    this->DumpState(*decoded); \
+  } \
+  goto *labels[static_cast<int>(decoded->opcode)];
+
+#define THREADED_HANDLER(name) \
+  threaded_##name: \
+  status = this->name(*decoded); \
+  if (memory->RetrievePC() % 2 != 0) \
+  { \
+    std::cout << "Warning: program counter is not an even number!" << std::endl; \
+  } \
+  if (status <= 0) \
+  { \
+    return status; \
+  } \
+  DISPATCH();
+
+  for (;;)
   {
-    //condition bit operation or system instruction/*{{{*/
-    if(!iB[5] && !iB[4] && !iB[3] && !(iB[2] & 04))
+    try
     {
-      if(iB[2] == 0) //then system instruction/*{{{*/
-      {
-        switch(iB[0])
-        {
-          case 0:
-            {
-              return 0; //HALT
-            }
-          case 1:
-            {
-              return 1; // WAIT
-            }
-          case 5:
-            {
-              return 5; // RESET
-            }
-          default:
-            break;
-        }
-      }/*}}}*/
+      DISPATCH();
+      INSTRUCTION_LIST(THREADED_HANDLER)
+    }
 
-      else if(iB[2] == 1)/*{{{*/
+    catch (const MemoryAbort &error)
+    {
+      if (!this->Trap(error.vector))
       {
-        //JUMP
-        dst_temp = memory->Read(address(dst));      // Get address JMP
-        memory->Write(007, dst_temp);               // Put in PC
-        return instruction;
-      }/*}}}*/
+        return 0;
+      }
+    }
+  }
 
-      else if(iB[2] == 2)	//Condition code operation/*{{{*/
-      {
-        switch(iB[1])
-        {
-          case 0:
-            {
-              // RTS reg
-              tmp = memory->Read(address(dst));                 // Read register value
-              memory->Write(007, tmp);                          // reg --> (PC)
-              tmp = memory->Read(026);                        // Push value of reg onto stack
-              memory->Write(address(dst),tmp);   // pop reg
-              return instruction;
-            }
-          case 4:
-            {
-              switch(iB[0])
-              {
-                case 1:
-                  {
-                    //Clear C
-                    update_flags (0, Cbit); // CLC 
-                    return instruction;
-                  }
-                case 2:
-                  {
-                    //Clear V
-                    update_flags (0, Vbit); // CLV
-                    return instruction;
-                  }
-                case 4:
-                  {
-                    //Clear Z
-                    update_flags (0, Zbit); // CLZ
-                    return instruction;
-                  }
-                default:
-                  break;
-              }
-            }
-          case 5:
-            {
-              if(iB[0] == 0)
-              {
-                //Clear N
-                update_flags (0, Nbit); // CLN
-                return instruction;
-              }
-            }
-          case 6:
-            {
-              switch(iB[0])
-              {
-                case 1:
-                  {
-                    //Set C
-                    update_flags (1, Cbit); // SEC
-                    return instruction;
-                  }
-                case 2:
-                  {
-                    //Set V
-                    update_flags (1, Vbit); // SEV
-                    return instruction;
-                  }
-                case 4:
-                  {
-                    //Set Z
-                    update_flags (1, Zbit); // SEZ
-                    return instruction;
-                  }
-                default:
-                  break;
-              }
-            }
-          case 7:
-            {
-              if(iB[0] == 0)
-              {
-                //Set N
-                update_flags (1, Nbit); // SEN
-                return instruction;
-              }
-            }
-          default:
-            break;
-        }
-      }/*}}}*/
+#undef THREADED_HANDLER
+#undef DISPATCH
+}
+/*}}}*/
+#pragma GCC diagnostic pop
 
-      else if(iB[2] == 3)/*{{{*/
-      {
-        //SWAB
-        tmp = memory->Read(address(dst));       // Get value at effective address // SWAB
-        unsigned short byte_temp = tmp << 8;    // Create temp and give it LSByte of value in MSByte
-        tmp = (tmp >> 8) & 0x00FF;             // Shift MSByte into LSByte and clear MSByte
-        (tmp == 0)? \
-              update_flags(1,Zbit): update_flags(0,Zbit);	//Update Z bit based on low order byte
-        ((tmp & 0x0080) == 0x0080)? \
-                         update_flags(1,Nbit): update_flags(0,Nbit); //Update N bit based on low order byte
-        tmp = byte_temp + tmp;                  // Finalize the swap byte
-        memory->Write(address(dst), byte_temp); // Write to register
-        update_flags(0,Cbit);              // Set C bit
-        update_flags(0,Vbit);              // Set V bit
-        return instruction;
-      }/*}}}*/
-    }/*}}}*/
+void CPU::EnableTranslation()/*{{{*/
+{
+  if (!this->translator)
+  {
+    this->translator = new Translator(this->memory, this->dispatchTable, this->timingTable, this->reg);
+  }
+}
+/*}}}*/
 
-    //branch operations/*{{{*/
-    else if((iB[3] > 0) || (!iB[3] && (iB[5] || iB[2] > 3)))
-    {
-      switch(iB[3])/*{{{*/
-      {
-        case 0:	//BPL, BR, or BMI/*{{{*/
-          {
-            if(iB[5]) //BPL or BMI
-            {
-              if(iB[2] >= 3)
-              {
-                //BMI
-                offset = (instruction & 0x00FF);          // Get address for branch BMI
-                tmp = memory->Read(007);                  // Get current address in PC
-                offset = offset << 1;                     // Multiply offset by 2
-                if (offset & 0400)                        // Check if neg
-                  offset = offset | (07777000);           // Pad with ones
-                tmp = tmp + offset;                       // Get new address for branch
-                (memory->ReadPS() & Nbit) > 0? \
-                  memory->Write(007,tmp) : NOP();         // N = 1
-                return instruction;
-              }
-              else if(iB[2] < 3)
-              {
-                //BPL
-                offset = (instruction & 0x00FF);      // Get address for branch BPL
-                tmp = memory->Read(007);              // Get current address in PC
-                offset = offset << 1;                 // Multiply offset by 2
-                if (offset & 0400)                    // Check if neg
-                  offset = offset | (07777000);       // Pad with ones
-                tmp = tmp + offset;                   // Get new address for branch
-                (memory->ReadPS() & Nbit) == 0? \
-                                           memory->Write(007,tmp) : NOP();     // N = 0
-                return instruction;
-              }
-            }
-            else if(!iB[5] && iB[2] > 3)
-            {
-              //BR
-              offset = (instruction & 0x00FF);          // Get address for branch BR
-              tmp = memory->Read(007);                  // Get current address in PC
-              offset = offset << 1;                     // Multiply offset by 2
-              if (offset & 0400)                        // Check if neg
-                offset = offset | (07777000);           // Pad with ones
-              tmp = tmp + offset;                       // Get new address for branch
-              memory->Write(007,tmp);                   // Branch always
-              return instruction;
-            }
-          }/*}}}*/
+/*
+ * Batch engine.  Executes up to budget instructions in a tight loop and
+ * reports why it stopped along with the number of instructions retired.
+ * HALT and the budget always stop it, WAIT, breakpoints, watchpoints and an
+ * odd PC only when asked for in stopConditions.  A breakpoint stops the run
+ * before the instruction at its address, except for the first instruction
+ * of a call, so calling Run() again resumes past it.  A watchpoint stops it
+ * after the instruction that made the watched access.
+ *
+ * With translation enabled, hot blocks run as host code whenever nothing
+ * could need to stop inside them: no breakpoints or watchpoints, no trace
+ * output, no state dumps and no memory management.  They are handed the budget less
+ * one block, so a run never goes over it.
+ *
+ * An aborted access traps, through vector 4 for a bus error or 250 for
+ * memory management, and the run carries on; a second one while trapping
+ * halts it.
+ *
+ * When pacing, the run is held back to the speed of a real 11/20 by
+ * sleeping whenever the estimated guest time gets ahead of the host clock.
+ * Time spent outside Run() is not made up for.
+ */
+RunResult CPU::Run(unsigned long long budget, unsigned int stopConditions)/*{{{*/
+{
+  switch (this->Instrumented())
+  {
+    case instrumentVerbose:
+      return this->RunWith<instrumentVerbose>(budget, stopConditions);
 
-        case 1: //BNE, BHI, BLOS, BEQ/*{{{*/
-          {
-            if(iB[5]) //BHI or BLOS
-            {
-              if(iB[2] <= 3)
-              {
-                //BHI
-                offset = (instruction & 0x00FF);          // Get address for branch BHI
-                tmp = memory->Read(007);                  // Get current address in PC
-                offset = offset << 1;                     // Multiply offset by 2
-                if (offset & 0400)                        // Check if neg
-                  offset = offset | (07777000);           // Pad with ones
-                tmp = tmp + offset;                       // Get new address for branch
-                (memory->ReadPS() & (Zbit | Cbit)) == 0? \
-                                                    memory->Write(007,tmp) : NOP();          // C & Z = 0
-                return instruction;
-              }
-              else if(iB[2] > 3)
-              {
-                //BLOS
-                offset = (instruction & 0x00FF);          // Get address for branch BLOS
-                tmp = memory->Read(007);                  // Get current address in PC
-                offset = offset << 1;                     // Multiply offset by 2
-                if (offset & 0400)                        // Check if neg
-                  offset = offset | (07777000);           // Pad with ones
-                tmp = tmp + offset;                       // Get new address for branch
-                (memory->ReadPS() & (Zbit | Cbit)) > 0? \
-                  memory->Write(007,tmp) : NOP();         // C | Z = 1
-                return instruction;
-              }
-            }
-            else if (!iB[5]) //BNE or BEQ
-            {
-              if(iB[2] <= 3)
-              {
-                //BNE
-                offset = (instruction & 0x00FF);          // Get address for branch BNE
-                tmp = memory->Read(007);                  // Get current address in PC
-                offset = offset << 1;                     // Multiply offset by 2
-                if (offset & 0400)                        // Check if neg
-                  offset = offset | (07777000);           // Pad with ones
-                tmp = tmp + offset;                       // Get new address for branch
-                (memory->ReadPS() & Zbit) == 0? \
-                                           memory->Write(007,tmp) : NOP();         // Z = 0
-                return instruction;
-              }
-              else if(iB[2] > 3)
-              {
-                //BEQ
-                offset = (instruction & 0x00FF);          // Get address for branch
-                tmp = memory->Read(007);                // Get current address in PC
-                offset = offset << 1;                   // Multiply offset by 2
-                if (offset & 0400)                      // Check if neg
-                  offset = offset | (07777000);        // Pad with ones
-                tmp = tmp + offset;                     // Get new address for branch
-                (memory->ReadPS() & Zbit) > 0? \
-                  memory->Write(007,tmp) : NOP();          // Z = 0
-                return instruction;
-              }	
-            }
-          }/*}}}*/
+    case instrumentTrace:
+      return this->RunWith<instrumentTrace>(budget, stopConditions);
 
-        case 2:	//BVC, BGE, BVS, BLT/*{{{*/
-          {
-            if(iB[5]) //BVC or BVS
-            {
-              if(iB[2] <= 3)
-              {
-                //BVC
-                offset = (instruction & 0x00FF);          // Get address for branch BVC
-                tmp = memory->Read(007);                  // Get current address in PC
-                offset = offset << 1;                     // Multiply offset by 2
-                if (offset & 0400)                        // Check if neg
-                  offset = offset | (07777000);           // Pad with ones
-                offset = tmp + offset;                       // Get new address for branch
-                (memory->ReadPS() & Vbit) == 0? \
-                                           memory->Write(007,offset) : NOP();          // V = 0
-                return instruction;
-              }
-              else if(iB[2] > 3)
-              {
-                //BVS
-                offset = (instruction & 0x00FF);          // Get address for branch BVS
-                tmp = memory->Read(007);                  // Get current address in PC
-                offset = offset << 1;                     // Multiply offset by 2
-                if (offset & 0400)                        // Check if neg
-                  offset = offset | (07777000);           // Pad with ones
-                offset = tmp + offset;                       // Get new address for branch
-                (memory->ReadPS() & Vbit) == Vbit? \
-                                           memory->Write(007,offset) : NOP();          // V = 1
-                return instruction;
-              }
-            }
-            else if (!iB[5]) //BGE or BLT
-            {
-              if(iB[2] <= 3)
-              {
-                //BGE
-                offset = (instruction & 0x00FF);          // Get address for branch
-                tmp = memory->Read(007);                // Get current address in PC
-                offset = offset << 1;                   // Multiply offset by 2
-                if (offset & 0400)                      // Check if neg
-                  offset = offset | (07777000);        // Pad with ones
-                offset = tmp + offset;                     // Get new address for branch
-                (((memory->ReadPS() & Nbit) >> 3) ^ ((memory->ReadPS() & Vbit) >> 1)) == 0? \
-                                                                                       memory->Write(007,offset) : NOP();          // N ^ V = 0
-                return instruction;
-              }
-              else if(iB[2] > 3)
-              {
-                //BLT
-                offset = (instruction & 0x00FF);          // Get address for branch
-                tmp = memory->Read(007);                // Get current address in PC
-                offset = offset << 1;                   // Multiply offset by 2
-                if (offset & 0400)                      // Check if neg
-                  offset = offset | (07777000);        // Pad with ones
-                offset = tmp + offset;                     // Get new address for branch
-                (((memory->ReadPS() & Nbit) >> 3) ^ ((memory->ReadPS() & Vbit) >> 1)) == 1? \
-                                                                                       memory->Write(007,offset) : NOP();          // N ^ V == 1
-                return instruction;
-              }	
-            }
-          }/*}}}*/
+    default:
+      return this->RunWith<instrumentNone>(budget, stopConditions);
+  }
+}
+/*}}}*/
 
-        case 3:	//BGT, BCC, BLE, or BCS/*{{{*/
-          {
-            if(iB[5]) //BCC or BCS
-            {
-              if(iB[2] <= 3)
-              {
-                //BCC
-                offset = (instruction & 0x00FF);        // Get address for branch BCC
-                tmp = memory->Read(007);                // Get current address in PC
-                offset = offset << 1;                   // Multiply offset by 2
-                if (offset & 0400)                      // Check if neg
-                  offset = offset | (07777000);         // Pad with ones
-                offset = tmp + offset;                     // Get new address for branch
-                (memory->ReadPS() & Cbit) == 0? \
-                                           memory->Write(007,offset) : NOP();       // C = 0
-                return instruction;
-              }
-              else if(iB[2] > 3)
-              {
-                //BCS
-                offset = (instruction & 0x00FF);        // Get address for branch BCS
-                tmp = memory->Read(007);                // Get current address in PC
-                offset = offset << 1;                   // Multiply offset by 2
-                if (offset & 0400)                      // Check if neg
-                  offset = offset | (07777000);         // Pad with ones
-                offset = tmp + offset;                     // Get new address for branch
-                ((memory->ReadPS() & Cbit) == Cbit)? \
-                                            memory->Write(007,offset) : NOP();    // C = 1
-                return instruction;
-              }
-            }
-            else if (!iB[5]) //BLE or BGT
-            {
-              if(iB[2] <= 3)
-              {
-                //BGT
-                offset = (instruction & 0x00FF);          // Get address for branch BGT
-                tmp = memory->Read(007);                  // Get current address in PC
-                offset = offset << 1;                     // Multiply offset by 2
-                if (offset & 0400)                        // Check if neg
-                  offset = offset | (07777000);           // Pad with ones
-                offset = tmp + offset;                       // Get new address for branch
-                (((memory->ReadPS() & Zbit) >> 2) | \
-                 (((memory->ReadPS() & Nbit) >> 3) ^ ((memory->ReadPS() & Vbit) >> 1))) == 0? \
-                  memory->Write(007,offset) : NOP();          // Z | (N ^ V) = 0
-                return instruction;
-              }
-              else if(iB[2] > 3)
-              {
-                //BLE
-                offset = (instruction & 0x00FF);          // Get address for branch BLE
-                tmp = memory->Read(007);                  // Get current address in PC
-                offset = offset << 1;                     // Multiply offset by 2
-                if (offset & 0400)                        // Check if neg
-                  offset = offset | (07777000);           // Pad with ones
-                offset = tmp + offset;                    // Get new address for branch
-                tmp = memory->ReadPS();                   // Get current process status
-                (((tmp & Zbit) >> 2) | (((tmp & Nbit) >> 3) ^ ((tmp & Vbit) >> 1))) == 1? \
-                                                                                     memory->Write(007,offset) : NOP();      // Z(N^V) = 1
-                return instruction;
-              }	
-            }	
-          }/*}}}*/
-
-        default:
-          break;
-      }/*}}}*/
-    }/*}}}*/
-  }/*}}}*/
+template <Instrumentation INSTRUMENT>
+RunResult CPU::RunWith(unsigned long long budget, unsigned int stopConditions)/*{{{*/
+{
+  RunResult result;
+  result.executed = 0;
+  memory->ClearWatchHit();
 
-  // Single Operand Instructions (not including condition code instructions or branches)/*{{{*/
-  else if ((iB[5] == 0) && (iB[4] == 0) && (iB[3] >= 4)) // Single Operand Word Operations
+  bool checkBreakpoints = (stopConditions & stopOnBreakpoint) && this->breakpoints > 0;
+  bool checkWatchpoints = (stopConditions & stopOnWatchpoint) && memory->Watchpoints() > 0;
+  bool translate = INSTRUMENT == instrumentNone && this->translator && !checkBreakpoints &&
+                   !checkWatchpoints && !this->pacing;
+
+  if (this->pacing)
   {
-    switch(iB[3])
-    {
-      // JSR reg, dst /*{{{*/
-      case 4:
-        { 
-          tmp = memory->EA(address(dst));                 // Get address to jump to    JSR
-          unsigned short reg = memory->Read(iB[2] & 007); // Get value of reg to store
-          memory->Write(046, reg);                        // Push value of reg onto stack
-          reg = (memory->Read(007));                        // Get value from PC
-          memory->Write((iB[2] & 007),reg);               // Write PC value to register
-          memory->Write(007,tmp - 02);                         // Write new address to PC
-          return instruction;
-        }/*}}}*/
-
-        //Case 5 /*{{{*/
-      case 5:
-        {
-          switch(iB[2])
-          {
-            case 0: { // CLR dst - Clear Destination
-                      memory->Write(address(dst), 0);    // Clear value at address CLR
-                      update_flags(1,Zbit);              // Set Z bit
-                      update_flags(0,Nbit);              // Set N bit
-                      update_flags(0,Cbit);              // Set C bit
-                      update_flags(0,Vbit);              // Set V bit
-                      return instruction;
-                    }
-            case 1: { // COM dst: ~(dst) -> (dst)
-                      tmp = memory->Read(address(dst));  // Get value at address COM
-                      tmp = ~tmp;                        // Compliment value
-                      memory->Write(address(dst), tmp);  // Write compiment to memory
-                      resultIsZero(tmp);                 // Update Z bit
-                      resultLTZero(tmp);                 // Update N bit
-                      update_flags(1, Cbit);			 // Update C bit
-                      update_flags(0, Vbit);			 // Update V bit
-                      return instruction;
-                    }
-            case 2: { // INC dst: (dst)++ -> (dst)
-                      dst_temp = memory->Read(address(dst)); // Get value at address INC
-                      tmp = dst_temp + 1;                // Increment value
-                      memory->Write(address(dst), tmp);  // Write to memory
-                      resultIsZero(tmp);                 // Update Z bit
-                      resultLTZero(tmp);                 // Update N bit
-                      // C bit not affected
-                      dst_temp == 0077777? \
-                                update_flags(1,Vbit) : update_flags(0,Vbit);  // Update V bit
-                      return instruction;
-                    }
-            case 3: { // DEC dst: (dst)-- -> (dst)
-                      dst_temp = memory->Read(address(dst));  // Get value at address DEC
-                      tmp = dst_temp - 1;                     // Decrement value
-                      memory->Write(address(dst), tmp);       // Write to memory
-                      resultIsZero(tmp);                      // Update Z bit
-                      resultLTZero(tmp);                      // Update N bit
-                      //C bit not affected (typo in handbook)
-                      dst_temp == 0100000? \
-                                update_flags(1,Vbit) : update_flags(0,Vbit);  // Update V bit
-                      return instruction;
-                    }
-            case 4: { // NEG dst: -(dst) -> (dst) 
-                      tmp = memory->Read(address(dst));       // Get value at address NEG
-                      tmp = ~tmp + 1;                         // Get 2's comp of value
-                      memory->Write(address(dst),tmp);        // Write to memory
-                      resultIsZero(tmp);                      // Update Z bit
-                      resultLTZero(tmp);                      // Update N bit
-                      tmp == 0? update_flags(0,Cbit) : update_flags(1,Cbit);          // Update C bit
-                      tmp == 0100000? update_flags(1,Vbit) : update_flags(0,Vbit);  // Update V bit
-                      return instruction;
-                    }
-            case 5: { // ADC: (dst) + (C) -> (dst)
-                      dst_temp = memory->Read(address(dst));    // Get value at address ADC
-                      unsigned short tmpC = memory->ReadPS();   // Get current value of PS
-                      tmpC = tmpC & 0x1;                        // Get C bit value
-                      tmp = dst_temp + (tmpC);                  // Add C bit to value
-                      memory->Write(address(dst),tmp);          // Write to memory
-                      resultIsZero(tmp);                        // Update Z bit
-                      resultLTZero(tmp);                        // Update N bit
-                      ((dst_temp == 0177777) && (tmpC == 1))? \
-                                  update_flags(1,Cbit) : update_flags(0,Cbit);  // Update C bit
-                      ((dst_temp == 0077777) && (tmpC == 1))? update_flags(1,Vbit) : update_flags(0,Vbit);  // Update V bit
-                      return instruction;
-                    }
-            case 6: { // SBC: (dst) - (C) -> (dst)
-                      tmp = memory->Read(address(dst));         // Get value at address SBC
-                      unsigned short tmpC = memory->ReadPS();   // Get current value of PS
-                      tmpC = tmpC & 0x1;                        // Get C bit value
-                      tmp = tmp - tmpC;                         // Add C bit to value
-                      memory->Write(address(dst),tmp);          // Write to memory
-                      resultIsZero(tmp);                        // Update Z bit
-                      resultLTZero(tmp);                        // Update N bit
-                      (tmp == 0) && (tmpC == 1)? \
-                            update_flags(0,Cbit) : update_flags(1,Cbit);  // Update C bit
-                      (tmp == 0100000)? update_flags(1,Vbit) : update_flags(0,Vbit);  // Update V bit
-                      return instruction;
-                    }
-            case 7: { // TST dst - Tests if dst is 0 (0 - dst)
-                      tmp = memory->Read(address(dst)); // Get value at address TST
-                      tmp = 0 - tmp;                    // Perform test
-                      resultIsZero(tmp);                // Update Z bit
-                      resultLTZero(tmp);                // Update N bit
-                      update_flags(0,Cbit);             // Update C bit
-                      update_flags(0,Vbit);             // Update V bit   
-                      return instruction;
-                    }
-            default: break;
-          }
-        }/*}}}*/
-      case 6:
-        {
-          switch(iB[2])/*{{{*/
-          {
-            case 0:
-              { // ROR dst: ROtate Rigtht - include C bit as MSB -> (dst)
-                dst_temp = memory->Read(address(dst));  // Get value at dst
-                unsigned short tempCN = memory->ReadPS() & 0x9; // Get C and N bits
-                tmp = (dst_temp >> 1) | ((tempCN & 01) << 15);  // Rotate bits to the right
-                memory->Write(address(dst),tmp);         // Write to memory
-                resultIsZero(tmp);                      // Update Z bit
-                resultLTZero(tmp);                      // Update N bit
-                update_flags(dst_temp & 01,Cbit);       // Update C bit
-                update_flags((tempCN >> 3) ^ (tempCN & 01),Vbit); // Update V bit - C ^ N
-                return instruction;
-              }
-            case 1:
-              { // ROL dst: ROtate Left - include C bit as LSB -> (dst)
-                dst_temp = memory->Read(address(dst));  // Get value at dst
-                unsigned short tempCN = (memory->ReadPS() & 0x9); // Get C and N bits
-                tmp = ((dst_temp << 1) | (tempCN & 01));  // Rotate bits to the right
-                memory->Write(address(dst),tmp);         // Write to memory
-                resultIsZero(tmp);                      // Update Z bit
-                resultLTZero(tmp);                      // Update N bit
-                update_flags((dst_temp & WORD) >> 15,Cbit); // Update C bit
-                update_flags((tempCN >> 3) ^ (tempCN & 01),Vbit); // Update V bit - C ^ N
-                return instruction;
-              }
-            case 2:
-              { // ASR dst: Arithmetic Shift Right
-                dst_temp = memory->Read(address(dst));  // Get value at dst
-                unsigned short tempCN = memory->ReadPS() & 0x9;     // Get C and N bits
-                tmp = dst_temp >> 1;                    // Rotate bits to the right
-                if(dst_temp & WORD)			//If destination is negative
-                  dst_temp = dst_temp | WORD;   	//then shift in a 1 on the end
-                memory->Write(address(dst),tmp);        // Write to memory
-                resultIsZero(tmp);                      // Update Z bit
-                resultLTZero(tmp);                      // Update N bit
-                update_flags((dst_temp & 01),Cbit);     // Update C bit LSB (result)
-                update_flags((tempCN >> 3) ^ (tempCN & 01),Vbit); // Update V bit - C ^ N
-                return instruction;
-              }
-            case 3: 
-              { // ASL dst: Arithmetic Shift Left 
-                dst_temp = memory->Read(address(dst));  // Get value at dst
-                unsigned short tempCN = memory->ReadPS() & 0x9;    // Get C and N bits
-                tmp = dst_temp << 1;                    // Rotate bits to the left
-                memory->Write(address(dst),tmp);         // Write to memory
-                resultIsZero(tmp);                      // Update Z bit
-                resultLTZero(tmp);                      // Update N bit
-                update_flags((dst_temp & WORD) >> 15,Cbit); // Update C bit
-                update_flags((tempCN >> 3) ^ (tempCN & 01),Vbit); // Update V bit - C ^ N
-                return instruction;
-              }
-            default: break;
-          }/*}}}*/
-        }
-      default: break;
-    }
-  }/*}}}*/
+    this->paceStart = std::chrono::steady_clock::now();
+    this->paceCycles = this->cycleCount;
+  }
 
-  // Single Operand Byte Operations /*{{{*/
-  else if ((iB[5] == 1) && (iB[4] == 0) && (iB[3] >= 4))
+  while (result.executed < budget)
   {
-    switch(iB[3])
+    unsigned short address = memory->RetrievePC();
+
+    if (checkBreakpoints && result.executed > 0 && this->IsBreakpoint(address))
     {
-      case 5: 
-        {
-          switch(iB[2])/*{{{*/
-          {
-            case 0:
-              { // CLRB dst - Clear Byte
-                memory->SetByteMode();            // Set byte mode CLRB
-                tmp = memory->Read(address(dst)); // Get value at dst
-                tmp = tmp & 0x0;                  // Clear byte
-                memory->Write(address(dst),tmp);  // Write byte to dst
-                update_flags(1,Zbit);              // Set Z bit
-                update_flags(0,Nbit);              // Set N bit
-                update_flags(0,Cbit);              // Set C bit
-                update_flags(0,Vbit);              // Set V bit
-                memory->ClearByteMode();          // Clear byte mode
-                return instruction;
-              }
-            case 1:
-              { // COMB dst: ~(dst) -> (dst)
-                memory->SetByteMode();            // Set byte mode COMB
-                tmp = memory->Read(address(dst)); // Get value at address
-                tmp = ~tmp & 0x00FF;              // Compliment value
-                memory->Write(address(dst), tmp); // Write compiment to memory
-                resultIsZero(tmp);                // Update Z bit
-                resultLTZero(tmp << 8);           // Update N bit
-                tmp == 0? update_flags(0,Cbit) : update_flags(1,Cbit);  // Update C bit
-                tmp == BYTE? update_flags(1,Vbit) : update_flags(0,Vbit);  // Update V bit
-                memory->ClearByteMode();                        // Clear byte mode
-                return instruction;
-              }
-            case 2:
-              { // INCB dst: (dst)++ -> (dst)
-                memory->SetByteMode();                  // Set byte mode INCB
-                dst_temp = memory->Read(address(dst));  // Get value at address
-                tmp = dst_temp + 1;                     // Increment value
-                memory->Write(address(dst), tmp);       // Write to memory
-                resultIsZero(tmp);                      // Update Z bit
-                resultLTZero(tmp << 8);                 // Update N bit
-                // C bit not affected
-                dst_temp == 0x00FF? \
-                          update_flags(1,Vbit) : update_flags(0,Vbit);  // Update V bit
-                memory->ClearByteMode();                        // Clear byte mode
-                return instruction;
-              }
-            case 3:
-              { // DECB dst: (dst)-- -> (dst)
-                memory->SetByteMode();            // Set byte mode DECB
-                tmp = memory->Read(address(dst)); // Get value at address
-                tmp--;                            // Decrement value
-                memory->Write(address(dst), tmp); // Write to memory
-                resultIsZero(tmp);                // Update Z bit
-                resultLTZero(tmp << 8);           // Update N bit
-                update_flags(0,Cbit);             // Update C bit
-                update_flags(0,Vbit);             // Update V bit
-                memory->ClearByteMode();          // Clear byte mode
-                return instruction;
-              }
-            case 4:
-              { // NEGB dst: -(dst) -> (dst)
-                memory->SetByteMode();            // Set byte mode NEGB
-                tmp = memory->Read(address(dst)); // Get value at address
-                tmp = (~tmp) & 0x00FF;        // Get 2's comp of value
-                memory->Write(address(dst),tmp);  // Write to memory
-                resultIsZero(tmp);                // Update Z bit
-                resultLTZero(tmp << 8);           // Update N bit
-                tmp == 0? update_flags(0,Cbit) : update_flags(1,Cbit);       // Update C bit
-                tmp == BYTE? update_flags(1,Vbit) : update_flags(0,Vbit);  // Update V bit
-                memory->ClearByteMode();          // Clear byte mode
-                return instruction;
-              }
-            case 5:
-              { // ADCB: (dst) + (C) -> (dst)
-                memory->SetByteMode();                  // Set byte mode ADCB
-                dst_temp = memory->Read(address(dst));  // Get value at address
-                unsigned short tmpC = memory->ReadPS(); // Get current value of PS
-                tmpC = tmpC & 0x1;                      // Get C bit value
-                tmp = (dst_temp + (tmpC)) & 0x00FF;     // Add C bit to value
-                memory->Write(address(dst),tmp);        // Write to memory
-                resultIsZero(tmp);                      // Update Z bit
-                resultLTZero(tmp << 8);                 // Update N bit
-                (dst_temp == 0x00FF) && (tmpC == 1)? \
-                           update_flags(1,Cbit) : update_flags(0,Cbit);                // Update C bit
-                tmp == 0x007F? update_flags(1,Vbit) : update_flags(0,Vbit);  // Update V bit
-                memory->ClearByteMode();              // Clear byte mode
-                return instruction;
-              }
-            case 6:
-              { // SBCB: (dst) - (C) -> (dst)
-                memory->SetByteMode();                  // Set byte mode SBCB
-                dst_temp = memory->Read(address(dst));  // Get value at address
-                unsigned short tmpC = memory->ReadPS(); // Get current value of PS
-                tmpC = tmpC & 0x1;                      // Get C bit value
-                tmp = dst_temp - tmpC;                  // Add C bit to value
-                memory->Write(address(dst),tmp);        // Write to memory
-                resultIsZero(tmp);                      // Update Z bit
-                resultLTZero(tmp << 8);                      // Update N bit
-                (tmp == 0) && (tmpC == 1)? \
-                      update_flags(0,Cbit) : update_flags(1,Cbit);  // Update C bit
-                ((tmp & BYTE) >> 7) == 1? \
-                                     update_flags(1,Vbit) : update_flags(0,Vbit);  // Update V bit
-                memory->ClearByteMode();          // Clear byte mode
-                return instruction;
-              }
-            case 7:
-              { // TSTB dst - Tests if dst is 0 (0 - dst)
-                tmp = memory->Read(address(dst)); // Get value at address TST
-                tmp = 0 - tmp;                    // Perform test
-                resultIsZero(tmp);                // Update Z bit
-                resultLTZero(tmp << 8);           // Update N bit
-                update_flags(0,Cbit);             // Update C bit
-                update_flags(0,Vbit);             // Update V bit   
-                return instruction;
-              }
-            default: break;
-          }/*}}}*/
-        }
-      case 6: 
-        {
-          switch(iB[2])/*{{{*/
-          {
-            case 0: 
-              { // RORB dst: ROtate Rigtht - include C bit as MSB -> (dst)
-                memory->SetByteMode();                            // Set byte mode RORB
-                dst_temp = memory->Read(address(dst));            // Get value at dst
-                unsigned short tempCN = memory->ReadPS() & 0x9;   // Get C and N bits
-                tmp = (dst_temp >> 1) | ((tempCN & 01) << 7);     // Rotate bits to the right
-                memory->Write(address(dst),tmp);                  // Write to memory
-                resultIsZero(tmp);                                // Update Z bit
-                resultLTZero(tmp << 8);                                // Update N bit
-                update_flags(dst_temp & 01,Cbit);                 // Update C bit
-                update_flags((tempCN >> 3) ^ (tempCN & 01),Vbit); // Update V bit - C ^ N
-                memory->ClearByteMode();                          // Clear byte mode
-                return instruction;
-              }
-            case 1:
-              { // ROLB dst: ROtate Left - include C bit as LSB -> (dst)
-                memory->SetByteMode();                            // Set byte mode ROLB
-                dst_temp = memory->Read(address(dst));            // Get value at dst
-                unsigned short tempCN = memory->ReadPS() & 0x9;   // Get C and N bits
-                tmp = (dst_temp << 1) | (tempCN & 01);            // Rotate bits to the right
-                memory->Write(address(dst),tmp & 0x00FF);         // Write to memory
-                resultIsZero(tmp);                                // Update Z bit
-                resultLTZero(tmp << 8);                                // Update N bit
-                update_flags((dst_temp & BYTE) >> 7,Cbit);        // Update C bit
-                update_flags((tempCN >> 3) ^ (tempCN & 01),Vbit); // Update V bit - C ^ N
-                memory->ClearByteMode();                          // Clear byte mode
-                return instruction;
-              }
-            case 2:
-              { // ASRB dst: Arithmetic Shift Right
-                memory->SetByteMode();                            // Set byte mode ASRB
-                dst_temp = memory->Read(address(dst));            // Get value at dst
-                unsigned short tempCN = memory->ReadPS() & 0x9;   // Get C and N bits
-                tmp = dst_temp >> 1;                              // Rotate bits to the right
-                memory->Write(address(dst),tmp);                  // Write to memory
-                resultIsZero(tmp);                                // Update Z bit
-                resultLTZero(tmp << 8);                                // Update N bit
-                update_flags((dst_temp & 01),Cbit);               // Update C bit LSB (result)
-                update_flags((tempCN >> 3) ^ (tempCN & 01),Vbit); // Update V bit - C ^ N
-                memory->ClearByteMode();                          // Clear byte mode
-                return instruction;
-              }
-            case 3: 
-              { // ASLB dst: Arithmetic Shift Left 
-                memory->SetByteMode();                            // Set byte mode ASLB
-                dst_temp = memory->Read(address(dst));            // Get value at dst
-                unsigned short tempCN = memory->ReadPS() & 0x9;   // Get C and N bits
-                tmp = dst_temp << 1;                              // Rotate bits to the right
-                memory->Write(address(dst),tmp & 0x00FF);         // Write to memory
-                resultIsZero(tmp);                                // Update Z bit
-                resultLTZero(tmp << 8);                                // Update N bit
-                update_flags((dst_temp & BYTE) >> 7,Cbit);        // Update C bit
-                update_flags((tempCN >> 3) ^ (tempCN & 01),Vbit); // Update V bit - C ^ N
-                memory->ClearByteMode();                          // Clear byte mode
-                return instruction;
-              }
-            default: break;
-          }/*}}}*/
-        }
+      result.reason = StopReason::Breakpoint;
+      return result;
     }
-  }/*}}}*/
 
-  // Double Operand Word Operations/*{{{*/
-  else if (iB[5] == 0 && iB[4] != 6)
-  {
-    switch (iB[4])
+    if (translate && budget - result.executed > MAX_BLOCK && !memory->Mapped())
     {
-      // MOV (src) -> (dst)
-      case 1:
-        {
-          src_temp = (memory->Read(address(src)));  // Get value at address of src MOV
-          if(address(dst) == 027 || address(dst) == 037 || iB[1] == 06 || iB[1] == 07)
-            memory->IncrementPC();
-          memory->Write(address(dst),src_temp);     // Write value to memory
-          resultIsZero(src_temp);                   // Update Z bit
-          resultLTZero(src_temp);                   // Update N bit
-          update_flags(0,Vbit);                     // Update V bit
-          return instruction;
-        }
+      unsigned long long left = budget - result.executed - MAX_BLOCK;
 
-        // CMP (src) + ~(dst) + 1
-      case 2:
-        {
-          src_temp = memory->Read(address(src));          // Get value at address of src CMP
-          dst_temp = memory->Read(address(dst));          // Get value at address of dst
-          dst_temp = ~(dst_temp) + 1;                     // Get two's compliment
-          int result = src_temp + dst_temp;               // Calculate result
-          //tmp = src_temp - dst_temp;                    // Compare values
-          resultIsZero(result);                           // Update Z bit
-          resultLTZero(result);                           // Update N bit
-          result & 0x10000? update_flags(0, Cbit) : update_flags(1,Cbit);	//Update C bit
-          (((src_temp & WORD) == (dst_temp & WORD)) && ((dst_temp & WORD) != (result & WORD)))? \
-                               update_flags(1,Vbit) : update_flags(0,Vbit);  // Update V bit
-
-          return instruction;
-        }
+      // Translated code keeps PS in a host register, so it must be current
+      this->SyncConditionCodes();
+      unsigned long long retired = this->translator->Execute(address, left < TRANSLATED_BUDGET ? left : TRANSLATED_BUDGET);
 
-        // BIT (src) ^ (dst)
-      case 3:
-        {
-          tmp = memory->Read(address(src)) & memory->Read(address(dst)); // Get test value BIT
-          resultIsZero(tmp);            // Update Z bit
-          resultLTZero(tmp);			// Update N bit
-          update_flags(0,Vbit);         // Update V bit
-          return instruction;
-        }
+      if (retired > 0)
+      {
+        this->instructionCount += retired;
+        this->cycleCount += this->translator->ExecutedCycles();
+        result.executed += retired;
+        continue;
+      }
+    }
 
-        // BIC ~(src) ^ (dst) -> (dst)
-      case 4:
-        {
-          tmp = ~(memory->Read(address(src))) & memory->Read(address(dst)); // Get ~src & dst value BIC
-          memory->Write(address(dst),tmp);                                  // Write value to dst
-          resultIsZero(tmp);                                                // Update Z bit
-          resultLTZero(tmp);                                              // Update N bit
-          update_flags(0,Vbit);                                             // Update V bit
-          return instruction;
-        }
-        // BIS (src) V (dst) -> (dst)
-      case 5:
-        {
-          tmp = ((memory->Read(address(src))) | memory->Read(address(dst))); // Get ~src & dst value BIC
-          memory->Write(address(dst),tmp);                                  // Write value to dst
-          resultIsZero(tmp);                                                // Update Z bit
-          resultLTZero(tmp);                                              // Update N bit
-          update_flags(0,Vbit);                                             // Update V bit
-          return instruction;
-        }
+    if (this->pacing && (result.executed & (PACE_INTERVAL - 1)) == 0)
+    {
+      this->Pace();
     }
-  }/*}}}*/
 
-  // Double Operand Byte Operations/*{{{*/
-  else if (iB[5] == 1 && iB[4] != 6)
-  {
-    switch (iB[4])
+    // A faulting fetch counts against the budget, but as in Step() it is not an instruction
+    ++result.executed;
+
+    try
     {
-      // MOVB (src) -> (dst)
-      case 1:
-        {
-          memory->SetByteMode();                  // Set byte mode
-          src_temp = memory->Read(address(src));  // Get value at address of src
-          if(address(dst) == 027 || address(dst) == 037 || iB[1] == 06 || iB[1] == 07)
-            memory->IncrementPC();
-          memory->Write(address(dst),src_temp);   // Write value to memory
-          resultIsZero(src_temp);                 // Update Z bit
-          resultLTZero(src_temp << 8);            // Update N bit
-          update_flags(0,Vbit);                   // Update V bit
-          memory->ClearByteMode();                // Clear byte mode
-          return instruction;
-        }
+      const DecodedInstruction &decoded = this->Fetch<INSTRUMENT>(address);
+      ++this->instructionCount;
+      this->cycleCount += decoded.cycles;
+      memory->IncrementPC();
 
-        // CMPB (src) + ~(dst) + 1
-      case 2:
-        {
-          memory->SetByteMode();                          // Set byte mode
-          src_temp = memory->Read(address(src));          // Get value at address of src
-          dst_temp = memory->Read(address(dst));          // Get destination value
-          tmp = src_temp + ~(dst_temp) + 1;               // Compare values
-          resultIsZero(tmp);                              // Update Z bit
-          resultLTZero(tmp << 8);                              // Update N bit
-          (((src_temp & BYTE) & (dst_temp & BYTE)) && ((dst_temp & BYTE)^(tmp & BYTE)))? \
-            update_flags(0,Cbit) : update_flags(1,Cbit);  // Update C bit
-          (((src_temp & BYTE) ^ (dst_temp & BYTE)) && (~((dst_temp & WORD) ^ (tmp & BYTE)) & BYTE))? \
-            update_flags(1,Vbit) : update_flags(0,Vbit);  // Update V bit
-          memory->ClearByteMode();                        // Clear byte mode
-          return instruction;
-        }
+      if (INSTRUMENT == instrumentVerbose)
+      {
+        this->DumpState(decoded);
+      }
 
-        // BITB ~(src) ^ (dst)
-      case 3:
-        {
-          memory->SetByteMode();        // Set byte mode
-          tmp = memory->Read(address(src)) & memory->Read(address(dst)); // Get test value
-          resultIsZero(tmp);            // Update Z bit
-          resultLTZero(tmp << 8);		// Update N bit
-          update_flags(0,Vbit);         // Update V bit
-          memory->ClearByteMode();      // Clear byte mode
-          return instruction;
-        }
+      if ((this->*decoded.handler)(decoded) == 0)
+      {
+        result.reason = StopReason::Halt;
+        return result;
+      }
 
-        // BICB ~(src) ^ (dst) -> (dst)
-      case 4:
-        {
-          memory->SetByteMode();          // Set byte mode
-          tmp = ~(memory->Read(address(src))) & memory->Read(address(dst)); // Get ~src & dst value
-          memory->Write(address(dst),tmp);                                  // Write value to dst
-          resultIsZero(tmp);                                                // Update Z bit
-          resultMSBIsOne(tmp << 8);                                         // Update N bit
-          update_flags(0,Vbit);                                             // Update V bit
-          memory->ClearByteMode();        // Clear byte mode
-          return instruction;
-        }
+      if ((stopConditions & stopOnWait) && decoded.opcode == Opcode::WAIT)
+      {
+        result.reason = StopReason::Wait;
+        return result;
+      }
+    }
 
-        //BISB (src) V (dst) -> (dst)
-      case 5:
-        {
-          memory->SetByteMode();        // Set byte mode
-          tmp = memory->Read(address(src)) | memory->Read(address(dst)); // Get value
-          memory->Write(address(dst),tmp);                               // Write value to dst
-          resultIsZero(tmp);            // Update Z bit
-          resultLTZero(tmp << 8);	// Update N bit
-          update_flags(0,Vbit);         // Update V bit
-          memory->ClearByteMode();      // Clear byte mode
-          return instruction;
-        }
+    catch (const MemoryAbort &error)
+    {
+      if (!this->Trap(error.vector))
+      {
+        result.reason = StopReason::Halt;
+        return result;
+      }
     }
-  }
 
-  // ADD or SUB operation
-  else if (iB[4] == 6)
-  {
-    // ADD
-    if (iB[5] == 0)
+    if (checkWatchpoints && memory->WatchTriggered())
     {
-      src_temp = memory->Read(address(src));  // Get source value ADD
-      dst_temp = memory->Read(address(dst));  // Get destination value
-      unsigned int result = src_temp + dst_temp;       // Add src and dst
-      memory->Write(address(dst),result);     // Write result to memory
-      resultIsZero(result);                   // Update Z bit
-      resultLTZero(result);                   // Update N bit
-      (result & 0xF0000) > 0? update_flags(1,Cbit) : update_flags(0,Cbit);
-      (((src_temp & WORD) == (dst_temp & WORD)) && ((result & WORD) != (dst_temp & WORD)))? \
-                           update_flags(1,Vbit) : update_flags(0,Vbit);
-      return instruction;
+      result.reason = StopReason::Watchpoint;
+      return result;
     }
 
-    // SUB
-    else
+    if ((stopConditions & stopOnOddPC) && (memory->RetrievePC() & 01))
     {
-      dst_temp = memory->Read(address(dst));    // Get value of dst SUB
-      src_temp = memory->Read(address(src));    // Get value of src
-      unsigned int result = dst_temp + ~(src_temp) + 1;  // Subtract
-      memory->Write(address(dst), result);         // Write to memory
-      resultIsZero(result);                        // Update Z bit
-      resultLTZero(result);                        // Update N bit
-      (result & 0x10000)? update_flags(0,Cbit) : update_flags(1,Cbit);
-      (((src_temp & WORD) != (dst_temp & WORD)) && ((result & WORD) == (src_temp & WORD)))? \
-                             update_flags(1,Vbit) : update_flags(0,Vbit);
-      return instruction;
+      result.reason = StopReason::OddPC;
+      return result;
     }
   }
 
-  // SHOULD NOT EVER REACH THIS POINT
-  // PLUG IN WARNING
-  return 0;
+  result.reason = StopReason::Budget;
+  return result;
+}
+/*}}}*/
+
+/*
+ * Picks up the new PC and PS from vector, which is read in kernel space,
+ * and pushes the old PS and PC on the stack of the mode the new PS selects,
+ * recording the old mode as the previous one.  An abort on the way is a
+ * double bus error and the processor gives up with the old PS back in
+ * place, returning false.
+ */
+bool CPU::Trap(unsigned short vector)/*{{{*/
+{
+  unsigned short status = memory->ReadPS();
+
+  try
+  {
+    unsigned short pc = this->reg[7];
+    memory->WritePS(status & 037777);
+    unsigned short newPC = memory->ReadWord(vector);
+    unsigned short newStatus = memory->ReadWord(vector + 2);
+    memory->WritePS((newStatus & ~030000) | ((status >> 2) & 030000));
+    this->reg[6] -= 2;
+    memory->WriteWord(this->reg[6], status);
+    this->reg[6] -= 2;
+    memory->WriteWord(this->reg[6], pc);
+    this->reg[7] = newPC;
+  }
+
+  catch (const MemoryAbort &error)
+  {
+    std::cout << "Warning: double bus error at " << std::oct << error.address << ", halting!" << std::endl;
+    memory->WritePS(status);
+    return false;
+  }
+
+  return true;
+}
+/*}}}*/
+
+// Real-time pacing/*{{{*/
+void CPU::SetPacing(bool enabled)
+{
+  this->pacing = enabled;
+}
+
+// Sleep off however far the guest has run ahead of the host clock
+void CPU::Pace()
+{
+  std::chrono::nanoseconds guest((this->cycleCount - this->paceCycles) * CYCLE_NS);
+  std::chrono::steady_clock::duration host = std::chrono::steady_clock::now() - this->paceStart;
+
+  if (guest > host)
+  {
+    std::this_thread::sleep_for(guest - host);
+  }
+}
+/*}}}*/
+
+// Breakpoints/*{{{*/
+void CPU::SetBreakpoint(unsigned short address)
+{
+  if (!this->IsBreakpoint(address))
+  {
+    this->breakMap[address >> 4] |= 1 << ((address >> 1) & 07);
+    ++this->breakpoints;
+  }
+}
+
+void CPU::ClearBreakpoint(unsigned short address)
+{
+  if (this->IsBreakpoint(address))
+  {
+    this->breakMap[address >> 4] &= ~(1 << ((address >> 1) & 07));
+    --this->breakpoints;
+  }
+}
+
+void CPU::ClearAllBreakpoints()
+{
+  for (int i = 0; i < 4096; ++i)
+  {
+    this->breakMap[i] = 0;
+  }
+
+  this->breakpoints = 0;
 }
 /*}}}*/
+
+unsigned long long CPU::TranslatedBlocks() const
+{
+  return this->translator ? this->translator->BlocksTranslated() : 0;
+}
+
+unsigned long long CPU::TranslatedInstructions() const
+{
+  return this->translator ? this->translator->TranslatedInstructions() : 0;
+}
+
+void CPU::DumpState(const DecodedInstruction &decoded)/*{{{*/
+{
+  std::cout << "********************************************************************************" << std::endl;
+  std::cout << "                                        BREAK" << std::endl;
+  std::cout << "********************************************************************************" << std::endl;
+  std::cout << std::endl;
+  std::cout << std::endl;
+  std::cout << std::endl;
+  std::cout << "********************************************************************************" << std::endl;
+  std::cout << std::endl;
+  std::cout << "                              INSTRUCTION #" << std::dec << this->instructionCount << std::endl;
+  std::cout << std::endl;
+  std::cout << "********************************************************************************" << std::endl;
+  std::cout << "Fetched instruction: " << std::oct << decoded.instruction << std::endl;
+  std::cout << std::endl;
+  this->memory->RegDump();
+}
 /*}}}*/
+
+// Decode cache/*{{{*/
+
+/*
+ * Returns the decoded instruction at address, decoding it only the first
+ * time it is executed.  Memory marks every cached word and calls back into
+ * InvalidateCode() when one of them is overwritten, so self-modifying code
+ * is picked up on its next execution.  Only unmapped RAM is cached, with
+ * memory management on every fetch is decoded afresh.
+ */
+template <Instrumentation INSTRUMENT>
+const DecodedInstruction &CPU::Fetch(unsigned short address)
+{
+  if ((address & 01) == 0 && address < memory->DirectLimit())
+  {
+    DecodedInstruction &entry = this->decodeCache[address >> 1];
+
+    if (entry.handler)
+    {
+      ++this->decodeCacheHits;
+
+      if (INSTRUMENT != instrumentNone)
+      {
+        this->memory->TraceDump(Transaction::instruction, address);
+      }
+
+      return entry;
+    }
+
+    ++this->decodeCacheMisses;
+    this->Decode(address, this->memory->ReadInstruction(), entry);
+    this->memory->MarkCode(address);
+    return entry;
+  }
+
+  this->Decode(address, this->memory->ReadInstruction(), this->uncached);
+  return this->uncached;
+}
+
+// Pull apart the instruction word fetched from address
+void CPU::Decode(unsigned short address, unsigned short instruction, DecodedInstruction &decoded)
+{
+  // Branch offset is a signed word count relative to the updated PC
+  short offset = static_cast<signed char>(instruction & 0x00FF);
+
+  decoded.opcode = this->dispatchTable[instruction];
+  decoded.handler = handlers[static_cast<int>(decoded.opcode)];
+  decoded.cycles = this->timingTable[instruction];
+  decoded.instruction = instruction;
+  decoded.branchTarget = address + 02 + offset * 2;
+  decoded.srcSpec = SRC(instruction);
+  decoded.dstSpec = DST(instruction);
+  Width width = OperandWidth(decoded.opcode);
+  decoded.readSrc = this->memory->Reader(decoded.srcSpec, width);
+  decoded.readDst = this->memory->Reader(decoded.dstSpec, width);
+  decoded.writeDst = this->memory->Writer(decoded.dstSpec, width);
+}
+
+/*
+ * Width of the operands an instruction works on.  TSTB has always read
+ * its operand as a whole word and keeps doing so.
+ */
+Width CPU::OperandWidth(Opcode opcode)
+{
+  switch (opcode)
+  {
+    case Opcode::CLRB: case Opcode::COMB: case Opcode::INCB: case Opcode::DECB:
+    case Opcode::NEGB: case Opcode::ADCB: case Opcode::SBCB:
+    case Opcode::RORB: case Opcode::ROLB: case Opcode::ASRB: case Opcode::ASLB:
+    case Opcode::MOVB: case Opcode::CMPB: case Opcode::BITB: case Opcode::BICB: case Opcode::BISB:
+      return byteWidth;
+
+    default:
+      return wordWidth;
+  }
+}
+
+void CPU::InvalidateCode(unsigned short address)
+{
+  if (address < IO_PAGE)
+  {
+    this->decodeCache[address >> 1].handler = NULL;
+  }
+
+  if (this->translator)
+  {
+    this->translator->Invalidate(address);
+  }
+}
+
+void CPU::InvalidateAllCode()
+{
+  for (unsigned int i = 0; i < IO_PAGE / 2; ++i)
+  {
+    this->decodeCache[i].handler = NULL;
+  }
+
+  if (this->translator)
+  {
+    this->translator->InvalidateAll();
+  }
+}
+/*}}}*/
+
+// Dispatch table/*{{{*/
+
+/*
+ * The table is built once, the first time a CPU is constructed, by
+ * running every possible instruction word through Decode().  Afterwards
+ * an instruction word reaches its handler with a single indexed load.
+ */
+#define HANDLER_ENTRY(name) &CPU::name,
+const InstructionHandler CPU::handlers[] =
+{
+  INSTRUCTION_LIST(HANDLER_ENTRY)
+};
+#undef HANDLER_ENTRY
+
+const Opcode *CPU::DispatchTable()
+{
+  struct Table
+  {
+    Opcode opcodes[65536];
+    Table()
+    {
+      for (unsigned int i = 0; i < 65536; ++i)
+      {
+        opcodes[i] = CPU::Decode(i);
+      }
+    }
+  };
+
+  static const Table table;
+  return table.opcodes;
+}
+
+/*
+ * Decode tree used to fill in the dispatch table.  Words that do not
+ * reach a handler map to Illegal, which stops the simulation the same
+ * way HALT does.
+ */
+Opcode CPU::Decode(unsigned short instruction)
+{
+  unsigned short iB[6];             // Dissected instruction word
+
+  iB[0] = (instruction & 0000007);
+  iB[1] = (instruction & 0000070) >> 3;
+  iB[2] = (instruction & 0000700) >> 6;
+  iB[3] = (instruction & 0007000) >> 9;
+  iB[4] = (instruction & 0070000) >> 12;
+  iB[5] = (instruction & 0100000) >> 15;
+
+  //condition bit operation, system instruction, or branch/*{{{*/
+  if(iB[4] == 0 && iB[3] <= 3)
+  {
+    //condition bit operation or system instruction/*{{{*/
+    if(!iB[5] && !iB[3] && !(iB[2] & 04))
+    {
+      switch(iB[2])
+      {
+        case 0: //system instruction
+          {
+            switch(iB[0])
+            {
+              case 0: return Opcode::HALT;
+              case 1: return Opcode::WAIT;
+              case 5: return Opcode::RESET;
+              default: return Opcode::Illegal;
+            }
+          }
+
+        case 1: return Opcode::JMP;
+
+        case 2: //Condition code operation
+          {
+            /*
+             * The clear and set groups share the low bits, so an
+             * unrecognized clear code falls through to the set codes.
+             */
+            switch(iB[1])
+            {
+              case 0: return Opcode::RTS;
+              case 4:
+                {
+                  switch(iB[0])
+                  {
+                    case 0: return Opcode::CLN;
+                    case 1: return Opcode::CLC;
+                    case 2: return Opcode::CLV;
+                    case 4: return Opcode::CLZ;
+                    default: return Opcode::Illegal;
+                  }
+                }
+              case 5:
+                {
+                  switch(iB[0])
+                  {
+                    case 0: return Opcode::CLN;
+                    case 1: return Opcode::SEC;
+                    case 2: return Opcode::SEV;
+                    case 4: return Opcode::SEZ;
+                    default: return Opcode::Illegal;
+                  }
+                }
+              case 6:
+                {
+                  switch(iB[0])
+                  {
+                    case 0: return Opcode::SEN;
+                    case 1: return Opcode::SEC;
+                    case 2: return Opcode::SEV;
+                    case 4: return Opcode::SEZ;
+                    default: return Opcode::Illegal;
+                  }
+                }
+              case 7: return (iB[0] == 0)? Opcode::SEN : Opcode::Illegal;
+              default: return Opcode::Illegal;
+            }
+          }
+
+        default: return Opcode::SWAB;
+      }
+    }/*}}}*/
+
+    //branch operations/*{{{*/
+    switch(iB[3])
+    {
+      case 0:	//BPL, BR, or BMI
+        if(iB[5])
+          return (iB[2] >= 3)? Opcode::BMI : Opcode::BPL;
+        return Opcode::BR;
+
+      case 1: //BNE, BHI, BLOS, BEQ
+        if(iB[5])
+          return (iB[2] <= 3)? Opcode::BHI : Opcode::BLOS;
+        return (iB[2] <= 3)? Opcode::BNE : Opcode::BEQ;
+
+      case 2:	//BVC, BGE, BVS, BLT
+        if(iB[5])
+          return (iB[2] <= 3)? Opcode::BVC : Opcode::BVS;
+        return (iB[2] <= 3)? Opcode::BGE : Opcode::BLT;
+
+      default:	//BGT, BCC, BLE, or BCS
+        if(iB[5])
+          return (iB[2] <= 3)? Opcode::BCC : Opcode::BCS;
+        return (iB[2] <= 3)? Opcode::BGT : Opcode::BLE;
+    }/*}}}*/
+  }/*}}}*/
+
+  // Single Operand Instructions (not including condition code instructions or branches)/*{{{*/
+  if (iB[4] == 0)
+  {
+    static const Opcode wordOps[3][8] =
+    {
+      { Opcode::JSR, Opcode::JSR, Opcode::JSR, Opcode::JSR, Opcode::JSR, Opcode::JSR, Opcode::JSR, Opcode::JSR },
+      { Opcode::CLR, Opcode::COM, Opcode::INC, Opcode::DEC, Opcode::NEG, Opcode::ADC, Opcode::SBC, Opcode::TST },
+      { Opcode::ROR, Opcode::ROL, Opcode::ASR, Opcode::ASL, Opcode::Illegal, Opcode::Illegal, Opcode::Illegal, Opcode::Illegal }
+    };
+    static const Opcode byteOps[3][8] =
+    {
+      { Opcode::Illegal, Opcode::Illegal, Opcode::Illegal, Opcode::Illegal, Opcode::Illegal, Opcode::Illegal, Opcode::Illegal, Opcode::Illegal },
+      { Opcode::CLRB, Opcode::COMB, Opcode::INCB, Opcode::DECB, Opcode::NEGB, Opcode::ADCB, Opcode::SBCB, Opcode::TSTB },
+      { Opcode::RORB, Opcode::ROLB, Opcode::ASRB, Opcode::ASLB, Opcode::Illegal, Opcode::Illegal, Opcode::Illegal, Opcode::Illegal }
+    };
+
+    if (iB[3] == 7)
+    {
+      return Opcode::Illegal;
+    }
+
+    return iB[5]? byteOps[iB[3] - 4][iB[2]] : wordOps[iB[3] - 4][iB[2]];
+  }/*}}}*/
+
+  // Double Operand Operations/*{{{*/
+  switch (iB[4])
+  {
+    case 1: return iB[5]? Opcode::MOVB : Opcode::MOV;
+    case 2: return iB[5]? Opcode::CMPB : Opcode::CMP;
+    case 3: return iB[5]? Opcode::BITB : Opcode::BIT;
+    case 4: return iB[5]? Opcode::BICB : Opcode::BIC;
+    case 5: return iB[5]? Opcode::BISB : Opcode::BIS;
+    case 6: return iB[5]? Opcode::SUB : Opcode::ADD;
+    default: return Opcode::Illegal;
+  }/*}}}*/
+}
+/*}}}*/
+
+// Instruction timing/*{{{*/
+
+/*
+ * Execution times follow the PDP-11/20 processor handbook's timing
+ * appendix for MM11 core memory, in cycles of CYCLE_NS.  An instruction
+ * takes its basic time plus the time to reach each operand, which depends
+ * only on the addressing mode.  Branches are charged the same whether or
+ * not they are taken.  Like the dispatch table, every instruction word is
+ * priced once up front so the engines only add decoded.cycles.
+ */
+static const unsigned int sourceTime[8] = { 0, 15, 15, 30, 15, 30, 30, 46 };
+static const unsigned int destinationTime[8] = { 0, 14, 14, 29, 14, 29, 29, 44 };
+static const unsigned int jumpTime[8] = { 0, 0, 0, 15, 0, 15, 15, 30 };
+
+const unsigned int *CPU::TimingTable()
+{
+  struct Table
+  {
+    unsigned int cycles[65536];
+    Table()
+    {
+      const Opcode *opcodes = CPU::DispatchTable();
+
+      for (unsigned int i = 0; i < 65536; ++i)
+      {
+        Opcode opcode = opcodes[i];
+        cycles[i] = CPU::BasicTime(opcode);
+
+        if (opcode >= Opcode::MOV)
+        {
+          cycles[i] += sourceTime[SRC(i) >> 3] + destinationTime[DST(i) >> 3];
+        }
+
+        else if (opcode >= Opcode::SWAB)
+        {
+          cycles[i] += destinationTime[DST(i) >> 3];
+        }
+
+        else if (opcode == Opcode::JMP || opcode == Opcode::JSR)
+        {
+          cycles[i] += jumpTime[DST(i) >> 3];
+        }
+      }
+    }
+  };
+
+  static const Table table;
+  return table.cycles;
+}
+
+// Time for an instruction with both operands in registers
+unsigned int CPU::BasicTime(Opcode opcode)
+{
+  switch (opcode)
+  {
+    case Opcode::HALT: case Opcode::WAIT: case Opcode::Illegal:
+      return 18;
+
+    case Opcode::RESET:
+      return 200000;            // The bus INIT pulse lasts 20 ms
+
+    case Opcode::JMP:
+      return 12;
+
+    case Opcode::JSR: case Opcode::RTS:
+      return 35;
+
+    case Opcode::CLC: case Opcode::CLV: case Opcode::CLZ: case Opcode::CLN:
+    case Opcode::SEC: case Opcode::SEV: case Opcode::SEZ: case Opcode::SEN:
+      return 15;
+
+    case Opcode::BR: case Opcode::BNE: case Opcode::BEQ: case Opcode::BGE:
+    case Opcode::BLT: case Opcode::BGT: case Opcode::BLE: case Opcode::BPL:
+    case Opcode::BMI: case Opcode::BHI: case Opcode::BLOS: case Opcode::BVC:
+    case Opcode::BVS: case Opcode::BCC: case Opcode::BCS:
+      return 26;
+
+    default:                    // Single and double operand operations
+      return 23;
+  }
+}
+/*}}}*/
+
+// Condition code helpers/*{{{*/
+inline void CPU::UpdateFlags(unsigned short i, unsigned short bit)
+{
+  unsigned short temp = this->ConditionCodes();
+
+  if (i == 0) {
+    this->reg[8] = temp & ~(bit);
+  }
+  else {
+    this->reg[8] = temp | bit;
+  }
+}
+
+// Remember what set the condition codes instead of working them out now
+inline void CPU::Defer(FlagOp op, unsigned int result, unsigned short src, unsigned short dst)
+{
+  // Anything that leaves C alone still needs the C owed by the last operation
+  if (op < FlagOp::Test && this->flagOp >= FlagOp::Test)
+  {
+    this->EvaluateFlags();
+  }
+
+  this->flagOp = op;
+  this->flagResult = result;
+  this->flagSrc = src;
+  this->flagDst = dst;
+}
+
+// PS with the condition codes brought up to date
+inline unsigned short CPU::ConditionCodes()
+{
+  if (this->flagOp != FlagOp::None)
+  {
+    this->EvaluateFlags();
+  }
+
+  return this->reg[8];
+}
+
+void CPU::SyncConditionCodes()
+{
+  this->ConditionCodes();
+}
+
+/*
+ * Works out N/Z/V/C for the deferred operation and merges them into PS.
+ * Each case reproduces the flag rules of the handler that deferred it,
+ * quirks included.  Shifts and rotates already read PS for C and N, so
+ * they hand over C and V precomputed in src and dst.
+ */
+void CPU::EvaluateFlags()
+{
+  unsigned int result = this->flagResult;
+  unsigned short word = result;
+  unsigned short src = this->flagSrc;
+  unsigned short dst = this->flagDst;
+  bool n = false, z = false, v = false, c = false;
+
+  switch (this->flagOp)
+  {
+    case FlagOp::None:
+      return;
+
+    case FlagOp::Logic:
+    case FlagOp::Test:
+      n = word & WORD;
+      z = word == 0;
+      break;
+
+    case FlagOp::LogicByte:
+    case FlagOp::TestByte:
+      n = word & BYTE;
+      z = word == 0;
+      break;
+
+    case FlagOp::Inc:
+      n = word & WORD;
+      z = word == 0;
+      v = dst == 0077777;
+      break;
+
+    case FlagOp::IncByte:
+      n = word & BYTE;
+      z = word == 0;
+      v = dst == 0x00FF;
+      break;
+
+    case FlagOp::Dec:
+      n = word & WORD;
+      z = word == 0;
+      v = dst == 0100000;
+      break;
+
+    case FlagOp::Complement:
+      n = word & WORD;
+      z = word == 0;
+      c = true;
+      break;
+
+    case FlagOp::Neg:
+      n = word & WORD;
+      z = word == 0;
+      v = word == 0100000;
+      c = word != 0;
+      break;
+
+    case FlagOp::NegByte:
+      n = word & BYTE;
+      z = word == 0;
+      v = word == BYTE;
+      c = word != 0;
+      break;
+
+    case FlagOp::Adc:
+      n = word & WORD;
+      z = word == 0;
+      v = dst == 0077777 && src == 1;
+      c = dst == 0177777 && src == 1;
+      break;
+
+    case FlagOp::AdcByte:
+      n = word & BYTE;
+      z = word == 0;
+      v = word == 0x007F;
+      c = dst == 0x00FF && src == 1;
+      break;
+
+    case FlagOp::Sbc:
+      n = word & WORD;
+      z = word == 0;
+      v = word == 0100000;
+      c = !(word == 0 && src == 1);
+      break;
+
+    case FlagOp::SbcByte:
+      n = word & BYTE;
+      z = word == 0;
+      v = word & BYTE;
+      c = !(word == 0 && src == 1);
+      break;
+
+    case FlagOp::Shift:
+      n = word & WORD;
+      z = word == 0;
+      v = dst;
+      c = src;
+      break;
+
+    case FlagOp::ShiftByte:
+      n = word & BYTE;
+      z = word == 0;
+      v = dst;
+      c = src;
+      break;
+
+    case FlagOp::Add:
+      n = word & WORD;
+      z = word == 0;
+      v = ((src & WORD) == (dst & WORD)) && ((result & WORD) != (dst & WORD));
+      c = (result & 0xF0000) > 0;
+      break;
+
+    case FlagOp::Sub:
+      n = word & WORD;
+      z = word == 0;
+      v = ((src & WORD) != (dst & WORD)) && ((result & WORD) == (src & WORD));
+      c = !(result & 0x10000);
+      break;
+
+    case FlagOp::Cmp:
+      n = word & WORD;
+      z = word == 0;
+      v = ((src & WORD) == (dst & WORD)) && ((dst & WORD) != (result & WORD));
+      c = !(result & 0x10000);
+      break;
+
+    case FlagOp::CmpByte:
+      n = word & BYTE;
+      z = word == 0;
+      v = ((src & BYTE) ^ (dst & BYTE)) && (~((dst & WORD) ^ (word & BYTE)) & BYTE);
+      c = !(((src & BYTE) & (dst & BYTE)) && ((dst & BYTE) ^ (word & BYTE)));
+      break;
+  }
+
+  unsigned short mask = (this->flagOp < FlagOp::Test)? (Nbit | Zbit | Vbit) : (Nbit | Zbit | Vbit | Cbit);
+  unsigned short flags = (n? Nbit : 0) | (z? Zbit : 0) | (v? Vbit : 0) | (c? Cbit : 0);
+  this->reg[8] = (this->reg[8] & ~mask) | flags;
+  this->flagOp = FlagOp::None;
+}
+/*}}}*/
+
+// System instructions/*{{{*/
+int CPU::HALT(const DecodedInstruction &)
+{
+  return 0;
+}
+
+int CPU::WAIT(const DecodedInstruction &)
+{
+  return 1;
+}
+
+int CPU::RESET(const DecodedInstruction &)
+{
+  return 5;
+}
+
+// SHOULD NOT EVER REACH THIS POINT
+// PLUG IN WARNING
+int CPU::Illegal(const DecodedInstruction &)
+{
+  return 0;
+}
+/*}}}*/
+
+// Program control/*{{{*/
+int CPU::JMP(const DecodedInstruction &decoded)
+{
+  unsigned short dst_temp = ReadDst(decoded); // Get address JMP
+  memory->Write(007, dst_temp);                             // Put in PC
+  return decoded.instruction;
+}
+
+int CPU::JSR(const DecodedInstruction &decoded)
+{
+  unsigned short tmp = memory->EA(decoded.dstSpec);  // Get address to jump to    JSR
+  unsigned short reg = memory->Read((decoded.srcSpec & 07)); // Get value of reg to store
+  memory->Write(046, reg);                            // Push value of reg onto stack
+  reg = (memory->Read(007));                          // Get value from PC
+  memory->Write((decoded.srcSpec & 07),reg);                // Write PC value to register
+  memory->Write(007,tmp - 02);                        // Write new address to PC
+  return decoded.instruction;
+}
+
+int CPU::RTS(const DecodedInstruction &decoded)
+{
+  unsigned short tmp = ReadDst(decoded); // Read register value
+  memory->Write(007, tmp);                             // reg --> (PC)
+  tmp = memory->Read(026);                             // Push value of reg onto stack
+  WriteDst(decoded, tmp);                 // pop reg
+  return decoded.instruction;
+}
+/*}}}*/
+
+// Condition code operations/*{{{*/
+int CPU::CLC(const DecodedInstruction &decoded)
+{
+  UpdateFlags(0, Cbit); // CLC
+  return decoded.instruction;
+}
+
+int CPU::CLV(const DecodedInstruction &decoded)
+{
+  UpdateFlags(0, Vbit); // CLV
+  return decoded.instruction;
+}
+
+int CPU::CLZ(const DecodedInstruction &decoded)
+{
+  UpdateFlags(0, Zbit); // CLZ
+  return decoded.instruction;
+}
+
+int CPU::CLN(const DecodedInstruction &decoded)
+{
+  UpdateFlags(0, Nbit); // CLN
+  return decoded.instruction;
+}
+
+int CPU::SEC(const DecodedInstruction &decoded)
+{
+  UpdateFlags(1, Cbit); // SEC
+  return decoded.instruction;
+}
+
+int CPU::SEV(const DecodedInstruction &decoded)
+{
+  UpdateFlags(1, Vbit); // SEV
+  return decoded.instruction;
+}
+
+int CPU::SEZ(const DecodedInstruction &decoded)
+{
+  UpdateFlags(1, Zbit); // SEZ
+  return decoded.instruction;
+}
+
+int CPU::SEN(const DecodedInstruction &decoded)
+{
+  UpdateFlags(1, Nbit); // SEN
+  return decoded.instruction;
+}
+/*}}}*/
+
+// Branches/*{{{*/
+
+int CPU::BR(const DecodedInstruction &decoded)
+{
+  memory->Write(007,decoded.branchTarget);                  // Branch always
+  return decoded.instruction;
+}
+
+int CPU::BNE(const DecodedInstruction &decoded)
+{
+  if ((this->ConditionCodes() & Zbit) == 0)         // Z = 0
+    memory->Write(007,decoded.branchTarget);
+  return decoded.instruction;
+}
+
+int CPU::BEQ(const DecodedInstruction &decoded)
+{
+  if ((this->ConditionCodes() & Zbit) > 0)          // Z = 1
+    memory->Write(007,decoded.branchTarget);
+  return decoded.instruction;
+}
+
+int CPU::BGE(const DecodedInstruction &decoded)
+{
+  unsigned short tmp = this->ConditionCodes();      // Get current process status
+  if ((((tmp & Nbit) >> 3) ^ ((tmp & Vbit) >> 1)) == 0)  // N ^ V = 0
+    memory->Write(007,decoded.branchTarget);
+  return decoded.instruction;
+}
+
+int CPU::BLT(const DecodedInstruction &decoded)
+{
+  unsigned short tmp = this->ConditionCodes();      // Get current process status
+  if ((((tmp & Nbit) >> 3) ^ ((tmp & Vbit) >> 1)) == 1)  // N ^ V = 1
+    memory->Write(007,decoded.branchTarget);
+  return decoded.instruction;
+}
+
+int CPU::BGT(const DecodedInstruction &decoded)
+{
+  unsigned short tmp = this->ConditionCodes();      // Get current process status
+  if ((((tmp & Zbit) >> 2) | (((tmp & Nbit) >> 3) ^ ((tmp & Vbit) >> 1))) == 0)  // Z | (N ^ V) = 0
+    memory->Write(007,decoded.branchTarget);
+  return decoded.instruction;
+}
+
+int CPU::BLE(const DecodedInstruction &decoded)
+{
+  unsigned short tmp = this->ConditionCodes();      // Get current process status
+  if ((((tmp & Zbit) >> 2) | (((tmp & Nbit) >> 3) ^ ((tmp & Vbit) >> 1))) == 1)  // Z | (N ^ V) = 1
+    memory->Write(007,decoded.branchTarget);
+  return decoded.instruction;
+}
+
+int CPU::BPL(const DecodedInstruction &decoded)
+{
+  if ((this->ConditionCodes() & Nbit) == 0)         // N = 0
+    memory->Write(007,decoded.branchTarget);
+  return decoded.instruction;
+}
+
+int CPU::BMI(const DecodedInstruction &decoded)
+{
+  if ((this->ConditionCodes() & Nbit) > 0)          // N = 1
+    memory->Write(007,decoded.branchTarget);
+  return decoded.instruction;
+}
+
+int CPU::BHI(const DecodedInstruction &decoded)
+{
+  if ((this->ConditionCodes() & (Zbit | Cbit)) == 0)  // C & Z = 0
+    memory->Write(007,decoded.branchTarget);
+  return decoded.instruction;
+}
+
+int CPU::BLOS(const DecodedInstruction &decoded)
+{
+  if ((this->ConditionCodes() & (Zbit | Cbit)) > 0)   // C | Z = 1
+    memory->Write(007,decoded.branchTarget);
+  return decoded.instruction;
+}
+
+int CPU::BVC(const DecodedInstruction &decoded)
+{
+  if ((this->ConditionCodes() & Vbit) == 0)         // V = 0
+    memory->Write(007,decoded.branchTarget);
+  return decoded.instruction;
+}
+
+int CPU::BVS(const DecodedInstruction &decoded)
+{
+  if ((this->ConditionCodes() & Vbit) == Vbit)      // V = 1
+    memory->Write(007,decoded.branchTarget);
+  return decoded.instruction;
+}
+
+int CPU::BCC(const DecodedInstruction &decoded)
+{
+  if ((this->ConditionCodes() & Cbit) == 0)         // C = 0
+    memory->Write(007,decoded.branchTarget);
+  return decoded.instruction;
+}
+
+int CPU::BCS(const DecodedInstruction &decoded)
+{
+  if ((this->ConditionCodes() & Cbit) == Cbit)      // C = 1
+    memory->Write(007,decoded.branchTarget);
+  return decoded.instruction;
+}
+/*}}}*/
+
+// Single Operand Word Operations/*{{{*/
+int CPU::SWAB(const DecodedInstruction &decoded)
+{
+  unsigned short tmp = ReadDst(decoded);  // Get value at effective address // SWAB
+  unsigned short byte_temp = tmp << 8;    // Create temp and give it LSByte of value in MSByte
+  tmp = (tmp >> 8) & 0x00FF;             // Shift MSByte into LSByte and clear MSByte
+  Defer(FlagOp::TestByte, tmp);           // N and Z from low order byte, clear C and V
+  tmp = byte_temp + tmp;                  // Finalize the swap byte
+  WriteDst(decoded, byte_temp); // Write to register
+  return decoded.instruction;
+}
+
+int CPU::CLR(const DecodedInstruction &decoded)
+{ // CLR dst - Clear Destination
+  WriteDst(decoded, 0);    // Clear value at address CLR
+  Defer(FlagOp::Test, 0);           // Set Z bit, clear N, C and V
+  return decoded.instruction;
+}
+
+int CPU::COM(const DecodedInstruction &decoded)
+{ // COM dst: ~(dst) -> (dst)
+  unsigned short tmp = ReadDst(decoded);  // Get value at address COM
+  tmp = ~tmp;                        // Compliment value
+  WriteDst(decoded, tmp);  // Write compiment to memory
+  Defer(FlagOp::Complement, tmp);    // Update N and Z, set C, clear V
+  return decoded.instruction;
+}
+
+int CPU::INC(const DecodedInstruction &decoded)
+{ // INC dst: (dst)++ -> (dst)
+  unsigned short dst_temp = ReadDst(decoded); // Get value at address INC
+  unsigned short tmp = dst_temp + 1;                // Increment value
+  WriteDst(decoded, tmp);  // Write to memory
+  Defer(FlagOp::Inc, tmp, 0, dst_temp); // Update N, Z and V, C bit not affected
+  return decoded.instruction;
+}
+
+int CPU::DEC(const DecodedInstruction &decoded)
+{ // DEC dst: (dst)-- -> (dst)
+  unsigned short dst_temp = ReadDst(decoded);  // Get value at address DEC
+  unsigned short tmp = dst_temp - 1;                     // Decrement value
+  WriteDst(decoded, tmp);       // Write to memory
+  //C bit not affected (typo in handbook)
+  Defer(FlagOp::Dec, tmp, 0, dst_temp);   // Update N, Z and V
+  return decoded.instruction;
+}
+
+int CPU::NEG(const DecodedInstruction &decoded)
+{ // NEG dst: -(dst) -> (dst)
+  unsigned short tmp = ReadDst(decoded);       // Get value at address NEG
+  tmp = ~tmp + 1;                         // Get 2's comp of value
+  WriteDst(decoded, tmp);        // Write to memory
+  Defer(FlagOp::Neg, tmp);                // Update N, Z, C and V
+  return decoded.instruction;
+}
+
+int CPU::ADC(const DecodedInstruction &decoded)
+{ // ADC: (dst) + (C) -> (dst)
+  unsigned short dst_temp = ReadDst(decoded);    // Get value at address ADC
+  unsigned short tmpC = this->ConditionCodes();   // Get current value of PS
+  tmpC = tmpC & 0x1;                        // Get C bit value
+  unsigned short tmp = dst_temp + (tmpC);                  // Add C bit to value
+  WriteDst(decoded, tmp);          // Write to memory
+  Defer(FlagOp::Adc, tmp, tmpC, dst_temp);  // Update N, Z, C and V
+  return decoded.instruction;
+}
+
+int CPU::SBC(const DecodedInstruction &decoded)
+{ // SBC: (dst) - (C) -> (dst)
+  unsigned short tmp = ReadDst(decoded);         // Get value at address SBC
+  unsigned short tmpC = this->ConditionCodes();   // Get current value of PS
+  tmpC = tmpC & 0x1;                        // Get C bit value
+  tmp = tmp - tmpC;                         // Add C bit to value
+  WriteDst(decoded, tmp);          // Write to memory
+  Defer(FlagOp::Sbc, tmp, tmpC);            // Update N, Z, C and V
+  return decoded.instruction;
+}
+
+int CPU::TST(const DecodedInstruction &decoded)
+{ // TST dst - Tests if dst is 0 (0 - dst)
+  unsigned short tmp = ReadDst(decoded); // Get value at address TST
+  tmp = 0 - tmp;                    // Perform test
+  Defer(FlagOp::Test, tmp);         // Update N and Z, clear C and V
+  return decoded.instruction;
+}
+
+int CPU::ROR(const DecodedInstruction &decoded)
+{ // ROR dst: ROtate Rigtht - include C bit as MSB -> (dst)
+  unsigned short dst_temp = ReadDst(decoded);  // Get value at dst
+  unsigned short tempCN = this->ConditionCodes() & 0x9; // Get C and N bits
+  unsigned short tmp = (dst_temp >> 1) | ((tempCN & 01) << 15);  // Rotate bits to the right
+  WriteDst(decoded, tmp);         // Write to memory
+  Defer(FlagOp::Shift, tmp, dst_temp & 01, (tempCN >> 3) ^ (tempCN & 01)); // Update N and Z, C, and V - C ^ N
+  return decoded.instruction;
+}
+
+int CPU::ROL(const DecodedInstruction &decoded)
+{ // ROL dst: ROtate Left - include C bit as LSB -> (dst)
+  unsigned short dst_temp = ReadDst(decoded);  // Get value at dst
+  unsigned short tempCN = (this->ConditionCodes() & 0x9); // Get C and N bits
+  unsigned short tmp = ((dst_temp << 1) | (tempCN & 01));  // Rotate bits to the right
+  WriteDst(decoded, tmp);         // Write to memory
+  Defer(FlagOp::Shift, tmp, (dst_temp & WORD) >> 15, (tempCN >> 3) ^ (tempCN & 01)); // Update N and Z, C, and V - C ^ N
+  return decoded.instruction;
+}
+
+int CPU::ASR(const DecodedInstruction &decoded)
+{ // ASR dst: Arithmetic Shift Right
+  unsigned short dst_temp = ReadDst(decoded);  // Get value at dst
+  unsigned short tempCN = this->ConditionCodes() & 0x9;     // Get C and N bits
+  unsigned short tmp = dst_temp >> 1;                    // Rotate bits to the right
+  if(dst_temp & WORD)			//If destination is negative
+    dst_temp = dst_temp | WORD;   	//then shift in a 1 on the end
+  WriteDst(decoded, tmp);        // Write to memory
+  Defer(FlagOp::Shift, tmp, (dst_temp & 01), (tempCN >> 3) ^ (tempCN & 01)); // Update N and Z, C, and V - C ^ N
+  return decoded.instruction;
+}
+
+int CPU::ASL(const DecodedInstruction &decoded)
+{ // ASL dst: Arithmetic Shift Left
+  unsigned short dst_temp = ReadDst(decoded);  // Get value at dst
+  unsigned short tempCN = this->ConditionCodes() & 0x9;    // Get C and N bits
+  unsigned short tmp = dst_temp << 1;                    // Rotate bits to the left
+  WriteDst(decoded, tmp);         // Write to memory
+  Defer(FlagOp::Shift, tmp, (dst_temp & WORD) >> 15, (tempCN >> 3) ^ (tempCN & 01)); // Update N and Z, C, and V - C ^ N
+  return decoded.instruction;
+}
+/*}}}*/
+
+// Single Operand Byte Operations /*{{{*/
+int CPU::CLRB(const DecodedInstruction &decoded)
+{ // CLRB dst - Clear Byte
+  unsigned short tmp = ReadDst(decoded); // Get value at dst
+  tmp = tmp & 0x0;                  // Clear byte
+  WriteDst(decoded, tmp);  // Write byte to dst
+  Defer(FlagOp::TestByte, 0);      // Set Z bit, clear N, C and V
+  return decoded.instruction;
+}
+
+int CPU::COMB(const DecodedInstruction &decoded)
+{ // COMB dst: ~(dst) -> (dst)
+  unsigned short tmp = ReadDst(decoded); // Get value at address
+  tmp = ~tmp & 0x00FF;              // Compliment value
+  WriteDst(decoded, tmp); // Write compiment to memory
+  Defer(FlagOp::NegByte, tmp);     // Update N, Z, C and V
+  return decoded.instruction;
+}
+
+int CPU::INCB(const DecodedInstruction &decoded)
+{ // INCB dst: (dst)++ -> (dst)
+  unsigned short dst_temp = ReadDst(decoded);  // Get value at address
+  unsigned short tmp = dst_temp + 1;                     // Increment value
+  WriteDst(decoded, tmp);       // Write to memory
+  Defer(FlagOp::IncByte, tmp, 0, dst_temp); // Update N, Z and V, C bit not affected
+  return decoded.instruction;
+}
+
+int CPU::DECB(const DecodedInstruction &decoded)
+{ // DECB dst: (dst)-- -> (dst)
+  unsigned short tmp = ReadDst(decoded); // Get value at address
+  tmp--;                            // Decrement value
+  WriteDst(decoded, tmp); // Write to memory
+  Defer(FlagOp::TestByte, tmp);    // Update N and Z, clear C and V
+  return decoded.instruction;
+}
+
+int CPU::NEGB(const DecodedInstruction &decoded)
+{ // NEGB dst: -(dst) -> (dst)
+  unsigned short tmp = ReadDst(decoded); // Get value at address
+  tmp = (~tmp) & 0x00FF;        // Get 2's comp of value
+  WriteDst(decoded, tmp);  // Write to memory
+  Defer(FlagOp::NegByte, tmp);     // Update N, Z, C and V
+  return decoded.instruction;
+}
+
+int CPU::ADCB(const DecodedInstruction &decoded)
+{ // ADCB: (dst) + (C) -> (dst)
+  unsigned short dst_temp = ReadDst(decoded);  // Get value at address
+  unsigned short tmpC = this->ConditionCodes(); // Get current value of PS
+  tmpC = tmpC & 0x1;                      // Get C bit value
+  unsigned short tmp = (dst_temp + (tmpC)) & 0x00FF;     // Add C bit to value
+  WriteDst(decoded, tmp);        // Write to memory
+  Defer(FlagOp::AdcByte, tmp, tmpC, dst_temp); // Update N, Z, C and V
+  return decoded.instruction;
+}
+
+int CPU::SBCB(const DecodedInstruction &decoded)
+{ // SBCB: (dst) - (C) -> (dst)
+  unsigned short dst_temp = ReadDst(decoded);  // Get value at address
+  unsigned short tmpC = this->ConditionCodes(); // Get current value of PS
+  tmpC = tmpC & 0x1;                      // Get C bit value
+  unsigned short tmp = dst_temp - tmpC;                  // Add C bit to value
+  WriteDst(decoded, tmp);        // Write to memory
+  Defer(FlagOp::SbcByte, tmp, tmpC); // Update N, Z, C and V
+  return decoded.instruction;
+}
+
+int CPU::TSTB(const DecodedInstruction &decoded)
+{ // TSTB dst - Tests if dst is 0 (0 - dst)
+  unsigned short tmp = ReadDst(decoded); // Get value at address TST
+  tmp = 0 - tmp;                    // Perform test
+  Defer(FlagOp::TestByte, tmp);     // Update N and Z, clear C and V
+  return decoded.instruction;
+}
+
+int CPU::RORB(const DecodedInstruction &decoded)
+{ // RORB dst: ROtate Rigtht - include C bit as MSB -> (dst)
+  unsigned short dst_temp = ReadDst(decoded);            // Get value at dst
+  unsigned short tempCN = this->ConditionCodes() & 0x9;   // Get C and N bits
+  unsigned short tmp = (dst_temp >> 1) | ((tempCN & 01) << 7);     // Rotate bits to the right
+  WriteDst(decoded, tmp);                  // Write to memory
+  Defer(FlagOp::ShiftByte, tmp, dst_temp & 01, (tempCN >> 3) ^ (tempCN & 01)); // Update N and Z, C, and V - C ^ N
+  return decoded.instruction;
+}
+
+int CPU::ROLB(const DecodedInstruction &decoded)
+{ // ROLB dst: ROtate Left - include C bit as LSB -> (dst)
+  unsigned short dst_temp = ReadDst(decoded);            // Get value at dst
+  unsigned short tempCN = this->ConditionCodes() & 0x9;   // Get C and N bits
+  unsigned short tmp = (dst_temp << 1) | (tempCN & 01);            // Rotate bits to the right
+  WriteDst(decoded, tmp & 0x00FF);         // Write to memory
+  Defer(FlagOp::ShiftByte, tmp, (dst_temp & BYTE) >> 7, (tempCN >> 3) ^ (tempCN & 01)); // Update N and Z, C, and V - C ^ N
+  return decoded.instruction;
+}
+
+int CPU::ASRB(const DecodedInstruction &decoded)
+{ // ASRB dst: Arithmetic Shift Right
+  unsigned short dst_temp = ReadDst(decoded);            // Get value at dst
+  unsigned short tempCN = this->ConditionCodes() & 0x9;   // Get C and N bits
+  unsigned short tmp = dst_temp >> 1;                              // Rotate bits to the right
+  WriteDst(decoded, tmp);                  // Write to memory
+  Defer(FlagOp::ShiftByte, tmp, (dst_temp & 01), (tempCN >> 3) ^ (tempCN & 01)); // Update N and Z, C, and V - C ^ N
+  return decoded.instruction;
+}
+
+int CPU::ASLB(const DecodedInstruction &decoded)
+{ // ASLB dst: Arithmetic Shift Left
+  unsigned short dst_temp = ReadDst(decoded);            // Get value at dst
+  unsigned short tempCN = this->ConditionCodes() & 0x9;   // Get C and N bits
+  unsigned short tmp = dst_temp << 1;                              // Rotate bits to the right
+  WriteDst(decoded, tmp & 0x00FF);         // Write to memory
+  Defer(FlagOp::ShiftByte, tmp, (dst_temp & BYTE) >> 7, (tempCN >> 3) ^ (tempCN & 01)); // Update N and Z, C, and V - C ^ N
+  return decoded.instruction;
+}
+/*}}}*/
+
+// Double Operand Word Operations/*{{{*/
+int CPU::MOV(const DecodedInstruction &decoded)
+{ // MOV (src) -> (dst)
+  unsigned short src_temp = (ReadSrc(decoded));  // Get value at address of src MOV
+  WriteDst(decoded, src_temp);     // Write value to memory
+
+  // A destination store finds its extra word at PC, so step past it afterwards
+  if(decoded.dstSpec == 027 || decoded.dstSpec == 037 || (decoded.dstSpec >> 3) >= 06)
+    memory->IncrementPC();
+  Defer(FlagOp::Logic, src_temp);   // Update N and Z, clear V
+  return decoded.instruction;
+}
+
+int CPU::CMP(const DecodedInstruction &decoded)
+{ // CMP (src) + ~(dst) + 1
+  unsigned short src_temp = ReadSrc(decoded);          // Get value at address of src CMP
+  unsigned short dst_temp = ReadDst(decoded);          // Get value at address of dst
+  dst_temp = ~(dst_temp) + 1;                     // Get two's compliment
+  int result = src_temp + dst_temp;               // Calculate result
+  Defer(FlagOp::Cmp, result, src_temp, dst_temp); // Update N, Z, C and V
+  return decoded.instruction;
+}
+
+int CPU::BIT(const DecodedInstruction &decoded)
+{ // BIT (src) ^ (dst)
+  unsigned short tmp = ReadSrc(decoded) & ReadDst(decoded); // Get test value BIT
+  Defer(FlagOp::Logic, tmp);    // Update N and Z, clear V
+  return decoded.instruction;
+}
+
+int CPU::BIC(const DecodedInstruction &decoded)
+{ // BIC ~(src) ^ (dst) -> (dst)
+  unsigned short tmp = ~(ReadSrc(decoded)) & ReadDst(decoded); // Get ~src & dst value BIC
+  WriteDst(decoded, tmp);                                  // Write value to dst
+  Defer(FlagOp::Logic, tmp);                                        // Update N and Z, clear V
+  return decoded.instruction;
+}
+
+int CPU::BIS(const DecodedInstruction &decoded)
+{ // BIS (src) V (dst) -> (dst)
+  unsigned short tmp = ((ReadSrc(decoded)) | ReadDst(decoded)); // Get ~src & dst value BIC
+  WriteDst(decoded, tmp);                                  // Write value to dst
+  Defer(FlagOp::Logic, tmp);                                        // Update N and Z, clear V
+  return decoded.instruction;
+}
+
+int CPU::ADD(const DecodedInstruction &decoded)
+{ // ADD (src) + (dst) -> (dst)
+  unsigned short src_temp = ReadSrc(decoded);  // Get source value ADD
+  unsigned short dst_temp = ReadDst(decoded);  // Get destination value
+  unsigned int result = src_temp + dst_temp;       // Add src and dst
+  WriteDst(decoded, result);     // Write result to memory
+  Defer(FlagOp::Add, result, src_temp, dst_temp); // Update N, Z, C and V
+  return decoded.instruction;
+}
+
+int CPU::SUB(const DecodedInstruction &decoded)
+{ // SUB (dst) + ~(src) + 1 -> (dst)
+  unsigned short dst_temp = ReadDst(decoded);    // Get value of dst SUB
+  unsigned short src_temp = ReadSrc(decoded);    // Get value of src
+  unsigned int result = dst_temp + ~(src_temp) + 1;  // Subtract
+  WriteDst(decoded, result);         // Write to memory
+  Defer(FlagOp::Sub, result, src_temp, dst_temp); // Update N, Z, C and V
+  return decoded.instruction;
+}
+/*}}}*/
+
+// Double Operand Byte Operations/*{{{*/
+int CPU::MOVB(const DecodedInstruction &decoded)
+{ // MOVB (src) -> (dst)
+  unsigned short src_temp = ReadSrc(decoded);  // Get value at address of src
+  WriteDst(decoded, src_temp);   // Write value to memory
+
+  // As in MOV, the extra word is passed only once the store has used it
+  if(decoded.dstSpec == 027 || decoded.dstSpec == 037 || (decoded.dstSpec >> 3) >= 06)
+    memory->IncrementPC();
+  Defer(FlagOp::LogicByte, src_temp); // Update N and Z, clear V
+  return decoded.instruction;
+}
+
+int CPU::CMPB(const DecodedInstruction &decoded)
+{ // CMPB (src) + ~(dst) + 1
+  unsigned short src_temp = ReadSrc(decoded);          // Get value at address of src
+  unsigned short dst_temp = ReadDst(decoded);          // Get destination value
+  unsigned short tmp = src_temp + ~(dst_temp) + 1;               // Compare values
+  Defer(FlagOp::CmpByte, tmp, src_temp, dst_temp); // Update N, Z, C and V
+  return decoded.instruction;
+}
+
+int CPU::BITB(const DecodedInstruction &decoded)
+{ // BITB ~(src) ^ (dst)
+  unsigned short tmp = ReadSrc(decoded) & ReadDst(decoded); // Get test value
+  Defer(FlagOp::LogicByte, tmp); // Update N and Z, clear V
+  return decoded.instruction;
+}
+
+int CPU::BICB(const DecodedInstruction &decoded)
+{ // BICB ~(src) ^ (dst) -> (dst)
+  unsigned short tmp = ~(ReadSrc(decoded)) & ReadDst(decoded); // Get ~src & dst value
+  WriteDst(decoded, tmp);                                  // Write value to dst
+  Defer(FlagOp::LogicByte, tmp);                                   // Update N and Z, clear V
+  return decoded.instruction;
+}
+
+int CPU::BISB(const DecodedInstruction &decoded)
+{ //BISB (src) V (dst) -> (dst)
+  unsigned short tmp = ReadSrc(decoded) | ReadDst(decoded); // Get value
+  WriteDst(decoded, tmp);                               // Write value to dst
+  Defer(FlagOp::LogicByte, tmp); // Update N and Z, clear V
+  return decoded.instruction;
+}
 /*}}}*/
 
 void CPU::SetDebugMode(Verbosity verbosity)/*{{{*/
@@ -1038,8 +1620,10 @@ void CPU::SetDebugMode(Verbosity verbosity)/*{{{*/
 }
 /*}}}*/
 
+// Back to the counts the program started from, those of its snapshot if it had one
 void CPU::ResetInstructionCount()/*{{{*/
 {
-  this->instructionCount = 0;
+  this->instructionCount = this->memory->InitialInstructions();
+  this->cycleCount = this->memory->InitialCycles();
   return;
 }/*}}}*/
@@ -1,23 +1,269 @@
 #ifndef CPU_H
 #define CPU_H
 
+#include <chrono>
 #include "memory.h"
 
-class CPU
+class CPU;
+class Translator;
+struct DecodedInstruction;
+
+// Every instruction the CPU implements, one handler each
+#define INSTRUCTION_LIST(X) \
+  X(HALT) X(WAIT) X(RESET) X(Illegal) \
+  X(JMP) X(JSR) X(RTS) \
+  X(CLC) X(CLV) X(CLZ) X(CLN) X(SEC) X(SEV) X(SEZ) X(SEN) \
+  X(BR) X(BNE) X(BEQ) X(BGE) X(BLT) X(BGT) X(BLE) X(BPL) X(BMI) \
+  X(BHI) X(BLOS) X(BVC) X(BVS) X(BCC) X(BCS) \
+  X(SWAB) X(CLR) X(COM) X(INC) X(DEC) X(NEG) X(ADC) X(SBC) X(TST) \
+  X(ROR) X(ROL) X(ASR) X(ASL) \
+  X(CLRB) X(COMB) X(INCB) X(DECB) X(NEGB) X(ADCB) X(SBCB) X(TSTB) \
+  X(RORB) X(ROLB) X(ASRB) X(ASLB) \
+  X(MOV) X(CMP) X(BIT) X(BIC) X(BIS) X(ADD) X(SUB) \
+  X(MOVB) X(CMPB) X(BITB) X(BICB) X(BISB)
+
+#define OPCODE_ENUM(name) name,
+enum class Opcode : unsigned char
+{
+  INSTRUCTION_LIST(OPCODE_ENUM)
+};
+#undef OPCODE_ENUM
+
+/*
+ * Operations that last set the condition codes.  Handlers only record the
+ * operation with its result and operands, the N/Z/V/C bits are worked out
+ * when something reads PS.  Operations before Test leave C alone.
+ */
+enum class FlagOp : unsigned char
+{
+  None,                         // PS already holds the condition codes
+  Logic, LogicByte, Inc, IncByte, Dec,
+  Test, TestByte, Complement, Neg, NegByte, Adc, AdcByte, Sbc, SbcByte,
+  Shift, ShiftByte, Add, Sub, Cmp, CmpByte
+};
+
+// Why CPU::Run() handed control back
+enum class StopReason
+{
+  Halt,                         // HALT or an unrecognized instruction word
+  Wait,                         // WAIT
+  Breakpoint,                   // PC reached a breakpoint
+  Watchpoint,                   // An instruction made a watched access
+  Budget,                       // The instruction budget ran out
+  OddPC                         // An instruction left the PC odd
+};
+
+// Stops CPU::Run() may be asked for, HALT and the budget always stop it
+enum StopCondition
+{
+  stopOnWait = 01,
+  stopOnBreakpoint = 02,
+  stopOnOddPC = 04,
+  stopOnWatchpoint = 010
+};
+
+// Instrumentation compiled into an execution engine, see CPU::Instrumented()
+enum Instrumentation
+{
+  instrumentNone,
+  instrumentTrace,              // Trace records for every access
+  instrumentVerbose             // A state dump before every instruction as well
+};
+
+struct RunResult
+{
+  StopReason reason;
+  unsigned long long executed;  // Instructions retired by this call
+};
+
+// Budget for runs that should only end on a stop condition
+#define UNLIMITED_BUDGET 0xFFFFFFFFFFFFFFFFULL
+
+// Length of one cycle in CPU::Cycles(), the resolution of the 11/20 timing tables
+#define CYCLE_NS 100
+
+// Every instruction word is dispatched straight to one of these handlers
+typedef int (CPU::*InstructionHandler)(const DecodedInstruction &decoded);
+
+// An instruction word with its operand fields already pulled apart
+struct DecodedInstruction
+{
+  InstructionHandler handler;   // NULL when the cache entry is empty
+  unsigned short instruction;   // Raw instruction word
+  unsigned short branchTarget;  // Destination if this is a taken branch
+  unsigned char srcSpec;        // Source mode and register
+  unsigned char dstSpec;        // Destination mode and register
+  Opcode opcode;                // Index into the handler and label tables
+  unsigned int cycles;          // Estimated execution time, see TimingTable()
+  OperandReader readSrc;        // Operand accessors for srcSpec and dstSpec
+  OperandReader readDst;
+  OperandWriter writeDst;
+};
+
+class CPU : public CodeObserver, public ConditionCodeSource
 {
   public:
     CPU(Memory *memory);
     ~CPU();
     short EA(short encodedAddress);
     int FDE();
+    RunResult Run(unsigned long long budget, unsigned int stopConditions = stopOnBreakpoint);
+    int RunThreaded();
+    void EnableTranslation();
+    void SetBreakpoint(unsigned short address);
+    void ClearBreakpoint(unsigned short address);
+    void ClearAllBreakpoints();
     void SetDebugMode(Verbosity verbosity);
     void ResetInstructionCount();
+    unsigned long long InstructionCount() const { return instructionCount; };
+    unsigned long long Cycles() const { return cycleCount; };
+    bool SaveSnapshot(const std::string &path) { return memory->SaveSnapshot(path, instructionCount, cycleCount); };
+    void SetPacing(bool enabled);
+    unsigned long long DecodeCacheHits() const { return decodeCacheHits; };
+    unsigned long long DecodeCacheMisses() const { return decodeCacheMisses; };
+    unsigned long long TranslatedBlocks() const;
+    unsigned long long TranslatedInstructions() const;
+
+    // CodeObserver
+    void InvalidateCode(unsigned short address);
+    void InvalidateAllCode();
+
+    // ConditionCodeSource
+    void SyncConditionCodes();
 
   private:
+    static const InstructionHandler handlers[];
+    static const Opcode *DispatchTable();
+    static const unsigned int *TimingTable();
+    static unsigned int BasicTime(Opcode opcode);
+    static Opcode Decode(unsigned short instruction);
+    static Width OperandWidth(Opcode opcode);
+    void Decode(unsigned short address, unsigned short instruction, DecodedInstruction &decoded);
+    Instrumentation Instrumented() const;
+    template <Instrumentation INSTRUMENT> int Step();
+    template <Instrumentation INSTRUMENT> RunResult RunWith(unsigned long long budget, unsigned int stopConditions);
+    template <Instrumentation INSTRUMENT> int RunThreadedWith();
+    template <Instrumentation INSTRUMENT> const DecodedInstruction &Fetch(unsigned short address);
+    void DumpState(const DecodedInstruction &decoded);
+    void Pace();
+    bool Trap(unsigned short vector);
+    bool IsBreakpoint(unsigned short address) const { return breakMap[address >> 4] & (1 << ((address >> 1) & 07)); };
+
+    // Operand access through the accessors the decoder picked
+    unsigned short ReadSrc(const DecodedInstruction &decoded) { return (memory->*decoded.readSrc)(); };
+    unsigned short ReadDst(const DecodedInstruction &decoded) { return (memory->*decoded.readDst)(); };
+    void WriteDst(const DecodedInstruction &decoded, unsigned short data) { (memory->*decoded.writeDst)(data); };
+
+    // Condition code helpers
+    void UpdateFlags(unsigned short i, unsigned short bit);
+    void Defer(FlagOp op, unsigned int result, unsigned short src = 0, unsigned short dst = 0);
+    unsigned short ConditionCodes();
+    void EvaluateFlags();
+
+    // System instructions
+    int HALT(const DecodedInstruction &decoded);
+    int WAIT(const DecodedInstruction &decoded);
+    int RESET(const DecodedInstruction &decoded);
+    int Illegal(const DecodedInstruction &decoded);
+
+    // Program control
+    int JMP(const DecodedInstruction &decoded);
+    int JSR(const DecodedInstruction &decoded);
+    int RTS(const DecodedInstruction &decoded);
+
+    // Condition code operations
+    int CLC(const DecodedInstruction &decoded);
+    int CLV(const DecodedInstruction &decoded);
+    int CLZ(const DecodedInstruction &decoded);
+    int CLN(const DecodedInstruction &decoded);
+    int SEC(const DecodedInstruction &decoded);
+    int SEV(const DecodedInstruction &decoded);
+    int SEZ(const DecodedInstruction &decoded);
+    int SEN(const DecodedInstruction &decoded);
+
+    // Branches
+    int BR(const DecodedInstruction &decoded);
+    int BNE(const DecodedInstruction &decoded);
+    int BEQ(const DecodedInstruction &decoded);
+    int BGE(const DecodedInstruction &decoded);
+    int BLT(const DecodedInstruction &decoded);
+    int BGT(const DecodedInstruction &decoded);
+    int BLE(const DecodedInstruction &decoded);
+    int BPL(const DecodedInstruction &decoded);
+    int BMI(const DecodedInstruction &decoded);
+    int BHI(const DecodedInstruction &decoded);
+    int BLOS(const DecodedInstruction &decoded);
+    int BVC(const DecodedInstruction &decoded);
+    int BVS(const DecodedInstruction &decoded);
+    int BCC(const DecodedInstruction &decoded);
+    int BCS(const DecodedInstruction &decoded);
+
+    // Single operand word operations
+    int SWAB(const DecodedInstruction &decoded);
+    int CLR(const DecodedInstruction &decoded);
+    int COM(const DecodedInstruction &decoded);
+    int INC(const DecodedInstruction &decoded);
+    int DEC(const DecodedInstruction &decoded);
+    int NEG(const DecodedInstruction &decoded);
+    int ADC(const DecodedInstruction &decoded);
+    int SBC(const DecodedInstruction &decoded);
+    int TST(const DecodedInstruction &decoded);
+    int ROR(const DecodedInstruction &decoded);
+    int ROL(const DecodedInstruction &decoded);
+    int ASR(const DecodedInstruction &decoded);
+    int ASL(const DecodedInstruction &decoded);
+
+    // Single operand byte operations
+    int CLRB(const DecodedInstruction &decoded);
+    int COMB(const DecodedInstruction &decoded);
+    int INCB(const DecodedInstruction &decoded);
+    int DECB(const DecodedInstruction &decoded);
+    int NEGB(const DecodedInstruction &decoded);
+    int ADCB(const DecodedInstruction &decoded);
+    int SBCB(const DecodedInstruction &decoded);
+    int TSTB(const DecodedInstruction &decoded);
+    int RORB(const DecodedInstruction &decoded);
+    int ROLB(const DecodedInstruction &decoded);
+    int ASRB(const DecodedInstruction &decoded);
+    int ASLB(const DecodedInstruction &decoded);
+
+    // Double operand word operations
+    int MOV(const DecodedInstruction &decoded);
+    int CMP(const DecodedInstruction &decoded);
+    int BIT(const DecodedInstruction &decoded);
+    int BIC(const DecodedInstruction &decoded);
+    int BIS(const DecodedInstruction &decoded);
+    int ADD(const DecodedInstruction &decoded);
+    int SUB(const DecodedInstruction &decoded);
+
+    // Double operand byte operations
+    int MOVB(const DecodedInstruction &decoded);
+    int CMPB(const DecodedInstruction &decoded);
+    int BITB(const DecodedInstruction &decoded);
+    int BICB(const DecodedInstruction &decoded);
+    int BISB(const DecodedInstruction &decoded);
+
     int debugLevel;             // Debug verbosity level
     unsigned long long instructionCount;       // Statistics
+    unsigned long long cycleCount;             // Estimated 11/20 cycles, CYCLE_NS each
+    const Opcode *dispatchTable;               // Instruction word -> opcode
+    const unsigned int *timingTable;           // Instruction word -> cycles
+    DecodedInstruction *decodeCache;           // Decoded instructions by word address
+    DecodedInstruction uncached;               // Decode buffer for uncacheable fetches
+    unsigned long long decodeCacheHits;
+    unsigned long long decodeCacheMisses;
+    Translator *translator;                    // NULL unless translation is enabled
+    unsigned char *breakMap;                   // One bit per word with a breakpoint
+    unsigned int breakpoints;                  // Number of bits set in breakMap
+    FlagOp flagOp;                             // Operation the condition codes are owed for
+    unsigned int flagResult;                   // Its result
+    unsigned short flagSrc;                    // And its operands
+    unsigned short flagDst;
+    bool pacing;                               // Hold Run() to real 11/20 speed
+    std::chrono::steady_clock::time_point paceStart;   // Host time and cycle count
+    unsigned long long paceCycles;                     // pacing is measured from
     Memory *memory;             // RAM
-    short reg[9];               // General-purpose registers
+    unsigned short reg[9];      // General-purpose registers
                                 // R6 is the processor stack pointer
                                 // R7 is the program counter
                                 // R8 is the Processor Status Register
@@ -0,0 +1,857 @@
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "imageLoader.h"
+#include "memory.h"
+
+// Formatted binary record types in an object module
+#define RECORD_GSD 1
+#define RECORD_END_GSD 2
+#define RECORD_TEXT 3
+#define RECORD_RLD 4
+#define RECORD_ISD 5
+#define RECORD_END_MODULE 6
+
+// Global symbol directory entry types
+#define GSD_SECTION 1
+#define GSD_SYMBOL 4
+#define GSD_TRANSFER 3
+#define GSD_PSECT 5
+
+// Section and symbol flags
+#define FLAG_DEFINED 010
+#define FLAG_RELOCATABLE 040
+
+// Relocation record bytes
+#define RLD_BYTE 0200           // Only the low byte of the word is relocated
+#define RLD_TYPE 0177
+
+// Name of the absolute section, ". ABS." in RAD50
+#define ABS_NAME 025700207624U
+
+// Gives a RAD50 name back as text for errors
+static std::string Rad50(unsigned int name)
+{
+  static const char characters[] = " ABCDEFGHIJKLMNOPQRSTUVWXYZ$.%0123456789";
+  std::string text;
+
+  for (int half = 16; half >= 0; half -= 16)
+  {
+    unsigned int word = (name >> half) & 0xFFFF;
+    text += characters[(word / 03100) % 050];
+    text += characters[(word / 050) % 050];
+    text += characters[word % 050];
+  }
+
+  return text.substr(0, text.find_last_not_of(' ') + 1);
+}
+
+static unsigned short Word(const unsigned char *bytes)
+{
+  return bytes[0] | (bytes[1] << 8);
+}
+
+ImageLoader::ImageLoader(unsigned char *bytes, unsigned int size)/*{{{*/
+{
+  this->bytes = bytes;
+  this->size = size;
+  this->hasStartPC = false;
+  this->startPC = 0;
+  this->block = 0;
+  this->current = 0;
+  this->transferName = ABS_NAME;
+  this->transferOffset = 1;
+}
+/*}}}*/
+
+// Maps the file and loads it, false with Error() set if it cannot be read or is malformed
+bool ImageLoader::Load(const std::string &path)/*{{{*/
+{
+  this->path = path;
+  this->error.clear();
+  // Opened through stdio, unistd.h's read() and write() clash with Transaction
+  FILE *file = std::fopen(path.c_str(), "rb");
+
+  if (file == NULL)
+  {
+    this->error = "cannot open " + path + ": " + std::strerror(errno);
+    return false;
+  }
+
+  struct stat status;
+
+  if (fstat(fileno(file), &status) != 0 || status.st_size == 0)
+  {
+    std::fclose(file);
+    this->error = path + " is empty";
+    return false;
+  }
+
+  void *mapped = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+  std::fclose(file);
+
+  if (mapped == MAP_FAILED)
+  {
+    this->error = "cannot map " + path + ": " + std::strerror(errno);
+    return false;
+  }
+
+  madvise(mapped, status.st_size, MADV_SEQUENTIAL);
+  const unsigned char *data = static_cast<const unsigned char *>(mapped);
+  const unsigned char *end = data + status.st_size;
+  bool loaded;
+
+  switch (Detect(path, data, end))
+  {
+    case imageObject:
+      loaded = this->LoadObject(data, end);
+      break;
+
+    case imageAbsolute:
+      loaded = this->LoadAbsolute(data, end);
+      break;
+
+    case imageRaw:
+      loaded = this->LoadRaw(data, end);
+      break;
+
+    default:
+      loaded = this->LoadAscii(reinterpret_cast<const char *>(data), reinterpret_cast<const char *>(end));
+  }
+
+  munmap(mapped, status.st_size);
+  return loaded;
+}
+/*}}}*/
+
+/*
+ * Works out the format from the extension: .obj, .lda, or .bin, .raw and
+ * .img for raw images.  Any other file is judged by its first bytes: text
+ * starts with an entry, a formatted binary block with a symbol directory
+ * record is an object module and any other block is an absolute loader
+ * tape.  What is left is a raw image.
+ */
+ImageFormat ImageLoader::Detect(const std::string &path, const unsigned char *data, const unsigned char *end)/*{{{*/
+{
+  std::string extension = path.substr(path.find_last_of('.') + 1);
+
+  for (std::string::iterator letter = extension.begin(); letter != extension.end(); ++letter)
+  {
+    *letter = std::tolower(*letter);
+  }
+
+  if (extension == "ascii" || extension == "pcascii")
+  {
+    return imageAscii;
+  }
+
+  if (extension == "obj")
+  {
+    return imageObject;
+  }
+
+  if (extension == "lda")
+  {
+    return imageAbsolute;
+  }
+
+  if (extension == "bin" || extension == "raw" || extension == "img")
+  {
+    return imageRaw;
+  }
+
+  if (*data == '@' || *data == '-' || *data == '*')
+  {
+    return imageAscii;
+  }
+
+  while (data < end && *data == 0)
+  {
+    ++data;
+  }
+
+  if (end - data >= 7 && data[0] == 1 && data[1] == 0)
+  {
+    unsigned int length = Word(data + 2);
+    return (Word(data + 4) == RECORD_GSD && length >= 6 && (length - 6) % 8 == 0) ? imageObject : imageAbsolute;
+  }
+
+  return imageRaw;
+}
+/*}}}*/
+
+// Text images/*{{{*/
+
+bool ImageLoader::LoadAscii(const char *text, const char *end)
+{
+  unsigned int address = 0;
+  unsigned int line = 1;
+
+  for (const char *cursor = text; cursor < end; ++line)
+  {
+    char marker = *cursor;
+    unsigned int value = 0;
+
+    // Blank lines, as left at the end of the file, are passed over
+    if (marker == '\n' || marker == '\r')
+    {
+      cursor += (marker == '\r' && cursor + 1 < end && cursor[1] == '\n') ? 2 : 1;
+      continue;
+    }
+
+    if (marker != '@' && marker != '-' && marker != '*')
+    {
+      return this->Fail(line, std::string("expected '@', '-' or '*' but found '") + marker + "'");
+    }
+
+    ++cursor;
+
+    if (!this->Octal(cursor, end, value))
+    {
+      return this->Fail(line, std::string("expected an octal number after '") + marker + "'");
+    }
+
+    // Trailing blanks are allowed, nothing else
+    while (cursor < end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\r'))
+    {
+      ++cursor;
+    }
+
+    if (cursor < end && *cursor != '\n')
+    {
+      return this->Fail(line, std::string("unexpected '") + *cursor + "' after the number");
+    }
+
+    ++cursor;
+
+    if (value > 0177777)
+    {
+      return this->Fail(line, "value does not fit in 16 bits");
+    }
+
+    switch (marker)
+    {
+      case '@':
+        address = value;
+        break;
+
+      case '-':
+        if (address + 2 > 0200000U)
+        {
+          return this->Fail(line, "word stored past the end of memory");
+        }
+
+        this->Store(address, value);
+        address += 2;
+        break;
+
+      default:
+        // The PC is set through its I/O page address like any other register
+        this->Store(PC, value);
+        this->hasStartPC = true;
+        this->startPC = value;
+    }
+  }
+
+  return true;
+}
+
+// Reads an octal number after any blanks, false if there are no digits
+bool ImageLoader::Octal(const char *&cursor, const char *end, unsigned int &value)
+{
+  while (cursor < end && (*cursor == ' ' || *cursor == '\t'))
+  {
+    ++cursor;
+  }
+
+  const char *start = cursor;
+  value = 0;
+
+  // Stop counting past 16 bits so long runs of digits cannot wrap around
+  while (cursor < end && *cursor >= '0' && *cursor <= '7')
+  {
+    value = value > 0177777 ? value : value * 8 + (*cursor - '0');
+    ++cursor;
+  }
+
+  return cursor != start;
+}
+/*}}}*/
+
+// Object modules/*{{{*/
+
+bool ImageLoader::LoadObject(const unsigned char *data, const unsigned char *end)
+{
+  const unsigned char *cursor = data;
+  bool laidOut = false;
+  unsigned short text = 0;      // Where the last text record went
+
+  while (true)
+  {
+    const unsigned char *record = NULL;
+    const unsigned char *recordEnd = NULL;
+
+    if (!this->NextBlock(cursor, end, record, recordEnd, "the module has no end"))
+    {
+      return false;
+    }
+
+    unsigned int type = Word(record);
+    record += 2;
+
+    switch (type)
+    {
+      case RECORD_GSD:
+        if (laidOut)
+        {
+          return this->FailBlock("symbols after the end of the symbol directory");
+        }
+
+        if (!this->ReadSymbols(record, recordEnd))
+        {
+          return false;
+        }
+
+        break;
+
+      case RECORD_END_GSD:
+        if (!this->LayOut())
+        {
+          return false;
+        }
+
+        laidOut = true;
+        break;
+
+      case RECORD_TEXT:
+        {
+          if (!laidOut || recordEnd - record < 2)
+          {
+            return this->FailBlock("text before the end of the symbol directory");
+          }
+
+          text = this->sections[this->current].base + Word(record);
+
+          if (text + (recordEnd - record - 2) > 0200000U)
+          {
+            return this->FailBlock("text runs past the top of memory");
+          }
+
+          this->Copy(text, record + 2, recordEnd - record - 2);
+
+          break;
+        }
+
+      case RECORD_RLD:
+        if (!laidOut || !this->Relocate(record, recordEnd, text))
+        {
+          return laidOut ? false : this->FailBlock("relocation before the end of the symbol directory");
+        }
+
+        break;
+
+      case RECORD_ISD:
+        break;
+
+      case RECORD_END_MODULE:
+        {
+          // An odd transfer address means .END had none
+          unsigned int section = 0;
+
+          if (this->transferOffset & 1)
+          {
+            return true;
+          }
+
+          if (!this->FindSection(this->transferName, section))
+          {
+            return false;
+          }
+
+          this->startPC = this->sections[section].base + this->transferOffset;
+          this->hasStartPC = true;
+          this->Store(PC, this->startPC);
+          return true;
+        }
+
+      default:
+        return this->FailBlock("record type " + std::to_string(type) + " is not part of an object module");
+    }
+  }
+}
+
+// Takes in the sections, global symbols and transfer address of a GSD record
+bool ImageLoader::ReadSymbols(const unsigned char *entry, const unsigned char *end)
+{
+  for (; end - entry >= 8; entry += 8)
+  {
+    unsigned int name = (Word(entry) << 16) | Word(entry + 2);
+    unsigned char flags = entry[4];
+    unsigned short value = Word(entry + 6);
+
+    switch (entry[5])
+    {
+      case GSD_SECTION:
+        // Old style .CSECT, which is relocatable unless absolute by name
+        flags = name == ABS_NAME ? 0 : FLAG_RELOCATABLE;
+        // Falls through
+
+      case GSD_PSECT:
+        {
+          Section section = { name, flags, value, 0 };
+          this->sections.push_back(section);
+          break;
+        }
+
+      case GSD_SYMBOL:
+        // References are resolved against the definitions, all in this module
+        if (flags & FLAG_DEFINED)
+        {
+          if (this->sections.empty())
+          {
+            return this->FailBlock("global " + Rad50(name) + " is defined outside any section");
+          }
+
+          Symbol symbol = { name, static_cast<unsigned int>(this->sections.size() - 1), value,
+                            (flags & FLAG_RELOCATABLE) != 0 };
+          this->symbols.push_back(symbol);
+        }
+
+        break;
+
+      case GSD_TRANSFER:
+        this->transferName = name;
+        this->transferOffset = value;
+        break;
+
+      default:
+        // Module names, internal symbols and idents say nothing about memory
+        break;
+    }
+  }
+
+  return true;
+}
+
+// Absolute sections are where they say, relocatable ones follow the largest of them
+bool ImageLoader::LayOut()
+{
+  unsigned int next = 0;
+
+  for (std::vector<Section>::iterator section = this->sections.begin(); section != this->sections.end(); ++section)
+  {
+    if (!(section->flags & FLAG_RELOCATABLE) && section->size > next)
+    {
+      next = section->size;
+    }
+  }
+
+  for (std::vector<Section>::iterator section = this->sections.begin(); section != this->sections.end(); ++section)
+  {
+    if (section->flags & FLAG_RELOCATABLE)
+    {
+      next = (next + 1) & ~1U;
+      section->base = next;
+      next += section->size;
+    }
+  }
+
+  if (next > 0200000U)
+  {
+    return this->FailBlock("the sections do not fit in 64K bytes");
+  }
+
+  return true;
+}
+
+/*
+ * Applies the entries of an RLD record to the text record before it, or
+ * moves the text to another section.  Each entry is a type, an offset into
+ * the text record counting its 4 header bytes, and the symbols or
+ * constants it needs.
+ */
+bool ImageLoader::Relocate(const unsigned char *entry, const unsigned char *end, unsigned short text)
+{
+  // Bytes each type carries after its type and offset
+  static const unsigned char lengths[] = { 0, 2, 4, 2, 4, 6, 6, 6, 2, 0, 4, 0, 4, 6, 6, 0 };
+
+  while (entry < end)
+  {
+    unsigned int type = entry[0] & RLD_TYPE;
+
+    if (end - entry < 2 || type == 0 || type >= sizeof(lengths) || end - entry - 2 < lengths[type])
+    {
+      return this->FailBlock("malformed relocation entry");
+    }
+
+    bool byte = entry[0] & RLD_BYTE;
+    unsigned short at = text + entry[1] - 4;
+    const unsigned char *operand = entry + 2;
+    unsigned int name = (Word(operand) << 16) | Word(operand + 2);
+    unsigned int section = 0;
+    unsigned short value = 0;
+    entry = operand + lengths[type];
+
+    switch (type)
+    {
+      case 1:   // Internal
+        value = this->sections[this->current].base + Word(operand);
+        break;
+
+      case 3:   // Internal displaced, to an absolute address
+        value = Word(operand) - (at + 2);
+        break;
+
+      case 2: case 4: case 5: case 6:   // Global, displaced, additive, additive displaced
+        if (!this->FindSymbol(name, value))
+        {
+          return false;
+        }
+
+        value += (type == 5 || type == 6) ? Word(operand + 4) : 0;
+        value -= (type == 4 || type == 6) ? at + 2 : 0;
+        break;
+
+      case 7:   // Location counter definition, text now goes to that section
+        if (!this->FindSection(name, this->current))
+        {
+          return false;
+        }
+
+        continue;
+
+      case 8:   // Location counter modification, the text records carry their own addresses
+        continue;
+
+      case 9:   // .LIMIT, the lowest and highest addresses of the program
+        {
+          unsigned int high = 0;
+
+          for (std::vector<Section>::iterator each = this->sections.begin(); each != this->sections.end(); ++each)
+          {
+            high = std::max(high, static_cast<unsigned int>(each->base + each->size));
+          }
+
+          this->Store(at, 0);
+          this->Store(at + 2, high);
+          continue;
+        }
+
+      case 10: case 12: case 13: case 14:       // Section, displaced, additive, additive displaced
+        if (!this->FindSection(name, section))
+        {
+          return false;
+        }
+
+        value = this->sections[section].base;
+        value += (type == 13 || type == 14) ? Word(operand + 4) : 0;
+        value -= (type == 12 || type == 14) ? at + 2 : 0;
+        break;
+
+      case 15:  // Complex, runs to its own store command
+        if (!this->Complex(entry, end, at, value))
+        {
+          return false;
+        }
+
+        break;
+
+      default:
+        return this->FailBlock("unknown relocation type " + std::to_string(type));
+    }
+
+    if (byte)
+    {
+      this->bytes[at ^ BYTE_SWIZZLE] = value & 0xFF;
+    }
+
+    else
+    {
+      this->Store(at, value);
+    }
+  }
+
+  return true;
+}
+
+// Works a complex relocation string on a small stack, leaving entry past it
+bool ImageLoader::Complex(const unsigned char *&entry, const unsigned char *end, unsigned short at, unsigned short &value)
+{
+  unsigned short stack[16];
+  unsigned int depth = 0;
+
+  while (entry < end)
+  {
+    unsigned char command = *entry++;
+    unsigned int need = command == 016 ? 4 : command == 017 ? 3 : command == 020 ? 2 : 0;
+    unsigned int pops = (command >= 001 && command <= 007) ? 2 : (command >= 010 && command <= 013) ? 1 : 0;
+
+    if (static_cast<unsigned int>(end - entry) < need || depth < pops || (need > 0 && depth == 16))
+    {
+      return this->FailBlock("malformed complex relocation");
+    }
+
+    unsigned short right = depth > 0 ? stack[depth - 1] : 0;
+    unsigned short left = depth > 1 ? stack[depth - 2] : 0;
+    depth -= pops;
+    unsigned int section = 0;
+
+    switch (command)
+    {
+      case 000: break;
+      case 001: stack[depth++] = left + right; break;
+      case 002: stack[depth++] = left - right; break;
+      case 003: stack[depth++] = left * right; break;
+      case 004: stack[depth++] = right ? left / right : 0; break;
+      case 005: stack[depth++] = left & right; break;
+      case 006: stack[depth++] = left | right; break;
+      case 007: stack[depth++] = left ^ right; break;
+      case 010: stack[depth++] = -right; break;
+      case 011: stack[depth++] = ~right; break;
+
+      case 012:
+        value = right;
+        return true;
+
+      case 013:
+        value = right - (at + 2);
+        return true;
+
+      case 016:
+        if (!this->FindSymbol((Word(entry) << 16) | Word(entry + 2), stack[depth]))
+        {
+          return false;
+        }
+
+        ++depth;
+        break;
+
+      case 017:
+        section = entry[0];
+
+        if (section >= this->sections.size())
+        {
+          return this->FailBlock("complex relocation names section " + std::to_string(section) + ", which is not declared");
+        }
+
+        stack[depth++] = this->sections[section].base + Word(entry + 1);
+        break;
+
+      case 020:
+        stack[depth++] = Word(entry);
+        break;
+
+      default:
+        return this->FailBlock("unknown complex relocation command " + std::to_string(command));
+    }
+
+    entry += need;
+  }
+
+  return this->FailBlock("complex relocation with no store");
+}
+
+bool ImageLoader::FindSection(unsigned int name, unsigned int &section)
+{
+  for (section = 0; section < this->sections.size(); ++section)
+  {
+    if (this->sections[section].name == name)
+    {
+      return true;
+    }
+  }
+
+  return this->FailBlock("section " + Rad50(name) + " is not declared");
+}
+
+bool ImageLoader::FindSymbol(unsigned int name, unsigned short &value)
+{
+  for (std::vector<Symbol>::iterator symbol = this->symbols.begin(); symbol != this->symbols.end(); ++symbol)
+  {
+    if (symbol->name == name)
+    {
+      value = symbol->value + (symbol->relocatable ? this->sections[symbol->section].base : 0);
+      return true;
+    }
+  }
+
+  // As the RT-11 linker does, undefined globals are 0 and only warned about
+  std::string undefined = Rad50(name);
+
+  if (this->warning.empty())
+  {
+    this->warning = "undefined globals taken as 0: " + undefined;
+  }
+
+  else if ((this->warning + ",").find(" " + undefined + ",") == std::string::npos)
+  {
+    this->warning += ", " + undefined;
+  }
+
+  value = 0;
+  return true;
+}
+/*}}}*/
+
+// Formatted binary/*{{{*/
+
+/*
+ * Steps cursor over the next block, setting body to the bytes between its
+ * length word and its checksum.  Paper tape leader and the zeroes padding
+ * blocks apart are skipped.
+ */
+bool ImageLoader::NextBlock(const unsigned char *&cursor, const unsigned char *end, const unsigned char *&body,
+                            const unsigned char *&bodyEnd, const std::string &missingEnd)
+{
+  while (cursor < end && *cursor == 0)
+  {
+    ++cursor;
+  }
+
+  if (cursor == end)
+  {
+    this->error = this->path + ": " + missingEnd;
+    return false;
+  }
+
+  ++this->block;
+
+  if (end - cursor < 7 || cursor[0] != 1 || cursor[1] != 0)
+  {
+    return this->FailBlock("not a formatted binary block");
+  }
+
+  unsigned int length = Word(cursor + 2);
+
+  if (length < 6 || length >= static_cast<unsigned int>(end - cursor))
+  {
+    return this->FailBlock("length runs past the end of the file");
+  }
+
+  // All the bytes of a block, its checksum included, add up to zero
+  unsigned char checksum = 0;
+
+  for (unsigned int i = 0; i <= length; ++i)
+  {
+    checksum += cursor[i];
+  }
+
+  if (checksum != 0)
+  {
+    return this->FailBlock("bad checksum");
+  }
+
+  body = cursor + 4;
+  bodyEnd = cursor + length;
+  cursor += length + 1;
+  return true;
+}
+
+/*
+ * The absolute loader's tape: each block holds a load address and the
+ * bytes to put there, and the first block with no bytes ends the tape.
+ * Its address is where to start, an odd one meaning nowhere.
+ */
+bool ImageLoader::LoadAbsolute(const unsigned char *data, const unsigned char *end)
+{
+  const unsigned char *cursor = data;
+
+  while (true)
+  {
+    const unsigned char *block = NULL;
+    const unsigned char *blockEnd = NULL;
+
+    if (!this->NextBlock(cursor, end, block, blockEnd, "the tape has no end block"))
+    {
+      return false;
+    }
+
+    unsigned int address = Word(block);
+    unsigned int length = blockEnd - block - 2;
+
+    if (length == 0)
+    {
+      if (!(address & 1))
+      {
+        this->startPC = address;
+        this->hasStartPC = true;
+        this->Store(PC, address);
+      }
+
+      return true;
+    }
+
+    if (address + length > 0200000U)
+    {
+      return this->FailBlock("data runs past the top of memory");
+    }
+
+    this->Copy(address, block + 2, length);
+  }
+}
+/*}}}*/
+
+/*
+ * A raw image is a copy of memory from address 0.  One long enough to
+ * reach the top of the I/O page sets the registers and PC through their
+ * addresses there, as the text images do.
+ */
+bool ImageLoader::LoadRaw(const unsigned char *data, const unsigned char *end)/*{{{*/
+{
+  if (static_cast<unsigned int>(end - data) > this->size)
+  {
+    this->error = this->path + " is larger than memory";
+    return false;
+  }
+
+  this->Copy(0, data, end - data);
+
+  if (static_cast<unsigned int>(end - data) >= PC + 2)
+  {
+    this->startPC = Word(data + PC);
+    this->hasStartPC = true;
+  }
+
+  return true;
+}
+/*}}}*/
+
+// Puts bytes in memory in one copy when the host keeps words in PDP-11 order
+void ImageLoader::Copy(unsigned int address, const unsigned char *data, unsigned int length)/*{{{*/
+{
+  if (BYTE_SWIZZLE == 0)
+  {
+    std::memcpy(this->bytes + address, data, length);
+    return;
+  }
+
+  for (unsigned int i = 0; i < length; ++i)
+  {
+    this->bytes[(address + i) ^ BYTE_SWIZZLE] = data[i];
+  }
+}
+/*}}}*/
+
+void ImageLoader::Store(unsigned int address, unsigned short word)/*{{{*/
+{
+  this->bytes[address ^ BYTE_SWIZZLE] = word & 0xFF;
+  this->bytes[(address + 1) ^ BYTE_SWIZZLE] = word >> 8;
+}
+/*}}}*/
+
+bool ImageLoader::Fail(unsigned int line, const std::string &message)/*{{{*/
+{
+  this->error = this->path + ":" + std::to_string(line) + ": " + message;
+  return false;
+}
+
+bool ImageLoader::FailBlock(const std::string &message)
+{
+  this->error = this->path + ": block " + std::to_string(this->block) + ": " + message;
+  return false;
+}
+/*}}}*/
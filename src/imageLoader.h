@@ -0,0 +1,95 @@
+#ifndef IMAGELOADER_H
+#define IMAGELOADER_H
+
+#include <string>
+#include <vector>
+
+enum ImageFormat
+{
+  imageAscii,
+  imageObject,
+  imageAbsolute,
+  imageRaw
+};
+
+/*
+ * Loads a program image from a file straight into the bytes of a Memory's
+ * RAM, mapping the file rather than reading it line by line.  The .ascii
+ * and .PCascii text images hold one entry per line:
+ *   @001000  move the load address to 001000
+ *   -012700  store the word 012700 there and step the address past it
+ *   *001000  start the program at 001000
+ * all numbers octal.  Anything else is an error naming the file and line.
+ *
+ * A .obj file is a MACRO-11 object module in RT-11 formatted binary, which
+ * is linked as it loads: any absolute section goes where it says, the
+ * relocatable sections follow it in the order they were declared, and the
+ * relocation records are applied against that layout.  The transfer
+ * address from .END becomes the start PC.
+ *
+ * Absolute loader tapes (.lda) and raw memory images are copied into RAM
+ * as they are, without conversion.
+ */
+class ImageLoader
+{
+  public:
+    ImageLoader(unsigned char *bytes, unsigned int size);
+    bool Load(const std::string &path);
+    static ImageFormat Detect(const std::string &path, const unsigned char *data, const unsigned char *end);
+    bool HasStartPC() const { return hasStartPC; };
+    unsigned short StartPC() const { return startPC; };
+    const std::string &Error() const { return error; };
+    const std::string &Warning() const { return warning; };
+
+  private:
+    // A program section, or a global symbol defined in one
+    struct Section
+    {
+      unsigned int name;        // Two RAD50 words
+      unsigned char flags;
+      unsigned short size;
+      unsigned short base;
+    };
+
+    struct Symbol
+    {
+      unsigned int name;
+      unsigned int section;
+      unsigned short value;
+      bool relocatable;
+    };
+
+    bool LoadAscii(const char *text, const char *end);
+    bool Octal(const char *&cursor, const char *end, unsigned int &value);
+    bool NextBlock(const unsigned char *&cursor, const unsigned char *end, const unsigned char *&body,
+                   const unsigned char *&bodyEnd, const std::string &missingEnd);
+    bool LoadAbsolute(const unsigned char *data, const unsigned char *end);
+    bool LoadRaw(const unsigned char *data, const unsigned char *end);
+    bool LoadObject(const unsigned char *data, const unsigned char *end);
+    bool ReadSymbols(const unsigned char *entry, const unsigned char *end);
+    bool LayOut();
+    bool Relocate(const unsigned char *entry, const unsigned char *end, unsigned short text);
+    bool Complex(const unsigned char *&entry, const unsigned char *end, unsigned short at, unsigned short &value);
+    bool FindSection(unsigned int name, unsigned int &section);
+    bool FindSymbol(unsigned int name, unsigned short &value);
+    void Copy(unsigned int address, const unsigned char *data, unsigned int length);
+    void Store(unsigned int address, unsigned short word);
+    bool Fail(unsigned int line, const std::string &message);
+    bool FailBlock(const std::string &message);
+    unsigned char *bytes;       // Little-endian words, swizzled as in Memory
+    unsigned int size;
+    std::string path;
+    std::string error;
+    std::string warning;
+    bool hasStartPC;
+    unsigned short startPC;
+
+    // Formatted binary and object modules
+    std::vector<Section> sections;      // In declaration order, as numbered by complex relocation
+    std::vector<Symbol> symbols;
+    unsigned int block;                 // Formatted binary block, counted from 1 for errors
+    unsigned int current;               // Section the text is going into
+    unsigned int transferName;          // Section of the .END address
+    unsigned short transferOffset;      // Odd when .END gave none
+};
+#endif // IMAGELOADER_H
@@ -1,16 +1,66 @@
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "imageLoader.h"
 #include "memory.h"
 #include <iomanip>
 
-// Initialize memory using the assembly source/*{{{*/
-Memory::Memory(std::vector<std::string> *source)
+// KT11 page registers, eight words each
+#define KERNEL_PDR 0172300U
+#define KERNEL_PAR 0172340U
+#define USER_PDR 0177600U
+#define USER_PAR 0177640U
+
+// Page descriptor fields
+#define PDR_LENGTH 077400       // Last block in the page, or first if it grows down
+#define PDR_WRITTEN 0100
+#define PDR_DOWN 010
+#define PDR_ACCESS 06           // Non-resident, read only, non-resident, read/write
+
+// SR0 abort flags, kept until software clears them
+#define ABORT_NON_RESIDENT 0100000
+#define ABORT_LENGTH 040000
+#define ABORT_READ_ONLY 020000
+#define ABORT_FLAGS 0160000
+
+// Empty memory, LoadImage() puts a program in it/*{{{*/
+Memory::Memory() : registerFile(this), mmu(this), initialMMU(this)
 {
   // Initialize RAM to 0's
-  this->RAM = new unsigned char[65536] {0};
-  this->initialRAM = new unsigned char[65536] {0};
-  this->byteMode = 02;          // Default to word addressing
-  unsigned int addressIndex = 0;
+  this->RAM = new unsigned short[RAM_WORDS] {0};
+  this->initialRAM = new unsigned short[RAM_WORDS] {0};
+  this->codeMap = new unsigned char[4096] {0};
+  this->dirtyMap = new unsigned char[RAM_PAGES] {0};
+  this->codeObserver = NULL;
+  this->conditionCodes = NULL;
+  this->debugLevel = Verbosity::off;
+  this->devices = new Device *[BUS_PAGES]();
+  this->directLimit = IO_PAGE;
+  this->mode = 0;
+  this->stackPointers[0] = 0;
+  this->stackPointers[1] = 0;
+  this->tlb = new unsigned short *[4 * TLB_ENTRIES]();
+  this->readMap = this->tlb;
+  this->writeMap = this->tlb + TLB_ENTRIES;
+  this->watchMap = new unsigned char[WATCH_PAGES / 8] {0};
+  this->watchTriggered = false;
+  this->traceEnabled = true;
+  this->traceWriter = new TraceWriter("trace");
+  this->traceBuffer = this->traceWriter->Segment();
+  this->traceUsed = 0;
+  this->traceStarted = false;
+  this->traceClosed = false;
+  this->traceIndexed = false;
+  this->traceInstructions = 0;
+  this->registers = NULL;
+  this->initialPC = 0;
+  this->initialStackPointers[0] = 0;
+  this->initialStackPointers[1] = 0;
+  this->initialInstructions = 0;
+  this->initialCycles = 0;
 
   regArray[0] = R0;
   regArray[1] = R1;
@@ -21,147 +71,844 @@ Memory::Memory(std::vector<std::string> *source)
   regArray[6] = SP;
   regArray[7] = PC;
 
-  try
+  // The registers and the memory management unit answer in the I/O page
+  this->AttachDevice(&this->registerFile, REGISTER_PAGE, PC + 4 - REGISTER_PAGE);
+  this->AttachDevice(&this->registerFile, PS, 2);
+  this->AttachDevice(&this->mmu, KERNEL_PDR, 020);
+  this->AttachDevice(&this->mmu, KERNEL_PAR, 020);
+  this->AttachDevice(&this->mmu, USER_PDR, 020);
+  this->AttachDevice(&this->mmu, USER_PAR, 020);
+  this->AttachDevice(&this->mmu, SR0, SR2 + 2 - SR0);
+}
+/*}}}*/
+
+/*
+ * Loads the program image at path, false after printing why if it cannot
+ * be read or is malformed.  The state it leaves is what the GUI's reset
+ * goes back to.
+ */
+bool Memory::LoadImage(const std::string &path)/*{{{*/
+{
+  char magic[sizeof(SNAPSHOT_MAGIC)] = { 0 };
+  std::ifstream(path.c_str(), std::ios::in | std::ios::binary).read(magic, sizeof(magic) - 1);
+
+  // A snapshot brings back the whole machine, not just memory
+  if (std::strcmp(magic, SNAPSHOT_MAGIC) == 0)
   {
-    traceFile = new std::ofstream("trace.txt", std::ios::out);
+    if (!this->LoadSnapshot(path))
+    {
+      return false;
+    }
+
+    std::memcpy(this->RAM, this->initialRAM, RAM_WORDS * sizeof(unsigned short));
+    std::memset(this->dirtyMap, 0, RAM_PAGES);
+    this->mmu = this->initialMMU;
+    this->stackPointers[0] = this->initialStackPointers[0];
+    this->stackPointers[1] = this->initialStackPointers[1];
+    return true;
   }
 
-  catch (const std::ios_base::failure &e)
+  ImageLoader loader(this->Bytes(), RAM_WORDS * sizeof(unsigned short));
+
+  if (!loader.Load(path))
   {
-    std::cout << "Error opening trace file for output mode!" << std::endl;
+    std::cout << "Error loading program image: " << loader.Error() << std::endl;
+    return false;
   }
 
-  // Make sure each line starts with a - or @ and only has numbers following/*{{{*/
-  for (std::vector<std::string>::iterator it = source->begin(); it != source->end(); ++it)
+  if (!loader.Warning().empty())
   {
-    switch(it->c_str()[0])
-    {
-      case '@': // This is the line we set our address pointer to
-        {
-          // Shift addressPointer left 3 bits, then add the next octal value
-          addressIndex = 0;
-          std::string temp;
-          
-          // Grab the value past the first '@' char
-          temp = it->substr(1, it->length() - 1);
-          std::stringstream stream(temp);
-          stream >> std::oct >> addressIndex;
-
-          break;
-        }
+    std::cout << "Warning: " << loader.Warning() << std::endl;
+  }
 
-      case '-': // This means we load this value in to the memory location pointed to by addressPointer
-        {
-          // Use address pointer to write to mem, then increment address pointer.
-          // If the value loaded in is 16 bits then incremenent address pointer by 2.
-          unsigned int value = 0;
-          std::string temp;
-          
-          // Grab the value past the first '-' char
-          temp = it->substr(1, it->length() - 1);
-          std::stringstream stream(temp);
-          stream >> std::oct >> value;
-
-          // Update internal memory directly to avoid trace output
-          this->RAM[addressIndex++] = value & 0xFF;
-          this->RAM[addressIndex++] = value >> 8;
-          break;
-        }
+  if (loader.HasStartPC())
+  {
+    this->initialPC = loader.StartPC();
+  }
 
-      case '*': // This is the value we set the PC to
-        {
-          unsigned int value = 0;
-          std::string temp;
-          
-          // Grab the value past the first '*' char
-          temp = it->substr(1, it->length() - 1);
-          std::stringstream stream(temp);
-          stream >> std::oct >> value;
-
-          // Update internal memory directly to avoid trace output
-          this->RAM[PC] = value & 0xFF;
-          this->RAM[PC + 1] = value >> 8;
-          this->initialPC = value;
-          break;
-        }
+  // The source sets up registers through their I/O page addresses
+  for (int i = 0; i < 8; ++i)
+  {
+    this->initialRegisters[i] = this->RAM[regArray[i] >> 1];
+  }
+  this->initialRegisters[8] = this->RAM[PS >> 1];
 
-      default:
-        {
-          std::cout << "Unrecognized instruction at line " << it - source->begin() << std::endl;
-        }
-    }
-  }/*}}}*/
+  // Those words only passed through RAM, which is ordinary memory when mapped
+  std::memset(this->RAM + (IO_PAGE >> 1), 0, 0200000 - IO_PAGE);
 
   // Make a copy of the initial memory state to support GUI restart of program execution
-  for (int i = 0; i < 65536; ++i)
+  std::memcpy(this->initialRAM, this->RAM, RAM_WORDS * sizeof(unsigned short));
+  return true;
+}
+/*}}}*/
+
+/*
+ * Writes the machine as it stands to path, see snapshot.h, false after
+ * printing why if the file cannot be written.  The CPU passes in its
+ * counts.
+ */
+bool Memory::SaveSnapshot(const std::string &path, unsigned long long instructions, unsigned long long cycles)/*{{{*/
+{
+  // Pending condition codes belong in the saved PS
+  this->SyncPS();
+
+  std::vector<char> page(SNAPSHOT_PAGE, 0);
+  SnapshotHeader *header = reinterpret_cast<SnapshotHeader *>(&page[0]);
+  std::memcpy(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic));
+  header->version = SNAPSHOT_VERSION;
+  header->flags = BYTE_SWIZZLE ? SNAPSHOT_BIG_ENDIAN : 0;
+  header->ramOffset = SNAPSHOT_PAGE;
+  header->ramBytes = RAM_WORDS * sizeof(unsigned short);
+  header->instructions = instructions;
+  header->cycles = cycles;
+  std::memcpy(header->registers, this->registers, sizeof(header->registers));
+  header->stackPointers[0] = this->stackPointers[0];
+  header->stackPointers[1] = this->stackPointers[1];
+  this->mmu.Save(*header);
+
+  std::ofstream out(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  out.write(&page[0], SNAPSHOT_PAGE);
+  out.write(reinterpret_cast<const char *>(this->RAM), header->ramBytes);
+  out.close();
+
+  if (!out)
+  {
+    std::cout << "Error saving snapshot: cannot write " << path << std::endl;
+    return false;
+  }
+
+  return true;
+}
+/*}}}*/
+
+/*
+ * Maps the snapshot at path and makes it the state reset goes back to,
+ * false after printing why if it cannot be used.  Every page of RAM is
+ * marked for the next ResetRAM() to restore.
+ */
+bool Memory::LoadSnapshot(const std::string &path)/*{{{*/
+{
+  // Opened through stdio, unistd.h's read() and write() clash with Transaction
+  FILE *file = std::fopen(path.c_str(), "rb");
+  struct stat status;
+
+  if (file == NULL || fstat(fileno(file), &status) != 0)
+  {
+    std::cout << "Error loading snapshot: cannot open " << path << std::endl;
+
+    if (file)
+    {
+      std::fclose(file);
+    }
+
+    return false;
+  }
+
+  unsigned int ramBytes = RAM_WORDS * sizeof(unsigned short);
+  void *mapped = MAP_FAILED;
+
+  if (status.st_size == SNAPSHOT_PAGE + ramBytes)
   {
-    this->initialRAM[i] = this->RAM[i];
+    mapped = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
   }
+
+  std::fclose(file);
+
+  if (mapped == MAP_FAILED)
+  {
+    std::cout << "Error loading snapshot: " << path << " is not a complete snapshot" << std::endl;
+    return false;
+  }
+
+  const SnapshotHeader *header = static_cast<const SnapshotHeader *>(mapped);
+  bool usable = std::memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) == 0 &&
+                header->version == SNAPSHOT_VERSION &&
+                header->flags == (BYTE_SWIZZLE ? SNAPSHOT_BIG_ENDIAN : 0) &&
+                header->ramOffset == SNAPSHOT_PAGE && header->ramBytes == ramBytes;
+
+  if (usable)
+  {
+    std::memcpy(this->initialRAM, static_cast<const char *>(mapped) + header->ramOffset, ramBytes);
+    std::memcpy(this->initialRegisters, header->registers, sizeof(this->initialRegisters));
+    this->initialPC = header->registers[7];
+    this->initialStackPointers[0] = header->stackPointers[0];
+    this->initialStackPointers[1] = header->stackPointers[1];
+    this->initialMMU.Restore(*header);
+    this->initialInstructions = header->instructions;
+    this->initialCycles = header->cycles;
+    std::memset(this->dirtyMap, 1, RAM_PAGES);
+  }
+
+  else
+  {
+    std::cout << "Error loading snapshot: " << path << " is from another version of the simulator or another kind of host" << std::endl;
+  }
+
+  munmap(mapped, status.st_size);
+  return usable;
 }
 /*}}}*/
 
 Memory::~Memory()/*{{{*/
 {
-  this->traceFile->close();
+  this->CloseTrace();
   delete [] RAM;
   delete [] initialRAM;
-  delete traceFile;
+  delete [] codeMap;
+  delete [] dirtyMap;
+  delete [] devices;
+  delete [] tlb;
+  delete [] watchMap;
+  delete traceWriter;
 }
 /*}}}*/
 
+// Drop any decoded copy of the word at address before it is overwritten
+inline void Memory::CheckCode(unsigned short address)
+{
+  unsigned char bit = 1 << ((address >> 1) & 07);
+
+  if (this->codeMap[address >> 4] & bit)
+  {
+    this->codeMap[address >> 4] &= ~bit;
+
+    if (this->codeObserver)
+    {
+      this->codeObserver->InvalidateCode(address & ~01);
+    }
+  }
+}
+
+/*
+ * Hands memory the CPU's register file, loaded with the register values
+ * from the source.  From here on every access to the register addresses
+ * at the top of the I/O page is routed to it.
+ */
+void Memory::AttachRegisters(unsigned short *registers)/*{{{*/
+{
+  this->registers = registers;
+
+  for (int i = 0; i < 9; ++i)
+  {
+    this->registers[i] = this->initialRegisters[i];
+  }
+
+  this->mode = this->registers[8] >> 15;
+  this->UpdateMapping();
+}
+/*}}}*/
+
+// Console access to any address, which never traps: nothing answering reads as 0
 void Memory::WriteAddress(unsigned short address, unsigned short data)
 {
-  this->RAM[address] = data & 0xFF;
-  this->RAM[address + 1] = (data >> 8);
+  try
+  {
+    this->WriteWord(address, data);
+  }
+
+  catch (const MemoryAbort &error)
+  {
+  }
+
   return;
 }
 
 unsigned short Memory::ReadAddress(unsigned short address)
 {
-  return (this->RAM[address + 1] << 8) | (this->RAM[address] & 0xFF);
+  try
+  {
+    return this->LoadWord(address);
+  }
+
+  catch (const MemoryAbort &error)
+  {
+    return 0;
+  }
+}
+
+// Word store for the processor, a bus error throws
+void Memory::WriteWord(unsigned short address, unsigned short data)
+{
+  this->CheckWatch(address, wordWidth, watchWrite, data);
+  this->CheckCode(address);
+  this->StoreWord(address, data);
+}
+
+// Unibus/*{{{*/
+
+/*
+ * Every page of the I/O page points at the device answering for it, so a
+ * bus cycle is one table lookup and a virtual call.  RAM never gets here.
+ * Devices may share a page as long as they keep to their own registers.
+ */
+void Memory::AttachDevice(Device *device, unsigned short base, unsigned short size)
+{
+  unsigned int end = static_cast<unsigned int>(base) + size;
+
+  for (unsigned int address = base & ~((1U << BUS_PAGE_SHIFT) - 1); address < end; address += 1U << BUS_PAGE_SHIFT)
+  {
+    if (address >= IO_PAGE)
+    {
+      this->devices[(address - IO_PAGE) >> BUS_PAGE_SHIFT] = device;
+    }
+  }
+}
+
+unsigned short Memory::BusRead(unsigned short address)
+{
+  Device *device = this->devices[(address - IO_PAGE) >> BUS_PAGE_SHIFT];
+  unsigned short data;
+
+  if (!device || !device->Read(address, data))
+  {
+    MemoryAbort error = { address, BUS_ERROR_VECTOR };
+    throw error;
+  }
+
+  return data;
+}
+
+void Memory::BusWrite(unsigned short address, unsigned short data, Width width)
+{
+  Device *device = this->devices[(address - IO_PAGE) >> BUS_PAGE_SHIFT];
+
+  if (!device || !device->Write(address, data, width))
+  {
+    MemoryAbort error = { address, BUS_ERROR_VECTOR };
+    throw error;
+  }
+}
+
+// A word access to an odd address is refused the same way
+void Memory::OddAddress(unsigned short address)
+{
+  MemoryAbort error = { address, BUS_ERROR_VECTOR };
+  throw error;
+}
+
+// Register backing the word at address, NULL if it is not one of them
+unsigned short *RegisterFile::RegisterAt(unsigned short address)
+{
+  if (address >= PS)
+  {
+    this->memory->SyncPS();
+    return &this->memory->registers[8];
+  }
+
+  if (address >= REGISTER_PAGE && address < PC + 4 && ((address - REGISTER_PAGE) & 02) == 0)
+  {
+    return &this->memory->registers[(address - REGISTER_PAGE) >> 2];
+  }
+
+  return NULL;
+}
+
+bool RegisterFile::Read(unsigned short address, unsigned short &data)
+{
+  unsigned short *reg = this->RegisterAt(address);
+
+  if (!reg)
+  {
+    return false;
+  }
+
+  data = *reg;
+  return true;
+}
+
+bool RegisterFile::Write(unsigned short address, unsigned short data, Width width)
+{
+  unsigned short *reg = this->RegisterAt(address);
+
+  if (!reg)
+  {
+    return false;
+  }
+
+  if (width == byteWidth)
+  {
+    *reg = (address & 01) ? (*reg & 0x00FF) | (data << 8) : (*reg & 0xFF00) | (data & 0xFF);
+  }
+
+  else
+  {
+    *reg = data;
+  }
+
+  if (reg == &this->memory->registers[8])
+  {
+    this->memory->UpdateMapping();
+  }
+
+  return true;
+}
+/*}}}*/
+
+// Memory management/*{{{*/
+
+// Physical address behind a virtual one, the I/O page stays on top when unmapped
+unsigned int Memory::Relocate(unsigned short address, Transaction type)
+{
+  if (!this->Mapped())
+  {
+    return address < IO_PAGE ? address : address - IO_PAGE + PHYSICAL_IO_PAGE;
+  }
+
+  return this->mmu.Relocate(address, this->mode, type);
+}
+
+// Word read that missed the translation cache, caching its block if it is RAM
+unsigned short Memory::LoadMapped(unsigned short address)
+{
+  unsigned int physical = this->Relocate(address, Transaction::read);
+
+  if (physical >= PHYSICAL_IO_PAGE)
+  {
+    return this->BusRead(physical - PHYSICAL_IO_PAGE + IO_PAGE);
+  }
+
+  unsigned short *block = this->RAM + ((physical >> 1) & ~(TLB_WORDS - 1));
+  this->readMap[address >> TLB_SHIFT] = block;
+  return block[(address >> 1) & (TLB_WORDS - 1)];
+}
+
+/*
+ * Byte or word write that missed the translation cache.  The block is
+ * marked dirty when it is cached, so cached writes need no bookkeeping.
+ */
+void Memory::StoreMapped(unsigned short address, unsigned short data, Width width)
+{
+  unsigned int physical = this->Relocate(address, Transaction::write);
+
+  if (physical >= PHYSICAL_IO_PAGE)
+  {
+    this->BusWrite(physical - PHYSICAL_IO_PAGE + IO_PAGE, data, width);
+    return;
+  }
+
+  unsigned short *block = this->RAM + ((physical >> 1) & ~(TLB_WORDS - 1));
+  this->writeMap[address >> TLB_SHIFT] = block;
+  this->dirtyMap[physical >> DIRTY_PAGE_SHIFT] = 1;
+
+  if (width == byteWidth)
+  {
+    reinterpret_cast<unsigned char *>(block)[(address & ((1U << TLB_SHIFT) - 1)) ^ BYTE_SWIZZLE] = data;
+  }
+
+  else
+  {
+    block[(address >> 1) & (TLB_WORDS - 1)] = data;
+  }
+}
+
+/*
+ * Brings the access paths in line with SR0 and the mode in PS.  A change
+ * of mode swaps in that mode's stack pointer.  Turning relocation on or
+ * off empties the translation cache, and turning it on also drops all
+ * decoded and translated code, which is kept by virtual address only
+ * while unmapped.
+ */
+void Memory::UpdateMapping()
+{
+  int mode = this->registers[8] >> 15;
+
+  if (mode != this->mode)
+  {
+    this->stackPointers[this->mode] = this->registers[6];
+    this->registers[6] = this->stackPointers[mode];
+    this->mode = mode;
+  }
+
+  unsigned short limit = this->mmu.Enabled() ? 0 : IO_PAGE;
+
+  if (limit != this->directLimit)
+  {
+    this->FlushMapping();
+    this->directLimit = limit;
+
+    if (this->Mapped())
+    {
+      this->ForgetCode();
+    }
+  }
+
+  this->readMap = this->tlb + 2 * mode * TLB_ENTRIES;
+  this->writeMap = this->readMap + TLB_ENTRIES;
+}
+
+// Drops every decoded and translated instruction
+void Memory::ForgetCode()
+{
+  std::memset(this->codeMap, 0, 4096);
+
+  if (this->codeObserver)
+  {
+    this->codeObserver->InvalidateAllCode();
+  }
+}
+
+void Memory::FlushMapping()
+{
+  std::memset(this->tlb, 0, 4 * TLB_ENTRIES * sizeof(unsigned short *));
+}
+
+KT11::KT11(Memory *memory)
+{
+  this->memory = memory;
+  this->Reset();
+}
+
+void KT11::Reset()
+{
+  std::memset(this->par, 0, sizeof(this->par));
+  std::memset(this->pdr, 0, sizeof(this->pdr));
+  this->sr0 = 0;
+  this->sr2 = 0;
+}
+
+void KT11::Save(SnapshotHeader &header) const
+{
+  std::memcpy(header.par, this->par, sizeof(header.par));
+  std::memcpy(header.pdr, this->pdr, sizeof(header.pdr));
+  header.sr0 = this->sr0;
+  header.sr2 = this->sr2;
+}
+
+void KT11::Restore(const SnapshotHeader &header)
+{
+  std::memcpy(this->par, header.par, sizeof(this->par));
+  std::memcpy(this->pdr, header.pdr, sizeof(this->pdr));
+  this->sr0 = header.sr0;
+  this->sr2 = header.sr2;
+}
+
+// Checks an access against its page descriptor, then relocates or aborts it
+unsigned int KT11::Relocate(unsigned short address, int mode, Transaction type)
+{
+  int page = address >> 13;
+  unsigned short descriptor = this->pdr[mode][page];
+  unsigned int block = (address >> 6) & 0177;
+  unsigned int length = (descriptor & PDR_LENGTH) >> 8;
+  unsigned short reason = 0;
+
+  if ((descriptor & PDR_ACCESS) == 0 || (descriptor & PDR_ACCESS) == 04)
+  {
+    reason |= ABORT_NON_RESIDENT;
+  }
+
+  if ((descriptor & PDR_DOWN) ? block < length : block > length)
+  {
+    reason |= ABORT_LENGTH;
+  }
+
+  if ((descriptor & PDR_ACCESS) == 02 && type == Transaction::write)
+  {
+    reason |= ABORT_READ_ONLY;
+  }
+
+  if (reason)
+  {
+    this->Abort(address, mode, reason);
+  }
+
+  if (type == Transaction::write)
+  {
+    this->pdr[mode][page] |= PDR_WRITTEN;
+  }
+
+  return ((this->par[mode][page] & 07777) << 6) + (address & 017777);
+}
+
+// SR0 holds on to the first abort until software clears its flags
+void KT11::Abort(unsigned short address, int mode, unsigned short reason)
+{
+  if ((this->sr0 & ABORT_FLAGS) == 0)
+  {
+    this->sr0 = (this->sr0 & 01) | reason | (mode ? 0140 : 0) | ((address >> 12) & 016);
+  }
+
+  MemoryAbort abort = { address, MMU_VECTOR };
+  throw abort;
+}
+
+unsigned short *KT11::RegisterAt(unsigned short address)
+{
+  if (address >= KERNEL_PDR && address < KERNEL_PDR + 020)
+  {
+    return &this->pdr[0][(address - KERNEL_PDR) >> 1];
+  }
+
+  if (address >= KERNEL_PAR && address < KERNEL_PAR + 020)
+  {
+    return &this->par[0][(address - KERNEL_PAR) >> 1];
+  }
+
+  if (address >= USER_PDR && address < USER_PDR + 020)
+  {
+    return &this->pdr[1][(address - USER_PDR) >> 1];
+  }
+
+  if (address >= USER_PAR && address < USER_PAR + 020)
+  {
+    return &this->par[1][(address - USER_PAR) >> 1];
+  }
+
+  switch (address & ~01)
+  {
+    case SR0: return &this->sr0;
+    case SR2: return &this->sr2;
+    default: return NULL;
+  }
+}
+
+bool KT11::Read(unsigned short address, unsigned short &data)
+{
+  unsigned short *reg = this->RegisterAt(address);
+
+  if (!reg)
+  {
+    return false;
+  }
+
+  data = *reg;
+  return true;
+}
+
+/*
+ * Registers only keep their defined bits, writing a descriptor clears its
+ * written bit, and SR2 is read only.  Any write can change a translation,
+ * so the translation cache is emptied.
+ */
+bool KT11::Write(unsigned short address, unsigned short data, Width width)
+{
+  unsigned short *reg = this->RegisterAt(address);
+
+  if (!reg)
+  {
+    return false;
+  }
+
+  if (reg == &this->sr2)
+  {
+    return true;
+  }
+
+  if (width == byteWidth)
+  {
+    data = (address & 01) ? (*reg & 0x00FF) | (data << 8) : (*reg & 0xFF00) | (data & 0xFF);
+  }
+
+  if (reg == &this->sr0)
+  {
+    *reg = data & (ABORT_FLAGS | 0157);
+  }
+
+  else if (reg >= &this->par[0][0] && reg <= &this->par[1][7])
+  {
+    *reg = data & 07777;
+  }
+
+  else
+  {
+    *reg = data & (PDR_LENGTH | PDR_DOWN | PDR_ACCESS);
+  }
+
+  this->memory->FlushMapping();
+  this->memory->UpdateMapping();
+  return true;
+}
+/*}}}*/
+
+// Watchpoints/*{{{*/
+
+/*
+ * Watches the bytes first through last for the access types given, any
+ * combination of WatchType.  Each page with a watched byte is flagged in
+ * watchMap, so only accesses to those pages look at the list.  Setting
+ * the first watchpoint or clearing the last one switches the operand
+ * accessors, so everything decoded with the others is dropped.
+ */
+void Memory::SetWatchpoint(unsigned short first, unsigned short last, unsigned int types)
+{
+  if (!this->Watching())
+  {
+    this->ForgetCode();
+  }
+
+  Watchpoint watchpoint = { first, last, types };
+  this->watchpoints.push_back(watchpoint);
+  this->RebuildWatchMap();
 }
 
+// Removes the watchpoints on exactly first through last
+void Memory::ClearWatchpoint(unsigned short first, unsigned short last)
+{
+  bool watching = this->Watching();
+
+  for (std::vector<Watchpoint>::iterator it = this->watchpoints.begin(); it != this->watchpoints.end(); )
+  {
+    if (it->first == first && it->last == last)
+    {
+      it = this->watchpoints.erase(it);
+    }
+
+    else
+    {
+      ++it;
+    }
+  }
+
+  if (watching && !this->Watching())
+  {
+    this->ForgetCode();
+  }
+
+  this->RebuildWatchMap();
+}
+
+void Memory::ClearAllWatchpoints()
+{
+  if (this->Watching())
+  {
+    this->ForgetCode();
+  }
+
+  this->watchpoints.clear();
+  this->RebuildWatchMap();
+}
+
+void Memory::RebuildWatchMap()
+{
+  std::memset(this->watchMap, 0, WATCH_PAGES / 8);
+
+  for (std::vector<Watchpoint>::iterator it = this->watchpoints.begin(); it != this->watchpoints.end(); ++it)
+  {
+    for (unsigned int page = it->first >> WATCH_PAGE_SHIFT; page <= static_cast<unsigned int>(it->last >> WATCH_PAGE_SHIFT); ++page)
+    {
+      this->watchMap[page >> 3] |= 1 << (page & 07);
+    }
+  }
+}
+
+/*
+ * An access to a watched page.  The first access since ClearWatchHit()
+ * that a watchpoint covers is kept in watchHit for the CPU to stop on;
+ * the access itself still goes ahead.
+ */
+void Memory::Watch(unsigned short address, Width width, WatchType type, unsigned short data)
+{
+  if (this->watchTriggered)
+  {
+    return;
+  }
+
+  unsigned short last = address + width - 1;
+
+  for (std::vector<Watchpoint>::iterator it = this->watchpoints.begin(); it != this->watchpoints.end(); ++it)
+  {
+    if (it->first > last || it->last < address)
+    {
+      continue;
+    }
+
+    unsigned short old = this->Peek(address, width);
+    WatchType kind = type;
+    bool matched;
+
+    if (type == watchRead)
+    {
+      matched = it->types & watchRead;
+    }
+
+    else if (it->types & watchWrite)
+    {
+      matched = true;
+    }
+
+    else
+    {
+      matched = (it->types & watchChange) && old != data;
+      kind = watchChange;
+    }
+
+    if (matched)
+    {
+      WatchHit watchHit = { address, kind, old, type == watchRead ? old : data };
+      this->watchHit = watchHit;
+      this->watchTriggered = true;
+      return;
+    }
+  }
+}
+
+// Current value at address for a watchpoint, 0 if the access would fail
+unsigned short Memory::Peek(unsigned short address, Width width)
+{
+  try
+  {
+    unsigned short word = this->LoadWord(address & ~01);
+    return width == wordWidth ? word : (address & 01) ? word >> 8 : word & 0xFF;
+  }
+
+  catch (const MemoryAbort &error)
+  {
+    return 0;
+  }
+}
+/*}}}*/
+
 unsigned short Memory::RetrievePC()/*{{{*/
 {
-  return (this->RAM[PC + 1] << 8) | (this->RAM[PC] & 0xFF);
+  return this->registers[7];
+}
+/*}}}*/
+
+unsigned short Memory::ReadInstruction()/*{{{*/
+{
+  unsigned short address = this->RetrievePC();
+  // Trace file output
+  this->TraceDump(Transaction::instruction, this->RetrievePC());
+  this->mmu.Fetched(address);
+  return this->LoadWord(address);
 }
 /*}}}*/
 
-unsigned short Memory::EA(unsigned short encodedAddress, Transaction type)/*{{{*/
+// Operand access/*{{{*/
+
+/*
+ * Effective address of an operand.  MODE, REG and WIDTH are template
+ * arguments, so every instantiation is only the code for its own
+ * addressing mode and the switch, register and width tests fold away at
+ * compile time.  POLICY adds the watchpoint checks and trace records, an
+ * instantiation with neither has no instrumentation at all.
+ */
+template <int MODE, int REG, Width WIDTH, int POLICY>
+unsigned short Memory::OperandAddress(Transaction type)
 {
-  unsigned short mode = (encodedAddress & 070) >> 3;
-  unsigned short reg = (encodedAddress & 07);
   unsigned short decodedAddress = 0;
-  std::string modeType = "Not Set!";
 
-  switch(mode)
+  switch(MODE)
   {
     case 0: // General Register
       {
-        modeType = "General Register";
-
-        decodedAddress = regArray[reg];
+        decodedAddress = regArray[REG];
         break;
       }
 
     case 1: // Deferred Register
       {
-        modeType = "Deferred Register";
-
-        decodedAddress = (this->RAM[regArray[reg] + 1] << 8) | (this->RAM[regArray[reg]] & 0xFF);
+        decodedAddress = this->registers[REG];
         break;
       }
 
     case 2: // Autoincrement
       {
         // Check for immediate PC addressing
-        if (reg == 07)
+        if (REG == 07)
         {
-          modeType = "Immediate PC";
-
           // Point to the word after the instruction word
           decodedAddress = this->RetrievePC();
-		  if (type == Transaction::read)
+          if (type == Transaction::read)
           {
             this->IncrementPC();
           }
@@ -173,24 +920,20 @@ unsigned short Memory::EA(unsigned short encodedAddress, Transaction type)/*{{{*
            * Retrieve the memory address from encodedAddress
            * and then increment the pointer stored in encodedAddress
            */
-          modeType = "Autoincrement";
-
-          decodedAddress = (this->RAM[regArray[reg] + 1] << 8) | (this->RAM[regArray[reg]] & 0xFF);
-          //this->TraceDump(Transaction::read, decodedAddress);
+          decodedAddress = this->registers[REG];
 
           unsigned short  incrementedAddress;
-          if (regArray[reg] == SP)
+          if (REG == 06)
           {
             incrementedAddress = decodedAddress + 02;
           }
 
           else
           {
-            incrementedAddress = decodedAddress + byteMode;
+            incrementedAddress = decodedAddress + WIDTH;
           }
 
-          this->RAM[regArray[reg]] = incrementedAddress & 0xFF;
-          this->RAM[regArray[reg] + 1] = incrementedAddress >> 8;
+          this->registers[REG] = incrementedAddress;
         }
 
         break;
@@ -199,13 +942,11 @@ unsigned short Memory::EA(unsigned short encodedAddress, Transaction type)/*{{{*
     case 3: // Autoincrement Deferred
       {
         // Check for absolute PC addressing
-        if (reg == 07)
+        if (REG == 07)
         {
-          modeType = "Absolute PC";
-		  
           unsigned short address = this->RetrievePC();
-          decodedAddress = (this->RAM[address + 1] << 8) | (this->RAM[address] & 0xFF);
-		  if (type == Transaction::read)
+          decodedAddress = this->LoadWord(address);
+          if (type == Transaction::read)
           {
             this->IncrementPC();
           }
@@ -213,28 +954,33 @@ unsigned short Memory::EA(unsigned short encodedAddress, Transaction type)/*{{{*
 
         else
         {
-          modeType = "Autoincrement Deferred";
-
           // Read in address from reg
-          unsigned short address = (this->RAM[regArray[reg] + 1] << 8) | (this->RAM[regArray[reg]] & 0xFF);
+          unsigned short address = this->registers[REG];
 
           // Read in value from address
-          decodedAddress = (this->RAM[address + 1] << 8) | (this->RAM[address] & 0xFF);
-          this->TraceDump(Transaction::read, address);
+          if (POLICY & accessWatched)
+          {
+            this->CheckWatch(address, wordWidth, watchRead);
+          }
+
+          decodedAddress = this->LoadWord(address);
+
+          if (POLICY & accessTraced)
+          {
+            this->TraceDump(Transaction::read, address);
+          }
 
-          // Possibly case for byteMode?
           unsigned short incrementedAddress;
-          if (regArray[reg] == SP)
+          if (REG == 06)
           {
             incrementedAddress = address + 02;
           }
 
           else
           {
-            incrementedAddress = address + byteMode;
+            incrementedAddress = address + WIDTH;
           }
-          this->RAM[regArray[reg]] = incrementedAddress & 0xFF;
-          this->RAM[regArray[reg] + 1] = incrementedAddress >> 8;
+          this->registers[REG] = incrementedAddress;
         }
 
         break;
@@ -242,63 +988,65 @@ unsigned short Memory::EA(unsigned short encodedAddress, Transaction type)/*{{{*
 
     case 4: // Autodecrement
       {
-        modeType = "Autodecrement";
-
         /*
          * decrement address
          * then return value
          */
 
-        // Possibly case for byteMode?
-        unsigned short address = (this->RAM[regArray[reg] + 1] << 8) | (this->RAM[regArray[reg]] & 0xFF);
-        if (regArray[reg] == SP)
+        unsigned short address = this->registers[REG];
+        if (REG == 06)
         {
           decodedAddress = address - 02;
         }
 
         else
         {
-          decodedAddress = address - byteMode;
+          decodedAddress = address - WIDTH;
         }
-        this->RAM[regArray[reg]] = decodedAddress & 0xFF;
-        this->RAM[regArray[reg] + 1] = decodedAddress >> 8;
+        this->registers[REG] = decodedAddress;
         break;
       }
 
     case 5: // Autodecrement Deferred
       {
-        modeType = "Autodecrement Deferred";
-
         // Decrement Rn, and return the address in Rn
-        unsigned short address = (this->RAM[regArray[reg] + 1] << 8) | (this->RAM[regArray[reg]] & 0xFF);
+        unsigned short address = this->registers[REG];
         unsigned short decrementedAddress;
-        if (regArray[reg] == SP)
+        if (REG == 06)
         {
           decrementedAddress = address - 02;
         }
 
         else
         {
-          decrementedAddress = address - byteMode;
+          decrementedAddress = address - WIDTH;
         }
-        decodedAddress = (this->RAM[decrementedAddress + 1] << 8) | (this->RAM[decrementedAddress] & 0xFF);
-        this->RAM[regArray[reg]] = decrementedAddress & 0xFF;
-        this->RAM[regArray[reg] + 1] = decrementedAddress >> 8;
-        this->TraceDump(Transaction::read, decrementedAddress);
+
+        if (POLICY & accessWatched)
+        {
+          this->CheckWatch(decrementedAddress, wordWidth, watchRead);
+        }
+
+        decodedAddress = this->LoadWord(decrementedAddress);
+        this->registers[REG] = decrementedAddress;
+
+        if (POLICY & accessTraced)
+        {
+          this->TraceDump(Transaction::read, decrementedAddress);
+        }
+
         break;
       }
 
     case 6: // Indexed
       {
         // Check for relative PC addressing
-        if (reg == 07)
+        if (REG == 07)
         {
-          modeType = "Relative PC";
-
           unsigned short address = this->RetrievePC();
-          unsigned short relativeAddress = ((this->RAM[address + 1] << 8) & 0xFF00) | (this->RAM[address] & 0xFF);
+          unsigned short relativeAddress = this->LoadWord(address);
           decodedAddress = address + relativeAddress + 02;
-		  if (type == Transaction::read)
+          if (type == Transaction::read)
           {
             this->IncrementPC();
           }
@@ -306,14 +1054,12 @@ unsigned short Memory::EA(unsigned short encodedAddress, Transaction type)/*{{{*
 
         else
         {
-          modeType = "Indexed";
-
           // Retrieve the index offset from memory
-          unsigned short base = (this->RAM[regArray[reg] + 1] << 8) | (this->RAM[regArray[reg]] & 0xFF);
+          unsigned short base = this->registers[REG];
           unsigned short offsetAddress = this->RetrievePC();
-          unsigned short offset = (this->RAM[offsetAddress + 1] << 8) | (this->RAM[offsetAddress] & 0xFF);
+          unsigned short offset = this->LoadWord(offsetAddress);
           decodedAddress = offset + base;
-		  if (type == Transaction::read)
+          if (type == Transaction::read)
           {
             this->IncrementPC();
           }
@@ -325,15 +1071,18 @@ unsigned short Memory::EA(unsigned short encodedAddress, Transaction type)/*{{{*
     case 7: // Deferred Indexed
       {
         // Check for deferred relative PC addressing
-        if (reg == 07)
+        if (REG == 07)
         {
-          modeType = "Deferred Relative PC";
-
           unsigned short address = this->RetrievePC();
-          unsigned short relativeAddress = (this->RAM[address + 1] << 8) | (this->RAM[address] & 0xFF);
+          unsigned short relativeAddress = this->LoadWord(address);
           unsigned short relativeAddressAddress = address + relativeAddress;
-          decodedAddress = (this->RAM[relativeAddressAddress + 1] << 8) | (this->RAM[relativeAddressAddress] & 0xFF);
-		  if (type == Transaction::read)
+          if (POLICY & accessWatched)
+          {
+            this->CheckWatch(relativeAddressAddress, wordWidth, watchRead);
+          }
+
+          decodedAddress = this->LoadWord(relativeAddressAddress);
+          if (type == Transaction::read)
           {
             this->IncrementPC();
           }
@@ -341,122 +1090,176 @@ unsigned short Memory::EA(unsigned short encodedAddress, Transaction type)/*{{{*
 
         else
         {
-          modeType = "Deferred Indexed";
-
           /*
            * The address is the some of the contents pointed to by the
            * operand plus the specified offset which is the word following
            * the instruction
            */
 
-          unsigned short base = (this->RAM[regArray[reg] + 1] << 8) | (this->RAM[regArray[reg]] & 0xFF);
+          unsigned short base = this->registers[REG];
           unsigned short offsetAddress = this->RetrievePC();
-          unsigned short offset = (this->RAM[offsetAddress + 1] << 8) | (this->RAM[offsetAddress] & 0xFF);
+          unsigned short offset = this->LoadWord(offsetAddress);
           unsigned short address = offset + base;
-          decodedAddress = (this->RAM[address + 1] << 8) | (this->RAM[address] & 0xFF);
+          if (POLICY & accessWatched)
+          {
+            this->CheckWatch(address, wordWidth, watchRead);
+          }
+
+          decodedAddress = this->LoadWord(address);
           if (type == Transaction::read)
           {
             this->IncrementPC();
           }
-          this->TraceDump(Transaction::read, address);
+
+          if (POLICY & accessTraced)
+          {
+            this->TraceDump(Transaction::read, address);
+          }
         }
 
         break;
       }
-
-    default:
-      break;
-  }
-
-  if (this->debugLevel == Verbosity::verbose)
-  {
-    //std::cout << "Mode Type: " << modeType << "(" << static_cast<int>(mode) << ")" << std::endl;
-    //std::cout << "Register: " << static_cast<int>(reg) << std::endl;
   }
 
   return decodedAddress;
-}/*}}}*/
+}
 
-unsigned short Memory::Read(unsigned short encodedAddress)/*{{{*/
+template <int MODE, int REG, Width WIDTH, int POLICY>
+unsigned short Memory::ReadOperand()
 {
-  unsigned short address = this->EA(encodedAddress);
+  // Register mode operands go straight to the register file
+  if (MODE == 0)
+  {
+    unsigned short value = this->registers[REG];
+    return WIDTH == byteWidth ? value & 0xFF : value;
+  }
+
+  unsigned short address = this->OperandAddress<MODE, REG, WIDTH, POLICY>(Transaction::read);
 
   // If not a general register operand then do a trace dump
-  if (address < R0)
+  if ((POLICY & accessTraced) && address < R0)
   {
     this->TraceDump(Transaction::read, address);
   }
 
-  /*
-   * Read either a byte or a word from memory depending on the value
-   * of the internal byteMode flag.
-   */
-  if (this->byteMode == 01)
+  if (POLICY & accessWatched)
+  {
+    this->CheckWatch(address, WIDTH, watchRead);
+  }
+
+  // Read either a byte or a word from memory depending on the width
+  if (WIDTH == byteWidth)
   {
-    return this->RAM[address];
+    return this->LoadByte(address);
   }
 
   else
   {
-    return (this->RAM[address + 1] << 8) | (this->RAM[address] & 0xFF);
+    return this->LoadWord(address);
   }
 }
-/*}}}*/
 
-unsigned short Memory::ReadInstruction()/*{{{*/
+template <int MODE, int REG, Width WIDTH, int POLICY>
+void Memory::WriteOperand(unsigned short data)
 {
-  unsigned short address = this->RetrievePC();
-  // Trace file output
-  this->TraceDump(Transaction::instruction, this->RetrievePC());
-  return (this->RAM[address + 1] << 8) | (this->RAM[address] & 0xFF);
-}
-/*}}}*/
+  if (MODE == 0)
+  {
+    unsigned short &value = this->registers[REG];
+    value = WIDTH == byteWidth ? (value & 0xFF00) | (data & 0xFF) : data;
+    return;
+  }
 
-void Memory::Write(unsigned short encodedAddress, unsigned short data)/*{{{*/
-{
-  unsigned short address = this->EA(encodedAddress, Transaction::write);
+  unsigned short address = this->OperandAddress<MODE, REG, WIDTH, POLICY>(Transaction::write);
 
   // If not a general register operand then do a trace dump
-  if (address < R0)
+  if ((POLICY & accessTraced) && address < R0)
   {
     this->TraceDump(Transaction::write, address);
   }
 
+  if (POLICY & accessWatched)
+  {
+    this->CheckWatch(address, WIDTH, watchWrite, WIDTH == byteWidth ? data & 0xFF : data);
+  }
+
   // Write the data to the specified memory address
-  if (this->byteMode == 01)
+  if (WIDTH == byteWidth)
   {
-    this->RAM[address] = data & 0xFF;
+    this->CheckCode(address);
+    this->StoreByte(address, data & 0xFF);
   }
 
   else
   {
-    this->RAM[address] = data & 0xFF;
-    this->RAM[address + 1] = data >> 8;
+    this->CheckCode(address);
+    this->StoreWord(address, data);
   }
 
   return;
 }
+
+// Operand specifiers 00-77, one table entry each
+#define MODE_SPECS(X, policy, mode) X(policy, mode, 0) X(policy, mode, 1) X(policy, mode, 2) \
+  X(policy, mode, 3) X(policy, mode, 4) X(policy, mode, 5) X(policy, mode, 6) X(policy, mode, 7)
+#define OPERAND_SPECS(X, policy) MODE_SPECS(X, policy, 0) MODE_SPECS(X, policy, 1) \
+  MODE_SPECS(X, policy, 2) MODE_SPECS(X, policy, 3) MODE_SPECS(X, policy, 4) \
+  MODE_SPECS(X, policy, 5) MODE_SPECS(X, policy, 6) MODE_SPECS(X, policy, 7)
+
+#define ADDRESSER_ENTRY(policy, mode, reg) &Memory::OperandAddress<mode, reg, wordWidth, policy>,
+#define WORD_READER_ENTRY(policy, mode, reg) &Memory::ReadOperand<mode, reg, wordWidth, policy>,
+#define BYTE_READER_ENTRY(policy, mode, reg) &Memory::ReadOperand<mode, reg, byteWidth, policy>,
+#define WORD_WRITER_ENTRY(policy, mode, reg) &Memory::WriteOperand<mode, reg, wordWidth, policy>,
+#define BYTE_WRITER_ENTRY(policy, mode, reg) &Memory::WriteOperand<mode, reg, byteWidth, policy>,
+#define POLICY_ADDRESSERS(policy) { OPERAND_SPECS(ADDRESSER_ENTRY, policy) },
+#define POLICY_READERS(policy) \
+  { { OPERAND_SPECS(WORD_READER_ENTRY, policy) }, { OPERAND_SPECS(BYTE_READER_ENTRY, policy) } },
+#define POLICY_WRITERS(policy) \
+  { { OPERAND_SPECS(WORD_WRITER_ENTRY, policy) }, { OPERAND_SPECS(BYTE_WRITER_ENTRY, policy) } },
+#define EACH_POLICY(X) X(0) X(1) X(2) X(3)
+const OperandAddresser Memory::addressers[ACCESS_POLICIES][64] =
+{
+  EACH_POLICY(POLICY_ADDRESSERS)
+};
+const OperandReader Memory::readers[ACCESS_POLICIES][2][64] =
+{
+  EACH_POLICY(POLICY_READERS)
+};
+const OperandWriter Memory::writers[ACCESS_POLICIES][2][64] =
+{
+  EACH_POLICY(POLICY_WRITERS)
+};
+#undef MODE_SPECS
+#undef OPERAND_SPECS
+#undef ADDRESSER_ENTRY
+#undef WORD_READER_ENTRY
+#undef BYTE_READER_ENTRY
+#undef WORD_WRITER_ENTRY
+#undef BYTE_WRITER_ENTRY
+#undef POLICY_ADDRESSERS
+#undef POLICY_READERS
+#undef POLICY_WRITERS
+#undef EACH_POLICY
 /*}}}*/
 
 unsigned short Memory::StackPop()/*{{{*/
 {
   // Read stack
-  unsigned short address = (this->RAM[SP + 1] << 8) | (this->RAM[SP] & 0xFF);
+  unsigned short address = this->registers[6];
 
   // Increment stack pointer
   address += 02;
-  this->RAM[SP] = address & 0xFF;
-  this->RAM[SP + 1] = address >> 8;
+  this->registers[6] = address;
 
   // Return data
-  return (this->RAM[address + 1] << 8) | (this->RAM[address] & 0xFF);
+  this->CheckWatch(address, wordWidth, watchRead);
+  return this->LoadWord(address);
 }
 /*}}}*/
 
 void Memory::StackPush(unsigned short _register)/*{{{*/
 {
 
-  unsigned short address = (this->RAM[SP + 1] << 8) | (this->RAM[SP] & 0xFF);
+  unsigned short address = this->registers[6];
   /*
    * Check if stack pointer has exceeded it's limit.
    * If it has then we need to crash and burn.
@@ -466,16 +1269,17 @@ void Memory::StackPush(unsigned short _register)/*{{{*/
   {
     // Decrement stack pointer
     address -= 02;
-    this->RAM[SP] = address & 0xFF;
-    this->RAM[SP + 1] = address >> 8;
+    this->registers[6] = address;
 
     // Get location in memory to write to
     this->TraceDump(Transaction::write, address);
-    unsigned short location = (this->RAM[address + 1] << 8) | (this->RAM[address] & 0xFF);
+    this->CheckWatch(address, wordWidth, watchRead);
+    unsigned short location = this->LoadWord(address);
 
     // Write the data
-    this->RAM[location] = _register & 0xFF;
-    this->RAM[location + 1] = _register >> 8;
+    this->CheckWatch(location, wordWidth, watchWrite, _register);
+    this->CheckCode(location);
+    this->StoreWord(location, _register);
   }
 
   else
@@ -489,60 +1293,111 @@ void Memory::StackPush(unsigned short _register)/*{{{*/
 
 void Memory::RegDump()/*{{{*/
 {
+  this->SyncPS();
   std::cout << "Dumping current register contents..." << std::endl;
-  std::cout << "R0: " << std::oct << static_cast<unsigned short>((this->RAM[R0 + 1] << 8) | (this->RAM[R0] & 0xFF)) << std::endl;
-  std::cout << "R1: " << std::oct << static_cast<unsigned short>((this->RAM[R1 + 1] << 8) | (this->RAM[R1] & 0xFF)) << std::endl;
-  std::cout << "R2: " << std::oct << static_cast<unsigned short>((this->RAM[R2 + 1] << 8) | (this->RAM[R2] & 0xFF)) << std::endl;
-  std::cout << "R3: " << std::oct << static_cast<unsigned short>((this->RAM[R3 + 1] << 8) | (this->RAM[R3] & 0xFF)) << std::endl;
-  std::cout << "R4: " << std::oct << static_cast<unsigned short>((this->RAM[R4 + 1] << 8) | (this->RAM[R4] & 0xFF)) << std::endl;
-  std::cout << "R5: " << std::oct << static_cast<unsigned short>((this->RAM[R5 + 1] << 8) | (this->RAM[R5] & 0xFF)) << std::endl;
-  std::cout << "SP: " << std::oct << static_cast<unsigned short>((this->RAM[SP + 1] << 8) | (this->RAM[SP] & 0xFF)) << std::endl;
-  std::cout << "PC: " << std::oct << static_cast<unsigned short>((this->RAM[PC + 1] << 8) | (this->RAM[PC] & 0xFF)) << std::endl;
+  std::cout << "R0: " << std::oct << this->registers[0] << std::endl;
+  std::cout << "R1: " << std::oct << this->registers[1] << std::endl;
+  std::cout << "R2: " << std::oct << this->registers[2] << std::endl;
+  std::cout << "R3: " << std::oct << this->registers[3] << std::endl;
+  std::cout << "R4: " << std::oct << this->registers[4] << std::endl;
+  std::cout << "R5: " << std::oct << this->registers[5] << std::endl;
+  std::cout << "SP: " << std::oct << this->registers[6] << std::endl;
+  std::cout << "PC: " << std::oct << this->registers[7] << std::endl;
   std::cout << std::endl;
   std::cout << "Processor status word: " << std::endl;
-  std::cout << "N: " << std::oct << ((static_cast<unsigned short>(this->RAM[PS]) & 0x8) >> 3) << std::endl;
-  std::cout << "Z: " << std::oct << ((static_cast<unsigned short>(this->RAM[PS]) & 0x4) >> 2) << std::endl;
-  std::cout << "V: " << std::oct << ((static_cast<unsigned short>(this->RAM[PS]) & 0x2) >> 1) << std::endl;
-  std::cout << "C: " << std::oct << (static_cast<unsigned short>(this->RAM[PS]) & 0x1)        << std::endl;
+  std::cout << "N: " << std::oct << ((this->registers[8] & 0x8) >> 3) << std::endl;
+  std::cout << "Z: " << std::oct << ((this->registers[8] & 0x4) >> 2) << std::endl;
+  std::cout << "V: " << std::oct << ((this->registers[8] & 0x2) >> 1) << std::endl;
+  std::cout << "C: " << std::oct << (this->registers[8] & 0x1)        << std::endl;
   return;
 }/*}}}*/
 
-void Memory::TraceDump(Transaction type, unsigned short address)/*{{{*/
-{
-  std::string buffer;
-  std::stringstream stream;
-  stream << std::oct << type;
-  buffer.append(stream.str());
-  buffer.append(" ");
-  stream.str(std::string());
-  stream.clear();
-  stream << std::setfill('0') << std::setw(6);
-  stream << std::oct << address;
-  buffer.append(stream.str());
-  buffer.append("\n");
-  *traceFile << buffer;
+/*
+ * Hands the records TraceDump() has put in the current segment to the
+ * writer thread.  trace2text.py turns the trace into the old trace.txt
+ * lines.
+ */
+void Memory::FlushTrace()/*{{{*/
+{
+  if (this->traceClosed)
+  {
+    this->traceUsed = 0;
+    return;
+  }
 
+  this->StartTrace();
+  this->traceBuffer = this->traceWriter->Submit(this->traceUsed);
+  this->traceUsed = 0;
   return;
 }/*}}}*/
 
+void Memory::StartTrace()/*{{{*/
+{
+  if (!this->traceStarted)
+  {
+    this->traceWriter->Begin(this->traceIndexed);
+    this->traceStarted = true;
+  }
+}/*}}}*/
+
+// Switches the operand accessors with or without trace records
+void Memory::SetTraceEnabled(bool enabled)/*{{{*/
+{
+  if (enabled != this->traceEnabled)
+  {
+    this->ForgetCode();
+  }
+
+  this->traceEnabled = enabled;
+}/*}}}*/
+
+// Resizes the ring between the CPU and the writer thread, see TraceWriter
+void Memory::SetTraceRing(unsigned int ringBytes, TraceFullPolicy policy)/*{{{*/
+{
+  this->traceWriter->Configure(ringBytes, policy);
+  this->traceBuffer = this->traceWriter->Segment();
+}/*}}}*/
+
+/*
+ * Writes out the rest of the trace, anything traced afterwards is dropped.
+ * A run that never traced anything leaves no trace files behind.
+ */
+void Memory::CloseTrace()/*{{{*/
+{
+  if (!this->traceClosed)
+  {
+    if (!this->traceStarted && this->traceUsed == 0)
+    {
+      this->traceClosed = true;
+      return;
+    }
+
+    this->StartTrace();
+    this->traceWriter->Finish(this->traceUsed);
+    this->traceUsed = 0;
+    this->traceClosed = true;
+  }
+}/*}}}*/
+
 // ReadPS() and WritePS(unsigned short)/*{{{*/
 // ReadPS()
 unsigned short Memory::ReadPS()
 {
-  return (this->RAM[PS + 1] << 8) | (this->RAM[PS] & 0xFF);
+  this->SyncPS();
+  return this->registers[8];
 }
 
 // WritePS()
 void Memory::WritePS(unsigned short status)
 {
-  this->RAM[PS] = status & 0xFF;
-  this->RAM[PS + 1] = (status >> 8);
+  this->SyncPS();
+  this->registers[8] = status;
+  this->UpdateMapping();
 } /*}}}*/
 
 void Memory::ResetPC()/*{{{*/
 {
-  this->RAM[PC] = initialPC & 0xFF;
-  this->RAM[PC + 1] = initialPC >> 8;
+  this->registers[7] = initialPC;
 
   if (debugLevel == Verbosity::verbose)
   {
@@ -552,11 +1407,54 @@ void Memory::ResetPC()/*{{{*/
   return;
 }/*}}}*/
 
-// Restore RAM to initial state of program
-void Memory::ResetRAM()
+/*
+ * Restore RAM to initial state of program.  Only the pages stored to since
+ * the last reset can differ from the initial image, so only they are
+ * copied back, and only code decoded from them is dropped.  Returns the
+ * number of pages restored.
+ */
+unsigned int Memory::ResetRAM()
 {
-  for (int i = 0; i < 65536; ++i)
+  // Settle any pending condition codes so they cannot land on the restored PS
+  this->SyncPS();
+
+  unsigned int restored = 0;
+
+  for (unsigned int page = 0; page < RAM_PAGES; ++page)
   {
-    this->RAM[i] = this->initialRAM[i];
+    if (this->dirtyMap[page])
+    {
+      unsigned int start = page << DIRTY_PAGE_SHIFT;
+
+      // Decoded code is only kept for unmapped RAM, where physical is virtual
+      for (unsigned int address = start; address < start + (1U << DIRTY_PAGE_SHIFT) && address < IO_PAGE; address += 2)
+      {
+        this->CheckCode(address);
+      }
+
+      std::memcpy(this->RAM + (start >> 1), this->initialRAM + (start >> 1), 1U << DIRTY_PAGE_SHIFT);
+      this->dirtyMap[page] = 0;
+      ++restored;
+    }
+  }
+
+  for (int i = 0; i < 9; ++i)
+  {
+    this->registers[i] = this->initialRegisters[i];
   }
+
+  // Memory management goes back to how it started, off unless a snapshot set it up
+  this->mmu = this->initialMMU;
+  this->mode = this->registers[8] >> 15;
+  this->stackPointers[0] = this->initialStackPointers[0];
+  this->stackPointers[1] = this->initialStackPointers[1];
+  this->FlushMapping();
+  this->UpdateMapping();
+
+  if (debugLevel == Verbosity::verbose)
+  {
+    std::cout << "Reset restored " << std::dec << restored << " of " << RAM_PAGES << " RAM pages" << std::endl;
+  }
+
+  return restored;
 }
@@ -4,6 +4,8 @@
 #include <fstream>
 #include <string>
 #include <vector>
+#include "snapshot.h"
+#include "traceWriter.h"
 
 // Register memory locations
 #define R0 0177700U
@@ -16,6 +18,51 @@
 #define PC 0177734U
 #define PS 0177776U
 
+// The register file is mapped over the top of the I/O page
+#define REGISTER_PAGE 0177700U
+
+// Unibus I/O page, everything below it is plain RAM
+#define IO_PAGE 0160000U
+
+// 18-bit physical memory, the I/O page sits at the top of it
+#define PHYSICAL_IO_PAGE 0760000U
+#define RAM_WORDS (PHYSICAL_IO_PAGE >> 1)
+
+// KT11 status registers, the page registers are listed in memory.cpp
+#define SR0 0177572U
+#define SR2 0177576U
+
+// Trap vectors for aborted accesses
+#define BUS_ERROR_VECTOR 04
+#define MMU_VECTOR 0250
+
+// The I/O page is dispatched to devices in pages of this many bytes
+#define BUS_PAGE_SHIFT 3
+#define BUS_PAGES ((0200000U - IO_PAGE) >> BUS_PAGE_SHIFT)
+
+// Byte offset of a PDP-11 byte within the host's copy of its word
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define BYTE_SWIZZLE 1
+#else
+#define BYTE_SWIZZLE 0
+#endif
+
+// RAM is tracked for ResetRAM() in pages of this many bytes
+#define DIRTY_PAGE_SHIFT 6
+#define RAM_PAGES (PHYSICAL_IO_PAGE >> DIRTY_PAGE_SHIFT)
+
+// Mapped addresses are cached per 64-byte block, the unit of a page's length
+#define TLB_SHIFT 6
+#define TLB_ENTRIES (0200000U >> TLB_SHIFT)
+#define TLB_WORDS (1U << (TLB_SHIFT - 1))
+
+// Watchpoints are looked up per page of this many bytes of virtual space
+#define WATCH_PAGE_SHIFT 6
+#define WATCH_PAGES (0200000U >> WATCH_PAGE_SHIFT)
+
+// Largest trace record, see traceWriter.h
+#define TRACE_RECORD_MAX 7
+
 // Debug levels
 enum Verbosity
 {
@@ -32,40 +79,452 @@ enum Transaction
   instruction
 };
 
+// Operand widths, which are also the autoincrement and autodecrement step
+enum Width
+{
+  byteWidth = 01,
+  wordWidth = 02
+};
+
+// Data accesses a watchpoint can stop on
+enum WatchType
+{
+  watchRead = 01,
+  watchWrite = 02,
+  watchChange = 04              // Only writes that change the value
+};
+
+// A watched range of virtual addresses
+struct Watchpoint
+{
+  unsigned short first;         // First and last byte watched
+  unsigned short last;
+  unsigned int types;           // WatchType bits
+};
+
+// The first watched access since Memory::ClearWatchHit()
+struct WatchHit
+{
+  unsigned short address;
+  WatchType type;
+  unsigned short oldValue;      // Before a write, or the value read
+  unsigned short newValue;
+};
+
+class Memory;
+
+// Instrumentation compiled into an operand accessor, see memory.cpp
+enum AccessPolicy
+{
+  accessPlain = 0,
+  accessWatched = 01,
+  accessTraced = 02
+};
+#define ACCESS_POLICIES 4
+
+// Operand access compiled for one addressing mode, register and width
+typedef unsigned short (Memory::*OperandAddresser)(Transaction type);
+typedef unsigned short (Memory::*OperandReader)();
+typedef void (Memory::*OperandWriter)(unsigned short data);
+
+// Told when a store lands on a word that was marked as code
+class CodeObserver
+{
+  public:
+    virtual ~CodeObserver() {};
+    virtual void InvalidateCode(unsigned short address) = 0;
+    virtual void InvalidateAllCode() = 0;
+};
+
+// Asked to bring the condition codes in PS up to date before PS is used
+class ConditionCodeSource
+{
+  public:
+    virtual ~ConditionCodeSource() {};
+    virtual void SyncConditionCodes() = 0;
+};
+
+/*
+ * A Unibus peripheral answering for registers in the I/O page.  Reads are
+ * always of the whole word at an even address, a byte write carries its
+ * own byte address and the data in the low byte.  Returning false means
+ * nothing answered and the access becomes a bus error.
+ */
+class Device
+{
+  public:
+    virtual ~Device() {};
+    virtual bool Read(unsigned short address, unsigned short &data) = 0;
+    virtual bool Write(unsigned short address, unsigned short data, Width width) = 0;
+};
+
+/*
+ * Thrown out of an instruction whose access has to be abandoned: an
+ * address nothing answers at or a word at an odd address, which are bus
+ * errors, or one the memory management unit refuses.
+ */
+struct MemoryAbort
+{
+  unsigned short address;
+  unsigned short vector;        // Where the CPU traps to
+};
+
+// The CPU's R0-R7 and PS where the source addresses them in the I/O page
+class RegisterFile : public Device
+{
+  public:
+    RegisterFile(Memory *memory) { this->memory = memory; };
+    bool Read(unsigned short address, unsigned short &data);
+    bool Write(unsigned short address, unsigned short data, Width width);
+
+  private:
+    unsigned short *RegisterAt(unsigned short address);
+    Memory *memory;
+};
+
+/*
+ * KT11 memory management, with the 11/40's KT11-D register layout.  Kernel
+ * and user mode each have eight page address registers, which relocate a
+ * 8 KB page of virtual space anywhere in 18-bit physical memory in 64-byte
+ * steps, and eight page descriptor registers giving each page's length,
+ * direction and access.  SR0 enables relocation and records aborts.
+ */
+class KT11 : public Device
+{
+  public:
+    KT11(Memory *memory);
+    bool Read(unsigned short address, unsigned short &data);
+    bool Write(unsigned short address, unsigned short data, Width width);
+    bool Enabled() const { return sr0 & 01; };
+    unsigned int Relocate(unsigned short address, int mode, Transaction type);
+    void Fetched(unsigned short address) { if ((sr0 & 0160000) == 0) sr2 = address; };
+    void Reset();
+    void Save(SnapshotHeader &header) const;
+    void Restore(const SnapshotHeader &header);
+
+  private:
+    unsigned short *RegisterAt(unsigned short address);
+    void Abort(unsigned short address, int mode, unsigned short reason);
+    Memory *memory;
+    unsigned short par[2][8];   // Kernel then user
+    unsigned short pdr[2][8];
+    unsigned short sr0;
+    unsigned short sr2;
+};
+
 
 class Memory
 {
+  friend class Translator;      // Generated code works on RAM directly
+  friend class RegisterFile;
+  friend class KT11;
+
   public:
-    Memory(std::vector<std::string> *source);
+    Memory();
+    bool LoadImage(const std::string &path);
+    bool SaveSnapshot(const std::string &path, unsigned long long instructions, unsigned long long cycles);
+    bool LoadSnapshot(const std::string &path);
+    unsigned long long InitialInstructions() const { return initialInstructions; };
+    unsigned long long InitialCycles() const { return initialCycles; };
     ~Memory();
     unsigned short ReadAddress(unsigned short address);
     void WriteAddress(unsigned short address, unsigned short data);
-    void DecrementPC() { RAM[PC] = RAM[PC] - 2; };
-    void IncrementPC() { RAM[PC] = RAM[PC] + 2; };
+    unsigned short ReadWord(unsigned short address)
+    {
+      CheckWatch(address, wordWidth, watchRead);
+      return LoadWord(address);
+    };
+    void WriteWord(unsigned short address, unsigned short data);
+    void AttachDevice(Device *device, unsigned short base, unsigned short size);
+    void DecrementPC() { StepPC(-2); };
+    void IncrementPC() { StepPC(2); };
     unsigned short RetrievePC();
-    unsigned short EA(unsigned short encodedAddress, Transaction type = Transaction::read);
-    unsigned short Read(unsigned short encodedAddress);
     unsigned short ReadInstruction();
-    void Write(unsigned short encodedAddress, unsigned short data);
+    void AttachRegisters(unsigned short *registers);
+
+    // Accessors for an operand specifier, picked once when it is decoded
+    OperandReader Reader(unsigned short encodedAddress, Width width) const
+    {
+      return readers[Policy()][width == byteWidth][encodedAddress & 077];
+    };
+
+    OperandWriter Writer(unsigned short encodedAddress, Width width) const
+    {
+      return writers[Policy()][width == byteWidth][encodedAddress & 077];
+    };
+
+    // Word operands for fixed specifiers such as the PC, registers are never watched or traced
+    unsigned short EA(unsigned short encodedAddress, Transaction type = Transaction::read)
+    {
+      return (this->*addressers[Policy(encodedAddress)][encodedAddress & 077])(type);
+    };
+
+    unsigned short Read(unsigned short encodedAddress)
+    {
+      return (this->*readers[Policy(encodedAddress)][0][encodedAddress & 077])();
+    };
+
+    void Write(unsigned short encodedAddress, unsigned short data)
+    {
+      (this->*writers[Policy(encodedAddress)][0][encodedAddress & 077])(data);
+    };
+
     void SetDebugMode(Verbosity verbosity) { debugLevel = verbosity; };
     unsigned short StackPop();
     void StackPush(unsigned short _register);
     void RegDump();
-    void TraceDump(Transaction type, unsigned short address);
-    void SetByteMode() { byteMode = 01; };
-    void ClearByteMode() { byteMode = 02; };
+    void TraceDump(Transaction type, unsigned short address)
+    {
+      if (!traceEnabled)
+      {
+        return;
+      }
+
+      if (traceUsed > TRACE_SEGMENT_BYTES - TRACE_RECORD_MAX)
+      {
+        FlushTrace();
+      }
+
+      unsigned char *record = traceBuffer + traceUsed;
+      record[0] = type;
+      record[1] = address & 0xFF;
+      record[2] = address >> 8;
+      traceUsed += 3;
+
+      if (traceIndexed)
+      {
+        unsigned int index = type == Transaction::instruction ? traceInstructions++ : traceInstructions - 1;
+        record[3] = index & 0xFF;
+        record[4] = (index >> 8) & 0xFF;
+        record[5] = (index >> 16) & 0xFF;
+        record[6] = index >> 24;
+        traceUsed += 4;
+      }
+    };
+    void SetTraceEnabled(bool enabled);
+    bool TraceEnabled() const { return traceEnabled; };
+
+    // Trace settings only take effect before anything is traced
+    void SetTraceIndexed(bool indexed) { traceIndexed = indexed; };
+    void SetTraceRing(unsigned int ringBytes, TraceFullPolicy policy);
+    void SetTraceCompressed(bool compressed) { traceWriter->SetCompressed(compressed); };
+    void SetTraceName(const std::string &name) { traceWriter->SetName(name); };
+    void CloseTrace();
+    unsigned long long TraceWaits() const { return traceWriter->Waits(); };
+    unsigned long long TraceDropped() const { return traceWriter->DroppedBytes() / (traceIndexed ? 7 : 3); };
     void ResetPC();
-    void ResetRAM();
+    unsigned int ResetRAM();
     unsigned short ReadPS();
     void WritePS(unsigned short status);
+    void SetCodeObserver(CodeObserver *observer) { codeObserver = observer; };
+    void SetConditionCodeSource(ConditionCodeSource *source) { conditionCodes = source; };
+    void MarkCode(unsigned short address) { codeMap[address >> 4] |= 1 << ((address >> 1) & 07); };
+
+    // Read, write and value change watchpoints, see memory.cpp
+    void SetWatchpoint(unsigned short first, unsigned short last, unsigned int types);
+    void ClearWatchpoint(unsigned short first, unsigned short last);
+    void ClearAllWatchpoints();
+    unsigned int Watchpoints() const { return watchpoints.size(); };
+    bool Watching() const { return !watchpoints.empty(); };
+
+    // AccessPolicy bits for the accessors in use, changing them forgets all decoded code
+    int Policy() const { return (Watching() ? accessWatched : 0) | (traceEnabled ? accessTraced : 0); };
+    int Policy(unsigned short encodedAddress) const { return encodedAddress >= 010 ? Policy() : accessPlain; };
+    bool WatchTriggered() const { return watchTriggered; };
+    const WatchHit &LastWatchHit() const { return watchHit; };
+    void ClearWatchHit() { watchTriggered = false; };
+
+    // Below this virtual address RAM is reached directly, 0 while mapping
+    unsigned short DirectLimit() const { return directLimit; };
+    bool Mapped() const { return directLimit == 0; };
 
   private:
-    int byteMode;
+    void StepPC(short delta) { registers[7] += delta; };
+    void CheckCode(unsigned short address);
+
+    // One instantiation per addressing mode, register, width and policy, see memory.cpp
+    template <int MODE, int REG, Width WIDTH, int POLICY> unsigned short OperandAddress(Transaction type);
+    template <int MODE, int REG, Width WIDTH, int POLICY> unsigned short ReadOperand();
+    template <int MODE, int REG, Width WIDTH, int POLICY> void WriteOperand(unsigned short data);
+    static const OperandAddresser addressers[ACCESS_POLICIES][64];
+    static const OperandReader readers[ACCESS_POLICIES][2][64];   // Word then byte
+    static const OperandWriter writers[ACCESS_POLICIES][2][64];
+
+    // The CPU may still owe PS its latest condition codes
+    void SyncPS()
+    {
+      if (conditionCodes)
+      {
+        conditionCodes->SyncConditionCodes();
+      }
+    };
+
+    // Unibus cycles to whatever device the page of address is attached to
+    unsigned short BusRead(unsigned short address);
+    void BusWrite(unsigned short address, unsigned short data, Width width);
+    void OddAddress(unsigned short address);
+
+    /*
+     * Operand, stack and vector accesses are checked against the
+     * watchpoints before they are made.  Unless their page holds a
+     * watchpoint that is a single bit test.  Operands are only checked at
+     * all while there are watchpoints, and instruction fetches and the
+     * console never are.
+     */
+    void CheckWatch(unsigned short address, Width width, WatchType type, unsigned short data = 0)
+    {
+      if (watchMap[address >> (WATCH_PAGE_SHIFT + 3)] & (1 << ((address >> WATCH_PAGE_SHIFT) & 07)))
+      {
+        Watch(address, width, type, data);
+      }
+    };
+    void Watch(unsigned short address, Width width, WatchType type, unsigned short data);
+    void FlushTrace();
+    void StartTrace();
+    void RebuildWatchMap();
+    void ForgetCode();
+    unsigned short Peek(unsigned short address, Width width);
+
+    // Accesses that miss the translation cache, see memory.cpp
+    unsigned short LoadMapped(unsigned short address);
+    void StoreMapped(unsigned short address, unsigned short data, Width width);
+    unsigned int Relocate(unsigned short address, Transaction type);
+    void UpdateMapping();
+    void FlushMapping();
+
+    // RAM seen a byte at a time
+    unsigned char *Bytes() { return reinterpret_cast<unsigned char *>(RAM); };
+
+    /*
+     * Byte and word accesses, the only way at RAM and the I/O page.  Words
+     * are stored in host order, so a word access is one load or store, and
+     * a word access to an odd address traps like a bus error.  Unmapped
+     * RAM is reached directly.  With memory management on, every 64-byte
+     * block of virtual space that has been used caches the host address of
+     * its physical block, per mode and for reads and writes separately, so
+     * most accesses are still one lookup.  Everything else is relocated
+     * out of line.
+     */
+    unsigned char LoadByte(unsigned short address)
+    {
+      if (address < directLimit)
+      {
+        return Bytes()[address ^ BYTE_SWIZZLE];
+      }
+
+      unsigned short *block = readMap[address >> TLB_SHIFT];
+
+      if (block)
+      {
+        return reinterpret_cast<unsigned char *>(block)[(address & ((1U << TLB_SHIFT) - 1)) ^ BYTE_SWIZZLE];
+      }
+
+      unsigned short word = LoadMapped(address & ~01);
+      return (address & 01) ? word >> 8 : word & 0xFF;
+    };
+
+    void StoreByte(unsigned short address, unsigned char data)
+    {
+      if (address < directLimit)
+      {
+        Bytes()[address ^ BYTE_SWIZZLE] = data;
+        dirtyMap[address >> DIRTY_PAGE_SHIFT] = 1;
+        return;
+      }
+
+      unsigned short *block = writeMap[address >> TLB_SHIFT];
+
+      if (block)
+      {
+        reinterpret_cast<unsigned char *>(block)[(address & ((1U << TLB_SHIFT) - 1)) ^ BYTE_SWIZZLE] = data;
+        return;
+      }
+
+      StoreMapped(address, data, byteWidth);
+    };
+
+    unsigned short LoadWord(unsigned short address)
+    {
+      if ((address & 01) == 0 && address < directLimit)
+      {
+        return RAM[address >> 1];
+      }
+
+      if (address & 01)
+      {
+        OddAddress(address);
+      }
+
+      unsigned short *block = readMap[address >> TLB_SHIFT];
+
+      if (block)
+      {
+        return block[(address >> 1) & (TLB_WORDS - 1)];
+      }
+
+      return LoadMapped(address);
+    };
+
+    void StoreWord(unsigned short address, unsigned short data)
+    {
+      if ((address & 01) == 0 && address < directLimit)
+      {
+        RAM[address >> 1] = data;
+        dirtyMap[address >> DIRTY_PAGE_SHIFT] = 1;
+        return;
+      }
+
+      if (address & 01)
+      {
+        OddAddress(address);
+      }
+
+      unsigned short *block = writeMap[address >> TLB_SHIFT];
+
+      if (block)
+      {
+        block[(address >> 1) & (TLB_WORDS - 1)] = data;
+        return;
+      }
+
+      StoreMapped(address, data, wordWidth);
+    };
+
     int debugLevel;
+    bool traceEnabled;
     int regArray[8];
-    unsigned char *initialRAM;
-    unsigned char *RAM;
+    unsigned short *initialRAM;
+    unsigned short *RAM;        // Physical memory below the I/O page, in host byte order
     unsigned short initialPC;
-    std::ofstream *traceFile;
+    unsigned short *registers;  // The CPU's register file, R0-R7 then PS
+    unsigned short initialRegisters[9];
+    unsigned short initialStackPointers[2];
+    unsigned long long initialInstructions;     // Counts a snapshot was taken at
+    unsigned long long initialCycles;
+    unsigned char *codeMap;     // One bit per word holding cached code
+    unsigned char *dirtyMap;    // Set for each RAM page stored to since the last reset
+    CodeObserver *codeObserver;
+    ConditionCodeSource *conditionCodes;
+    Device **devices;           // Device answering for each page of the I/O page
+    RegisterFile registerFile;
+    KT11 mmu;
+    KT11 initialMMU;            // Register values reset goes back to
+    unsigned short directLimit;
+    int mode;                   // 0 kernel or 1 user, from PS bit 15
+    unsigned short stackPointers[2];    // SP of the mode not running
+    unsigned short **tlb;       // [mode][read, write][block], NULL until used
+    unsigned short **readMap;   // The current mode's part of tlb
+    unsigned short **writeMap;
+    std::vector<Watchpoint> watchpoints;
+    unsigned char *watchMap;    // One bit per page holding any watchpoint
+    bool watchTriggered;
+    WatchHit watchHit;
+    TraceWriter *traceWriter;
+    unsigned char *traceBuffer;         // The ring segment being filled
+    unsigned int traceUsed;
+    bool traceStarted;                  // The writer knows the record format
+    bool traceClosed;
+    bool traceIndexed;
+    unsigned int traceInstructions;     // Instruction records so far
 };
 #endif // MEMORY_H
@@ -1,5 +1,6 @@
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <QtQml>
 #include "programViewModel.h"
 
@@ -8,16 +9,14 @@ programViewModel::programViewModel(QObject *parent) :
   QObject(parent)
 {
   this->breakPoints = new std::vector<unsigned short>();
-  this->currentInstruction = -1;
   this->status = -1;
 }
 
-programViewModel::programViewModel(CPU *cpu, Memory *memory, memoryViewModel *memoryVM, QQuickView *view, std::vector<std::string> *source, QObject *parent) :
+programViewModel::programViewModel(CPU *cpu, Memory *memory, memoryViewModel *memoryVM, QQuickView *view, const std::string &sourcePath, QObject *parent) :
   QObject(parent)
 {
   this->breakPoints = new std::vector<unsigned short>();
   this->cpu = cpu;
-  this->currentInstruction = -1;
   this->memory = memory;
   this->memoryVM = memoryVM;
   this->status = -1;
@@ -46,9 +45,12 @@ programViewModel::programViewModel(CPU *cpu, Memory *memory, memoryViewModel *me
   else
   {
     // Implement file not found, access denied, and !success eventually
-    for (std::vector<std::string>::iterator it = source->begin(); it != source->end(); ++it)
+    std::ifstream sourceFile(sourcePath.c_str());
+    std::string line;
+
+    while (std::getline(sourceFile, line))
     {
-      instructionModel.append(it->c_str());
+      instructionModel.append(line.c_str());
 
       // Save PC for each line to support line highlighting
       // .lst file will have line numbers
@@ -76,7 +78,7 @@ programViewModel::~programViewModel()
 
 // Program execution functions/*{{{*/
 
-// Continue until HALT or break point/*{{{*/
+// Continue until HALT, break point or watch point/*{{{*/
 void programViewModel::continueExecution()
 {
   std::cout << "Continue!" << std::endl;
@@ -88,39 +90,8 @@ void programViewModel::continueExecution()
     return;
   }
 
-  // Run until HALT or break point/*{{{*/
-  do
-  {
-    this->currentInstruction = this->memory->RetrievePC();
-    this->status = cpu->FDE();
-    this->memory->IncrementPC();
-    this->memoryVM->refreshFields();
-
-  } while (this->status > 0 && this->currentInstruction != this->nextBreak);/*}}}*/
-
-  // Report exit status/*{{{*/
-  if (this->currentInstruction % 2 != 0)
-  {
-    std::cout << "Warning: program counter is not an even number!" << std::endl;
-  }
-
-  if (status == 0)
-  {
-    std::cout << "PDP 11/20 received HALT instruction\n" << std::endl;
-
-    /* The HALT results in a process halt but can be resumed after the user
-     *  presses continue on the console.  In this case we are using the
-     *  enter key to denote the continue key on the console.
-     */
-    //std::cout << "Press Enter to continue\n" << std::endl;
-    //std::cin.get();
-    //status = 0;  // Reset status to allow process to continue.
-  }
-
-  else if (this->currentInstruction == this->nextBreak)
-  {
-    std::cout << "Break point encountered!\n" << std::endl;
-  }/*}}}*/
+  // Run until HALT, break point or watch point
+  this->reportStop(this->cpu->Run(UNLIMITED_BUDGET, stopOnBreakpoint | stopOnWatchpoint));
 }/*}}}*/
 
 // Run program command/*{{{*/
@@ -141,39 +112,8 @@ void programViewModel::run()
   this->memory->ResetPC();
   this->memory->ResetRAM();
 
-  // Run until HALT or break point/*{{{*/
-  do
-  {
-    this->currentInstruction = this->memory->RetrievePC();
-    this->status = cpu->FDE();
-    this->memory->IncrementPC();
-    this->memoryVM->refreshFields();
-
-  } while (this->status > 0 && this->currentInstruction != this->nextBreak);/*}}}*/
-
-  // Report exit status/*{{{*/
-  if (this->currentInstruction % 2 != 0)
-  {
-    std::cout << "Warning: program counter is not an even number!" << std::endl;
-  }
-
-  if (status == 0)
-  {
-    std::cout << "PDP 11/20 received HALT instruction\n" << std::endl;
-
-    /* The HALT results in a process halt but can be resumed after the user
-     *  presses continue on the console.  In this case we are using the
-     *  enter key to denote the continue key on the console.
-     */
-    //std::cout << "Press Enter to continue\n" << std::endl;
-    //std::cin.get();
-    //status = 0;  // Reset status to allow process to continue.
-  }
-
-  else if (this->currentInstruction == this->nextBreak)
-  {
-    std::cout << "Break point encountered!\n" << std::endl;
-  }/*}}}*/
+  // Run until HALT, break point or watch point
+  this->reportStop(this->cpu->Run(UNLIMITED_BUDGET, stopOnBreakpoint | stopOnWatchpoint));
 }/*}}}*/
 
 // Step in to a single instruction/*{{{*/
@@ -188,18 +128,37 @@ void programViewModel::step()
     return;
   }
 
-  this->currentInstruction = this->memory->RetrievePC();
-  this->status = cpu->FDE();
-  this->memory->IncrementPC();
+  this->reportStop(this->cpu->Run(1, 0));
+  return;
+}/*}}}*/
+
+// Stop simulation/*{{{*/
+void programViewModel::stop()
+{
+  std::cout << "Stop!" << std::endl;
+
+  // Reset status
+  std::cout << "Resetting state..." << std::endl;
+  this->cpu->ResetInstructionCount();
+  this->memory->WritePS(0);
+  this->memory->ResetPC();
+  this->memory->ResetRAM();
   this->memoryVM->refreshFields();
+  this->status = -1;
+}/*}}}*/
 
-  // Report exit status/*{{{*/
-  if (this->currentInstruction % 2 != 0)
+// Refresh the view and report why the CPU stopped/*{{{*/
+void programViewModel::reportStop(RunResult result)
+{
+  this->status = (result.reason == StopReason::Halt)? 0 : 1;
+  this->memoryVM->refreshFields();
+
+  if (this->memory->RetrievePC() % 2 != 0)
   {
     std::cout << "Warning: program counter is not an even number!" << std::endl;
   }
 
-  if (status == 0)
+  if (result.reason == StopReason::Halt)
   {
     std::cout << "PDP 11/20 received HALT instruction\n" << std::endl;
 
@@ -212,26 +171,26 @@ void programViewModel::step()
     //status = 0;  // Reset status to allow process to continue.
   }
 
-  else if (this->currentInstruction == this->nextBreak)
+  else if (result.reason == StopReason::Breakpoint)
   {
     std::cout << "Break point encountered!\n" << std::endl;
-  }/*}}}*/
-  return;
-}/*}}}*/
+  }
 
-// Stop simulation/*{{{*/
-void programViewModel::stop()
-{
-  std::cout << "Stop!" << std::endl;
+  else if (result.reason == StopReason::Watchpoint)
+  {
+    const WatchHit &hit = this->memory->LastWatchHit();
+    std::cout << "Watch point encountered at " << std::oct << hit.address;
 
-  // Reset status
-  std::cout << "Resetting state..." << std::endl;
-  this->cpu->ResetInstructionCount();
-  this->memory->WritePS(0);
-  this->memory->ResetPC();
-  this->memory->ResetRAM();
-  this->memoryVM->refreshFields();
-  this->status = -1;
+    if (hit.type == watchRead)
+    {
+      std::cout << ", read " << hit.oldValue << "\n" << std::endl;
+    }
+
+    else
+    {
+      std::cout << ", " << hit.oldValue << " -> " << hit.newValue << "\n" << std::endl;
+    }
+  }
 }/*}}}*/
 /*}}}*/
 
@@ -246,4 +205,47 @@ void programViewModel::clearBreak()
 
 void programViewModel::clearAllBreaks()
 {
+  this->cpu->ClearAllBreakpoints();
+}/*}}}*/
+
+// Watch point functions/*{{{*/
+
+// Watch the octal addresses first through last, types is a mask of WatchType
+void programViewModel::setWatch(QString first, QString last, int types)
+{
+  this->memory->SetWatchpoint(this->parseAddress(first), this->parseAddress(last), types);
+}
+
+void programViewModel::clearWatch(QString first, QString last)
+{
+  this->memory->ClearWatchpoint(this->parseAddress(first), this->parseAddress(last));
+}
+
+void programViewModel::clearAllWatches()
+{
+  this->memory->ClearAllWatchpoints();
+}
+
+// Saves the machine as it stands, to start a later run from
+void programViewModel::saveSnapshot(QString path)
+{
+  this->cpu->SaveSnapshot(path.toStdString());
+}
+
+// Makes the snapshot what stop and run reset to, and resets to it now
+void programViewModel::setResetSnapshot(QString path)
+{
+  if (this->memory->LoadSnapshot(path.toStdString()))
+  {
+    this->stop();
+  }
+}
+
+unsigned short programViewModel::parseAddress(QString address)
+{
+  std::stringstream stream;
+  unsigned short value = 0;
+  stream << address.toStdString();
+  stream >> std::oct >> value;
+  return value;
 }/*}}}*/
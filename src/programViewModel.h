@@ -16,7 +16,7 @@ class programViewModel : public QObject
     // Define any Q_PROPERTY values here for proper UI binding if I have time
 
     explicit programViewModel(QObject *parent = 0);
-    explicit programViewModel(CPU *cpu, Memory *memory, memoryViewModel *memoryVM, QQuickView *view, std::vector<std::string> *source, QObject *parent = 0);
+    explicit programViewModel(CPU *cpu, Memory *memory, memoryViewModel *memoryVM, QQuickView *view, const std::string &sourcePath, QObject *parent = 0);
     ~programViewModel();
 
 signals:
@@ -32,11 +32,19 @@ signals:
     void setBreak();
     void clearBreak();
     void clearAllBreaks();
+    void setWatch(QString first, QString last, int types);
+    void clearWatch(QString first, QString last);
+    void clearAllWatches();
+
+    // Snapshots
+    void saveSnapshot(QString path);
+    void setResetSnapshot(QString path);
 
   private:
+    void reportStop(RunResult result);
+    unsigned short parseAddress(QString address);
+
     std::vector<unsigned short> *breakPoints;
-    unsigned short currentInstruction;
-    unsigned short nextBreak;
     int status;
     CPU *cpu;
     Memory *memory;
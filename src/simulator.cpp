@@ -1,3 +1,4 @@
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
 #include <vector>
@@ -6,6 +7,7 @@
 #include <QQmlComponent>
 #include <QtQml>
 #include "qtquick2applicationviewer.h"
+#include "batchRunner.h"
 #include "cpu.h"
 #include "memoryViewModel.h"
 #include "programViewModel.h"
@@ -15,15 +17,26 @@
  *                            PDP 11/20 SIMULATOR
  *
  *****************************************************************************/
-// Architecture modules
-Memory *memory;
-CPU *cpu; 
-
-/*
- * Logistical data structures used by the simulator
- */
-std::vector<std::string> *source;
-std::fstream *macFile;
+void PrintUsage()
+{
+  std::cout << "Usage: simulator {OPTIONAL}<-V or -v> {OPTIONAL}<-g> {OPTIONAL}<-t or -j> {OPTIONAL}<-r> {OPTIONAL}<-n or -i> {OPTIONAL}<-d> {OPTIONAL}<-z> {OPTIONAL}<-s snapshot> {OPTIONAL}<-c count> {OPTIONAL}<-o trace name> {OPTIONAL}<-p threads> {REQUIRED}<program file or -b job list>" << std::endl;
+  std::cout << "  -t  run with the threaded-code engine instead of the FDE() loop" << std::endl;
+  std::cout << "  -j  translate hot code to host instructions under -n, a traced run stays interpreted" << std::endl;
+  std::cout << "  -r  hold execution to the speed of a real PDP 11/20, not with -t" << std::endl;
+  std::cout << "  -n  run without a trace, the engines then have no tracing code in them" << std::endl;
+  std::cout << "  -i  record the index of the instruction making each access in the trace" << std::endl;
+  std::cout << "  -d  drop trace records rather than wait when the trace writer falls behind" << std::endl;
+  std::cout << "  -z  write the trace compressed, as trace-0000.z, trace-0001.z and so on" << std::endl;
+  std::cout << "  -s  save a snapshot of the machine to this file when it halts" << std::endl;
+  std::cout << "  -c  save the snapshot after this many instructions instead, then run on, not with -t" << std::endl;
+  std::cout << "  -o  name the trace files after this instead of trace, for runs sharing a directory" << std::endl;
+  std::cout << "  -b  run every job in the list at once, see batchRunner.h, and print a summary, not with -g, -t, -r or snapshots" << std::endl;
+  std::cout << "  -p  worker threads for -b, default one per core" << std::endl;
+  std::cout << "The program is a .ascii or .PCascii image, a MACRO-11 .obj module, an absolute loader .lda tape" << std::endl;
+  std::cout << "  or a raw memory image (.bin, .raw, .img) copied in from address 0" << std::endl;
+  std::cout << "  or a snapshot saved by -s, which starts the machine exactly where it was saved" << std::endl;
+  std::cout << "trace.bin is a binary memory trace, trace2text.py prints either kind as text" << std::endl;
+}
 
 /******************************************************************************
  *
@@ -34,152 +47,346 @@ int main(int argc, char *argv[])
 {
   int sourceArg = -1;
   bool GUImode = false;
+  bool threaded = false;
+  bool translated = false;
+  bool paced = false;
+  bool indexed = false;
+  bool dropping = false;
+  bool compressed = false;
+  bool untraced = false;
+  std::string snapshotPath;
+  unsigned long long snapshotCount = 0;
+  std::string traceName = "trace";
+  std::string jobList;
+  unsigned int threads = 0;
   Verbosity verbosity = Verbosity::off;
-  macFile = new std::fstream();
 
 /******************************************************************************
  *                            PARSE COMMAND LINE ARGS
  *****************************************************************************/
   //Parse command line arguments/*{{{*/
-  if (argc > 4)
+  if (argc < 2)
   {
-    std::cout << "Usage: simulator {OPTIONAL}<-V or -v> {OPTIONAL}<-g> {REQUIRED}<ascii file>" << std::endl;
+    PrintUsage();
     return 0;
   }
 
-  // Support only one .ascii file
-  switch(argc)
+  for (int i = 1; i < argc; ++i)
   {
-    case 2:
+    if(static_cast<std::string>(argv[i]).compare("-v") == 0)
+    {
+      if (verbosity == Verbosity::off)
       {
-        if (static_cast<std::string>(argv[1]).find(".ascii") != std::string::npos)
-        {
-          sourceArg = 1;
-          break;
-        }
+        verbosity = Verbosity::minimal;
+      }
 
-        else if (static_cast<std::string>(argv[1]).find(".PCascii") != std::string::npos)
-        {
-          sourceArg = 1;
-          break;
-        }
+      else
+      {
+        std::cout << "Conflicting verbosity arguments!" << std::endl;
+        PrintUsage();
+        return 0;
       }
+    }
 
-    case 3: case 4:
+    else if(static_cast<std::string>(argv[i]).compare("-V") == 0)
+    {
+      if (verbosity == Verbosity::off)
       {
-        for (int i = 1; i < argc; ++i)
-        {
-          if(static_cast<std::string>(argv[i]).compare("-v") == 0)
-          {
-            if (verbosity == Verbosity::off)
-            {
-              verbosity = Verbosity::minimal;
-            }
-
-            else
-            {
-              std::cout << "Conflicting verbosity arguments!" << std::endl;
-              std::cout << "Usage: simulator {OPTIONAL}<-V or -v> {OPTIONAL}<-g> {REQUIRED}<ascii file>" << std::endl;
-              return 0;
-            }
-          }
-
-          else if(static_cast<std::string>(argv[i]).compare("-V") == 0)
-          {
-            if (verbosity == Verbosity::off)
-            {
-              verbosity = Verbosity::verbose;
-            }
-
-            else
-            {
-              std::cout << "Conflicting verbosity arguments!" << std::endl;
-              std::cout << "Usage: simulator {OPTIONAL}<-V or -v> {OPTIONAL}<-g> {REQUIRED}<ascii file>" << std::endl;
-              return 0;
-            }
-          }
-
-          else if(static_cast<std::string>(argv[i]).compare("-g") == 0)
-          {
-            if (!GUImode)
-            {
-              GUImode = true;
-            }
-
-            else
-            {
-              std::cout << "Conflicting GUI arguments!" << std::endl;
-              std::cout << "Usage: simulator {OPTIONAL}<-V or -v> {OPTIONAL}<-g> {REQUIRED}<ascii file>" << std::endl;
-              return 0;
-            }
-          }
-
-          else if (static_cast<std::string>(argv[i]).find(".ascii") != std::string::npos)
-          {
-            sourceArg = i;
-          }
-
-          else if (static_cast<std::string>(argv[i]).find(".PCascii") != std::string::npos)
-          {
-            sourceArg = i;
-          }
-
-          else
-          {
-            std::cout << "Usage: simulator {OPTIONAL}<-V or -v> {OPTIONAL}<-g> {REQUIRED}<ascii file>" << std::endl;
-            return 0;
-          }
-        }
+        verbosity = Verbosity::verbose;
+      }
 
-        break;
+      else
+      {
+        std::cout << "Conflicting verbosity arguments!" << std::endl;
+        PrintUsage();
+        return 0;
+      }
+    }
 
-        default:
-        {
-          std::cout << "Usage: simulator {OPTIONAL}<-V or -v> {OPTIONAL}<-g> {REQUIRED}<ascii file>" << std::endl;
-          return 0;
-        }
+    else if(static_cast<std::string>(argv[i]).compare("-g") == 0)
+    {
+      if (!GUImode)
+      {
+        GUImode = true;
+      }
+
+      else
+      {
+        std::cout << "Conflicting GUI arguments!" << std::endl;
+        PrintUsage();
+        return 0;
+      }
+    }
+
+    else if(static_cast<std::string>(argv[i]).compare("-t") == 0)
+    {
+      if (!threaded && !translated)
+      {
+        threaded = true;
+      }
+
+      else
+      {
+        std::cout << "Conflicting engine arguments!" << std::endl;
+        PrintUsage();
+        return 0;
+      }
+    }
+
+    else if(static_cast<std::string>(argv[i]).compare("-j") == 0)
+    {
+      if (!threaded && !translated)
+      {
+        translated = true;
+      }
+
+      else
+      {
+        std::cout << "Conflicting engine arguments!" << std::endl;
+        PrintUsage();
+        return 0;
+      }
+    }
+
+    else if(static_cast<std::string>(argv[i]).compare("-r") == 0)
+    {
+      if (!paced)
+      {
+        paced = true;
+      }
+
+      else
+      {
+        std::cout << "Conflicting pacing arguments!" << std::endl;
+        PrintUsage();
+        return 0;
+      }
+    }
+
+    else if(static_cast<std::string>(argv[i]).compare("-n") == 0)
+    {
+      if (!untraced && !indexed)
+      {
+        untraced = true;
+      }
+
+      else
+      {
+        std::cout << "Conflicting trace arguments!" << std::endl;
+        PrintUsage();
+        return 0;
+      }
+    }
+
+    else if(static_cast<std::string>(argv[i]).compare("-i") == 0)
+    {
+      if (!indexed && !untraced)
+      {
+        indexed = true;
+      }
+
+      else
+      {
+        std::cout << "Conflicting trace arguments!" << std::endl;
+        PrintUsage();
+        return 0;
+      }
+    }
+
+    else if(static_cast<std::string>(argv[i]).compare("-d") == 0)
+    {
+      if (!dropping)
+      {
+        dropping = true;
+      }
+
+      else
+      {
+        std::cout << "Conflicting trace arguments!" << std::endl;
+        PrintUsage();
+        return 0;
+      }
+    }
+
+    else if(static_cast<std::string>(argv[i]).compare("-z") == 0)
+    {
+      if (!compressed)
+      {
+        compressed = true;
+      }
+
+      else
+      {
+        std::cout << "Conflicting trace arguments!" << std::endl;
+        PrintUsage();
+        return 0;
+      }
+    }
+
+    else if(static_cast<std::string>(argv[i]).compare("-s") == 0 && i + 1 < argc)
+    {
+      if (snapshotPath.empty())
+      {
+        snapshotPath = argv[++i];
+      }
+
+      else
+      {
+        std::cout << "Conflicting snapshot arguments!" << std::endl;
+        PrintUsage();
+        return 0;
+      }
+    }
+
+    else if(static_cast<std::string>(argv[i]).compare("-c") == 0 && i + 1 < argc)
+    {
+      char *end = NULL;
+      snapshotCount = std::strtoull(argv[++i], &end, 10);
+
+      if (*end != '\0' || snapshotCount == 0)
+      {
+        std::cout << "The snapshot count must be a number of instructions!" << std::endl;
+        PrintUsage();
+        return 0;
+      }
+    }
+
+    else if(static_cast<std::string>(argv[i]).compare("-o") == 0 && i + 1 < argc)
+    {
+      traceName = argv[++i];
+    }
+
+    else if(static_cast<std::string>(argv[i]).compare("-b") == 0 && i + 1 < argc)
+    {
+      if (jobList.empty())
+      {
+        jobList = argv[++i];
+      }
+
+      else
+      {
+        std::cout << "Conflicting batch arguments!" << std::endl;
+        PrintUsage();
+        return 0;
+      }
+    }
+
+    else if(static_cast<std::string>(argv[i]).compare("-p") == 0 && i + 1 < argc)
+    {
+      threads = std::atoi(argv[++i]);
+
+      if (threads == 0)
+      {
+        std::cout << "The thread count must be a positive number!" << std::endl;
+        PrintUsage();
+        return 0;
       }
+    }
+
+    // Its format is worked out from its extension or its first bytes
+    else if (argv[i][0] != '-' && sourceArg < 0)
+    {
+      sourceArg = i;
+    }
+
+    else
+    {
+      PrintUsage();
+      return 0;
+    }
+  }
+
+  // The threaded engine never checks the clock
+  if (threaded && paced)
+  {
+    std::cout << "Conflicting engine arguments!" << std::endl;
+    PrintUsage();
+    return 0;
+  }
+
+  // Nor does it stop part way, and a count needs somewhere to save to
+  if (snapshotCount > 0 && (threaded || snapshotPath.empty()))
+  {
+    std::cout << "Conflicting snapshot arguments!" << std::endl;
+    PrintUsage();
+    return 0;
+  }
+
+  // A batch runs each job flat out with the batch engine and its own budget, and has no one program
+  if (!jobList.empty() && (GUImode || threaded || paced || snapshotCount > 0 || !snapshotPath.empty() || sourceArg >= 0))
+  {
+    std::cout << "Conflicting batch arguments!" << std::endl;
+    PrintUsage();
+    return 0;
   }
   /*}}}*/
 
 /******************************************************************************
- *                            PARSE ASCII FILE
+ *                            BATCH EXECUTION BLOCK
  *****************************************************************************/
-  // Parse in .ascii file and retrieve instructions until EOF/*{{{*/
-  try
+  // Every job gets its own memory, CPU and trace files/*{{{*/
+  if (!jobList.empty())
   {
-    macFile->open(argv[sourceArg]);
-    source = new std::vector<std::string>;
-    std::string buffer;
+    BatchRunner batch;
+
+    if (!batch.ReadJobs(jobList))
+    {
+      std::cout << "Problem with the job list: " << batch.Error() << ", exiting..." << std::endl;
+      return 0;
+    }
 
-    // Read in a line and store it in to our instruction source vector
-    while (!macFile->eof())
+    if (threads > 0)
     {
-      std::getline(*macFile, buffer);
-      source->push_back(buffer.c_str());
+      batch.SetThreads(threads);
     }
 
-    // File IO is finished, so close the file
-    macFile->close();
+    batch.SetTranslated(translated);
+    batch.SetTrace(!untraced, indexed, compressed, dropping ? traceDrop : traceBlock, traceName);
+    batch.Run();
+    batch.PrintSummary();
+    return 0;
   }
+  /*}}}*/
 
-  catch (const std::ios_base::failure &e)
+/******************************************************************************
+ *                            LOAD PROGRAM FILE
+ *****************************************************************************/
+  // Map the program file and load it straight into memory/*{{{*/
+  if (sourceArg < 0)
   {
-    // Implement file not found, access denied, and !success eventually
+    PrintUsage();
+    return 0;
+  }
+
+  Memory *memory = new Memory();
 
-    // Ghetto file not found version
-    std::cout << "Error parsing Macro11 assembler source file!" << std::endl;
+  if (!memory->LoadImage(argv[sourceArg]))
+  {
+    delete memory;
     return 0;
   }
-  // Remove the last item in the vector that contains only a '\n' character
-  source->pop_back();
   /*}}}*/
 
   // Simulator declarations/*{{{*/
-  memory = new Memory(source);
   memory->SetDebugMode(verbosity);
-  cpu = new CPU(memory);
-  cpu->SetDebugMode(verbosity);/*}}}*/
+  memory->SetTraceIndexed(indexed);
+  memory->SetTraceRing(TRACE_RING_BYTES, dropping ? traceDrop : traceBlock);
+  memory->SetTraceCompressed(compressed);
+  memory->SetTraceName(traceName);
+  CPU *cpu = new CPU(memory);
+  cpu->SetDebugMode(verbosity);
+  cpu->SetPacing(paced);
+
+  if (untraced)
+  {
+    memory->SetTraceEnabled(false);
+  }
+
+  // Translated blocks cannot produce a trace, so Run() only enters them untraced
+  if (translated && !GUImode)
+  {
+    cpu->EnableTranslation();
+  }/*}}}*/
 
 /******************************************************************************
  *                            GUI EXECUTION BLOCK
@@ -194,7 +401,7 @@ int main(int argc, char *argv[])
 
     // Declare the UI ViewModels
     memoryViewModel *memoryVM = new memoryViewModel(memory, view);
-    programViewModel *programVM = new programViewModel(cpu, memory, memoryVM, view, source);
+    programViewModel *programVM = new programViewModel(cpu, memory, memoryVM, view, argv[sourceArg]);
 
     // Register the ViewModels for use in the QML file
     qmlRegisterType<programViewModel>("ProgramViewModel", 1, 0, "programViewModel");
@@ -210,7 +417,11 @@ int main(int argc, char *argv[])
     // Load the GUI
     view->setSource(QUrl::fromLocalFile("simulator.qml"));
     view->show();
-    return app.exec();
+    int status = app.exec();
+
+    // The trace writer thread has to finish before the process exits
+    memory->CloseTrace();
+    return status;
 
     // Garbage collection/*{{{*/
     delete programVM;
@@ -232,31 +443,83 @@ int main(int argc, char *argv[])
      * RUN THIS ONLY IF IN CONSOLE MODE
      */
 
-    // Loop the CPU which will handle state changes internally.
-    // Need to make sure program halting is handled in CPU.
-    int status = 0;
-    do
+    // The threaded engine runs to completion without returning here
+    if (threaded)
     {
-      status = cpu->FDE();
+      if (cpu->RunThreaded() == 0)
+      {
+        std::cout << "PDP 11/20 received HALT instruction\n" << std::endl;
+      }
 
-      if (memory->RetrievePC() % 2 != 0)
+      if (!snapshotPath.empty())
       {
-        std::cout << "Warning: program counter is not an even number!" << std::endl;
+        cpu->SaveSnapshot(snapshotPath);
       }
+    }
+
+    else
+    {
+      // Run the CPU until HALT, stopping only to report an odd PC and to save the snapshot
+      RunResult result;
+      bool saving = !snapshotPath.empty();
+      unsigned long long budget = snapshotCount > 0 ? snapshotCount : UNLIMITED_BUDGET;
 
-      if (status == 0)
+      do
       {
-        std::cout << "PDP 11/20 received HALT instruction\n" << std::endl;
+        result = cpu->Run(budget, stopOnOddPC);
+
+        if (budget != UNLIMITED_BUDGET)
+        {
+          budget -= result.executed;
+        }
+
+        // Whichever comes first of the count and the HALT
+        if (saving && (budget == 0 || result.reason == StopReason::Halt))
+        {
+          cpu->SaveSnapshot(snapshotPath);
+          saving = false;
+          budget = UNLIMITED_BUDGET;
+        }
+
+        if (memory->RetrievePC() % 2 != 0)
+        {
+          std::cout << "Warning: program counter is not an even number!" << std::endl;
+        }
 
-        /* The HALT results in a process halt but can be resumed after the user
-         *  presses continue on the console.  In this case we are using the
-         *  enter key to denote the continue key on the console.
-         */
-        //std::cout << "Press Enter to continue\n" << std::endl;
-        //std::cin.get();
-        //status = 0;  // Reset status to allow process to continue.
+        if (result.reason == StopReason::Halt)
+        {
+          std::cout << "PDP 11/20 received HALT instruction\n" << std::endl;
+
+          /* The HALT results in a process halt but can be resumed after the user
+           *  presses continue on the console.  In this case we are using the
+           *  enter key to denote the continue key on the console.
+           */
+          //std::cout << "Press Enter to continue\n" << std::endl;
+          //std::cin.get();
+        }
+      } while (result.reason != StopReason::Halt);
+    }
+
+    // Execution statistics
+    if (verbosity != Verbosity::off)
+    {
+      std::cout << "Instructions executed: " << std::dec << cpu->InstructionCount() << std::endl;
+      std::cout << "Estimated 11/20 cycles: " << cpu->Cycles() << " (" << cpu->Cycles() * CYCLE_NS / 1000 << " us)" << std::endl;
+      std::cout << "Decode cache hits: " << cpu->DecodeCacheHits() << std::endl;
+      std::cout << "Decode cache misses: " << cpu->DecodeCacheMisses() << std::endl;
+
+      if (memory->TraceEnabled())
+      {
+        std::cout << "Trace ring waits: " << memory->TraceWaits() << std::endl;
+        std::cout << "Trace records dropped: " << memory->TraceDropped() << std::endl;
       }
-    } while (status > 0);
+
+      if (translated)
+      {
+        std::cout << "Translated blocks: " << cpu->TranslatedBlocks() << std::endl;
+        std::cout << "Translated instructions: " << cpu->TranslatedInstructions() << std::endl;
+      }
+    }
   }/*}}}*/
 
 /******************************************************************************
@@ -264,8 +527,6 @@ int main(int argc, char *argv[])
  *****************************************************************************/
   // Garbage collection/*{{{*/
   delete cpu;
-  delete macFile;
-  delete source;
   /*}}}*/
 
   return 0;
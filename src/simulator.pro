@@ -2,19 +2,30 @@
 QML_IMPORT_PATH =
 
 QMAKE_CXXFLAGS += -g -std=gnu++11 -Wall -Wpedantic
+CONFIG += thread
+LIBS += -lz
 OTHER_FILES += simulator.qml
 
 # The .cpp file which was generated for your project. Feel free to hack it.
 # Input
-HEADERS += cpu.h \
+HEADERS += batchRunner.h \
+    cpu.h \
+    imageLoader.h \
     memory.h \
     memoryViewModel.h \
-    programViewModel.h
-SOURCES += cpu.cpp \
+    programViewModel.h \
+    snapshot.h \
+    traceWriter.h \
+    translator.h
+SOURCES += batchRunner.cpp \
+    cpu.cpp \
+    imageLoader.cpp \
     memory.cpp \
     simulator.cpp \
     memoryViewModel.cpp \
-    programViewModel.cpp
+    programViewModel.cpp \
+    traceWriter.cpp \
+    translator.cpp
 
 # Installation path
 # target.path =
@@ -0,0 +1,34 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+/*
+ * A snapshot file holds the whole machine: one SNAPSHOT_PAGE of header,
+ * zero filled past the SnapshotHeader, then all of RAM.  Everything is in
+ * the byte order of the host that wrote it, which the flags record, so
+ * the file maps in one piece and RAM copies straight out of the mapping.
+ */
+#define SNAPSHOT_MAGIC "P11SN"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_BIG_ENDIAN 01
+#define SNAPSHOT_PAGE 4096
+
+struct SnapshotHeader
+{
+  char magic[6];
+  unsigned char version;
+  unsigned char flags;
+  unsigned int ramOffset;               // SNAPSHOT_PAGE
+  unsigned int ramBytes;
+  unsigned int reserved;
+  unsigned long long instructions;      // CPU::InstructionCount() when taken
+  unsigned long long cycles;
+  unsigned short registers[9];          // R0-R7 then PS
+  unsigned short stackPointers[2];      // SP of the mode not running
+  unsigned short par[2][8];             // KT11, kernel then user
+  unsigned short pdr[2][8];
+  unsigned short sr0;
+  unsigned short sr2;
+};
+
+static_assert(sizeof(SnapshotHeader) <= SNAPSHOT_PAGE, "the snapshot header must fit its page");
+#endif // SNAPSHOT_H
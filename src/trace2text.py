@@ -0,0 +1,159 @@
+#!/usr/bin/env python
+
+#   trace2text.py
+#     converts a binary trace written by the simulator into the text trace format, one "<type> <address>" line
+#     per access with the type 0 for a read, 1 for a write and 2 for an instruction fetch and the address as 6 octal digits
+#
+#   The input is either trace.bin or the first file of a compressed trace, trace-0000.z, in which case it and every
+#     following trace-0001.z, trace-0002.z and so on are read back in order.  Compressed files decode on their own, so
+#     they are decompressed in parallel while the records stream out.
+#
+#   Traces recorded with -i carry the index of the instruction making each access; pass -i here as well to print it
+#     as a third column, otherwise it is dropped and the output matches the old trace.txt exactly.
+#
+#   See traceWriter.h for both layouts.
+
+
+import multiprocessing
+import os
+import re
+import struct
+import sys
+import zlib
+
+CHUNK = 1 << 20     # Bytes of trace.bin read at a time
+
+
+class TraceError(Exception):
+    pass
+
+
+# Yields (type, address, index) for every record of trace.bin, index is None unless it was recorded
+def readPlain(path):
+    inFile = open(path, 'rb')
+    header = bytearray(inFile.read(8))
+    if (len(header) < 8 or bytes(header[0:5]) != b"P11TR" or header[6] != 1):
+        raise TraceError(path + " is not a version 1 simulator trace")
+    if header[7] & 1:
+        record = struct.Struct("<BHI")
+    else:
+        record = struct.Struct("<BH")
+    left = b""
+    while True:
+        data = inFile.read(CHUNK)
+        if not data:
+            break
+        data = left + data
+        end = len(data) - len(data) % record.size
+        for offset in range(0, end, record.size):
+            fields = record.unpack_from(data, offset)
+            yield (fields[0], fields[1], fields[2] if record.size > 3 else None)
+        left = data[end:]
+    inFile.close()
+
+
+# Decodes one compressed file into a list of (type, address, index), see traceWriter.h
+def decodeFile(path):
+    inFile = open(path, 'rb')
+    data = inFile.read()
+    inFile.close()
+    header = bytearray(data[0:8])
+    if (len(header) < 8 or bytes(header[0:5]) != b"P11TZ" or header[6] != 1):
+        raise TraceError(path + " is not a version 1 compressed simulator trace")
+    indexed = header[7] & 1
+    count, index, length = struct.unpack_from("<III", data, 8)
+    encoded = bytearray(zlib.decompress(data[20:]))
+    if (len(encoded) != length):
+        raise TraceError(path + " is truncated")
+    records = []
+    lastFetch = 0
+    lastData = 0
+    i = 0
+    while i < len(encoded):
+        tag = encoded[i]
+        kind = tag >> 6
+        value = tag & 0x3F
+        i += 1
+        if kind == 3:
+            if value == 0:
+                index = encoded[i] | (encoded[i + 1] << 8) | (encoded[i + 2] << 16) | (encoded[i + 3] << 24)
+                i += 4
+                continue
+            for n in range(value):
+                lastFetch = (lastFetch + 2) & 0xFFFF
+                index = (index + 1) & 0xFFFFFFFF
+                records.append((2, lastFetch, index if indexed else None))
+            continue
+        if value == 0x3F:
+            address = encoded[i] | (encoded[i + 1] << 8)
+            i += 2
+        else:
+            delta = (value >> 1) ^ -(value & 1)
+            address = ((lastFetch if kind == 2 else lastData) + delta) & 0xFFFF
+        if kind == 2:
+            lastFetch = address
+            index = (index + 1) & 0xFFFFFFFF
+        else:
+            lastData = address
+        records.append((kind, address, index if indexed else None))
+    if (len(records) != count):
+        raise TraceError(path + " decodes to the wrong number of records")
+    return records
+
+
+# Yields the records of a compressed trace starting at path, in order
+def readCompressed(path):
+    match = re.match(r"(.*)-(\d+)\.z$", path)
+    if not match:
+        raise TraceError(path + " is not named like trace-0000.z")
+    paths = []
+    number = int(match.group(2))
+    while os.path.exists("%s-%04d.z" % (match.group(1), number)):
+        paths.append("%s-%04d.z" % (match.group(1), number))
+        number += 1
+    pool = multiprocessing.Pool()
+    for records in pool.imap(decodeFile, paths):
+        for record in records:
+            yield record
+    pool.close()
+
+
+def main():
+    if (len(sys.argv) < 3 or (len(sys.argv) == 4 and sys.argv[1] != "-i") or len(sys.argv) > 4):
+        sys.stderr.write("Usage:  trace2text.py  {OPTIONAL}<-i>  <input trace.bin or trace-0000.z>  <output trace.txt>\n\n")
+        exit(-1)
+
+    showIndex = (len(sys.argv) == 4)
+
+    try:
+        if sys.argv[-2].endswith(".z"):
+            records = readCompressed(sys.argv[-2])
+        else:
+            records = readPlain(sys.argv[-2])
+        outFile = open(sys.argv[-1], 'w')
+
+        # Convert in large batches, one formatted line per record
+        lines = []
+        for record in records:
+            if showIndex:
+                if record[2] is None:
+                    raise TraceError("the trace was recorded without instruction indexes")
+                lines.append("%o %06o %d\n" % record)
+            else:
+                lines.append("%o %06o\n" % record[0:2])
+            if (len(lines) >= 65536):
+                outFile.write("".join(lines))
+                lines = []
+
+        outFile.write("".join(lines))
+        outFile.close()
+    except (IOError, OSError) as error:
+        sys.stderr.write("Problem with the trace files: " + str(error) + ", exiting...\n")
+        exit(-2)
+    except (TraceError, zlib.error) as error:
+        sys.stderr.write("Error: " + str(error) + ", exiting...\n")
+        exit(-3)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,309 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <zlib.h>
+#include "traceReader.h"
+#include "traceWriter.h"
+
+// Bytes read from a text or plain trace at a time
+#define CHUNK (1U << 20)
+
+// Transaction::instruction in memory.h
+#define FETCH 2
+
+TraceReader::TraceReader()/*{{{*/
+{
+  this->format = text;
+  this->used = 0;
+  this->recordBytes = 3;
+  this->number = 0;
+  this->position = 0;
+  this->lastFetch = 0;
+  this->lastData = 0;
+  this->pendingRun = 0;
+}
+/*}}}*/
+
+// Works out the format from the file's first bytes, false with Error() set if it cannot be read
+bool TraceReader::Open(const std::string &path)/*{{{*/
+{
+  this->file.open(path.c_str(), std::ios::in | std::ios::binary);
+
+  if (!this->file)
+  {
+    this->error = "cannot open " + path;
+    return false;
+  }
+
+  char header[TRACE_HEADER_BYTES] = { 0 };
+  this->file.read(header, TRACE_HEADER_BYTES);
+  unsigned int length = this->file.gcount();
+
+  if (length == TRACE_HEADER_BYTES && std::memcmp(header, TRACE_MAGIC, 5) == 0)
+  {
+    if (header[6] != TRACE_VERSION)
+    {
+      this->error = path + " is from another version of the simulator";
+      return false;
+    }
+
+    this->format = plain;
+    this->recordBytes = (header[7] & TRACE_INDEXED) ? 7 : 3;
+    return true;
+  }
+
+  if (length == TRACE_HEADER_BYTES && std::memcmp(header, TRACE_FILE_MAGIC, 5) == 0)
+  {
+    std::string::size_type dash = path.rfind('-');
+
+    if (dash == std::string::npos || path.compare(path.size() - 2, 2, ".z") != 0)
+    {
+      this->error = path + " is not named like trace-0000.z";
+      return false;
+    }
+
+    this->format = compressed;
+    this->prefix = path.substr(0, dash);
+    this->number = std::atoi(path.substr(dash + 1).c_str());
+    this->file.close();
+
+    if (!this->LoadFile() && this->error.empty())
+    {
+      this->error = "cannot open " + path;
+    }
+
+    return this->error.empty();
+  }
+
+  // Anything else is taken to be text, the bytes already read are its start
+  this->format = text;
+  this->buffer.assign(header, header + length);
+  return true;
+}
+/*}}}*/
+
+// Fills accesses with up to count records, fewer only at the end of the trace
+unsigned int TraceReader::Read(TraceAccess *accesses, unsigned int count)/*{{{*/
+{
+  switch (this->format)
+  {
+    case plain:
+      return this->ReadPlain(accesses, count);
+
+    case compressed:
+      return this->ReadCompressed(accesses, count);
+
+    default:
+      return this->ReadText(accesses, count);
+  }
+}
+/*}}}*/
+
+// Text and trace.bin/*{{{*/
+
+unsigned int TraceReader::ReadText(TraceAccess *accesses, unsigned int count)
+{
+  unsigned int read = 0;
+
+  while (read < count)
+  {
+    // Only parse whole lines, the last one may still be coming
+    char *start = this->buffer.empty() ? NULL : &this->buffer[0];
+    char *end = start ? static_cast<char *>(std::memchr(start + this->used, '\n', this->buffer.size() - this->used)) : NULL;
+
+    if (end == NULL)
+    {
+      this->buffer.erase(this->buffer.begin(), this->buffer.begin() + this->used);
+      this->used = 0;
+      unsigned int kept = this->buffer.size();
+      this->buffer.resize(kept + CHUNK);
+      this->file.read(&this->buffer[kept], CHUNK);
+      this->buffer.resize(kept + this->file.gcount());
+
+      if (this->file.gcount() == 0)
+      {
+        // A last line without a newline still counts
+        if (kept > 0)
+        {
+          this->buffer.push_back('\n');
+          continue;
+        }
+
+        break;
+      }
+
+      continue;
+    }
+
+    char *line = start + this->used;
+    this->used = end + 1 - start;
+
+    // "<type> <address>", both octal
+    unsigned int type = 0;
+    unsigned int address = 0;
+    char *digit = line;
+
+    while (digit < end && *digit >= '0' && *digit <= '7')
+    {
+      type = type * 8 + (*digit++ - '0');
+    }
+
+    if (digit == line || digit == end || *digit != ' ')
+    {
+      continue;
+    }
+
+    while (++digit < end && *digit >= '0' && *digit <= '7')
+    {
+      address = address * 8 + (*digit - '0');
+    }
+
+    accesses[read].type = type;
+    accesses[read].address = address;
+    ++read;
+  }
+
+  return read;
+}
+
+unsigned int TraceReader::ReadPlain(TraceAccess *accesses, unsigned int count)
+{
+  unsigned int read = 0;
+
+  while (read < count)
+  {
+    if (this->buffer.size() - this->used < this->recordBytes)
+    {
+      this->buffer.erase(this->buffer.begin(), this->buffer.begin() + this->used);
+      this->used = 0;
+      unsigned int kept = this->buffer.size();
+      this->buffer.resize(kept + CHUNK);
+      this->file.read(&this->buffer[kept], CHUNK);
+      this->buffer.resize(kept + this->file.gcount());
+
+      if (this->buffer.size() < this->recordBytes)
+      {
+        break;
+      }
+    }
+
+    const unsigned char *record = reinterpret_cast<unsigned char *>(&this->buffer[this->used]);
+    accesses[read].type = record[0];
+    accesses[read].address = record[1] | (record[2] << 8);
+    this->used += this->recordBytes;
+    ++read;
+  }
+
+  return read;
+}
+/*}}}*/
+
+// Compressed traces/*{{{*/
+
+// Decompresses the next numbered file, false at the end of the trace or with Error() set
+bool TraceReader::LoadFile()
+{
+  char path[16];
+  std::snprintf(path, sizeof(path), "-%04u.z", this->number);
+  std::ifstream in((this->prefix + path).c_str(), std::ios::in | std::ios::binary);
+
+  if (!in)
+  {
+    return false;
+  }
+
+  std::vector<char> packed((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  const unsigned char *header = reinterpret_cast<unsigned char *>(packed.data());
+
+  if (packed.size() < TRACE_FILE_HEADER_BYTES || std::memcmp(header, TRACE_FILE_MAGIC, 5) != 0 ||
+      header[6] != TRACE_VERSION)
+  {
+    this->error = this->prefix + path + " is not a compressed trace from this version of the simulator";
+    return false;
+  }
+
+  uLongf length = header[16] | (header[17] << 8) | (header[18] << 16) | (static_cast<unsigned int>(header[19]) << 24);
+  this->encoded.resize(length);
+
+  if (length > 0 && uncompress(&this->encoded[0], &length, header + TRACE_FILE_HEADER_BYTES,
+                               packed.size() - TRACE_FILE_HEADER_BYTES) != Z_OK)
+  {
+    this->error = this->prefix + path + " is damaged";
+    this->encoded.clear();
+    return false;
+  }
+
+  // Every file starts the delta encoding afresh
+  ++this->number;
+  this->position = 0;
+  this->lastFetch = 0;
+  this->lastData = 0;
+  this->pendingRun = 0;
+  return true;
+}
+
+// Undoes TraceWriter::Encode(), see traceWriter.h for the encoding
+unsigned int TraceReader::ReadCompressed(TraceAccess *accesses, unsigned int count)
+{
+  unsigned int read = 0;
+
+  while (read < count)
+  {
+    if (this->pendingRun > 0)
+    {
+      this->lastFetch += 2;
+      accesses[read].type = FETCH;
+      accesses[read].address = this->lastFetch;
+      --this->pendingRun;
+      ++read;
+      continue;
+    }
+
+    if (this->position >= this->encoded.size())
+    {
+      if (!this->LoadFile())
+      {
+        break;
+      }
+
+      continue;
+    }
+
+    unsigned char tag = this->encoded[this->position++];
+    unsigned char type = tag >> 6;
+    unsigned char value = tag & 077;
+
+    if (type == 3)
+    {
+      // A value of 0 carries an instruction index, which is not returned
+      if (value == 0)
+      {
+        this->position += 4;
+      }
+
+      this->pendingRun = value;
+      continue;
+    }
+
+    unsigned short &last = type == FETCH ? this->lastFetch : this->lastData;
+
+    if (value == 077)
+    {
+      last = this->encoded[this->position] | (this->encoded[this->position + 1] << 8);
+      this->position += 2;
+    }
+
+    else
+    {
+      last += (value >> 1) ^ -(value & 1);
+    }
+
+    accesses[read].type = type;
+    accesses[read].address = last;
+    ++read;
+  }
+
+  return read;
+}
+/*}}}*/
@@ -0,0 +1,52 @@
+#ifndef TRACEREADER_H
+#define TRACEREADER_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+// One access from a trace, the type is a Transaction
+struct TraceAccess
+{
+  unsigned short address;
+  unsigned char type;
+};
+
+/*
+ * Reads back any trace the simulator writes: the "2 000010" text lines of
+ * the old trace.txt, trace.bin, or a compressed trace starting from its
+ * first file, trace-0000.z, and running through the ones numbered after
+ * it.  Records come out in order, a batch at a time, and instruction
+ * indexes are dropped.
+ */
+class TraceReader
+{
+  public:
+    TraceReader();
+    bool Open(const std::string &path);
+    unsigned int Read(TraceAccess *accesses, unsigned int count);
+    const std::string &Error() const { return error; };
+
+  private:
+    enum Format { text, plain, compressed };
+    unsigned int ReadText(TraceAccess *accesses, unsigned int count);
+    unsigned int ReadPlain(TraceAccess *accesses, unsigned int count);
+    unsigned int ReadCompressed(TraceAccess *accesses, unsigned int count);
+    bool LoadFile();
+    Format format;
+    std::ifstream file;
+    std::string error;
+    std::vector<char> buffer;   // Bytes read but not yet parsed
+    unsigned int used;
+    unsigned int recordBytes;
+
+    // Compressed traces, decoded a file at a time
+    std::string prefix;         // Path up to the file number
+    unsigned int number;
+    std::vector<unsigned char> encoded;
+    unsigned int position;
+    unsigned short lastFetch;
+    unsigned short lastData;
+    unsigned int pendingRun;    // Fetches of a run not yet returned
+};
+#endif // TRACEREADER_H
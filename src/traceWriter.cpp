@@ -0,0 +1,343 @@
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <zlib.h>
+#include "traceWriter.h"
+
+// How long the writer thread sleeps when the ring is empty
+#define IDLE_WAIT std::chrono::microseconds(200)
+
+// Transaction::instruction, memory.h cannot come in after zlib's unistd.h
+#define FETCH 2
+
+// Encoded record tags, the type is in the top two bits
+#define TAG_RUN 0300
+#define ESCAPE 077
+#define MAX_RUN 077
+#define LEVEL Z_BEST_SPEED      // Compression has to keep up with the CPU
+
+TraceWriter::TraceWriter(const char *name)/*{{{*/
+{
+  this->name = name;
+  this->compressed = false;
+  this->recordBytes = 3;
+  this->ring = NULL;
+  this->lengths = NULL;
+  this->produced = 0;
+  this->consumed = 0;
+  this->finished = false;
+  this->waits = 0;
+  this->droppedBytes = 0;
+  this->files = 0;
+  this->records = 0;
+  this->Configure(TRACE_RING_BYTES, traceBlock);
+}
+/*}}}*/
+
+TraceWriter::~TraceWriter()/*{{{*/
+{
+  this->Finish(0);
+  delete [] ring;
+  delete [] lengths;
+}
+/*}}}*/
+
+/*
+ * Sets the ring size, rounded up to a power of two number of segments, and
+ * what to do when it fills.  Anything in the current segment is lost, so
+ * this is only for before the first record is traced.
+ */
+void TraceWriter::Configure(unsigned int ringBytes, TraceFullPolicy policy)/*{{{*/
+{
+  unsigned int count = 2;
+
+  while (count * TRACE_SEGMENT_BYTES < ringBytes)
+  {
+    count <<= 1;
+  }
+
+  delete [] this->ring;
+  delete [] this->lengths;
+  this->ring = new unsigned char[count * TRACE_SEGMENT_BYTES];
+  this->lengths = new unsigned int[count];
+  this->segments = count;
+  this->policy = policy;
+}
+/*}}}*/
+
+/*
+ * Called with the record format before the first segment is submitted.  A
+ * plain trace goes to one file, which gets its header straight away.
+ */
+void TraceWriter::Begin(bool indexed)/*{{{*/
+{
+  this->recordBytes = indexed ? 7 : 3;
+  this->index = 0xFFFFFFFF;
+
+  if (this->compressed)
+  {
+    this->encoded.reserve(TRACE_FILE_BYTES);
+    return;
+  }
+
+  this->file.open((this->name + ".bin").c_str(), std::ios::out | std::ios::binary);
+
+  if (!this->file)
+  {
+    std::cout << "Error opening trace file for output mode!" << std::endl;
+  }
+
+  char header[TRACE_HEADER_BYTES] = TRACE_MAGIC;
+  header[6] = TRACE_VERSION;
+  header[7] = indexed ? TRACE_INDEXED : 0;
+  this->file.write(header, TRACE_HEADER_BYTES);
+}
+/*}}}*/
+
+/*
+ * Hands the current segment, length bytes of it filled, to the writer and
+ * returns the one to fill next.  The producer always owns the segment at
+ * produced, so with the ring full it either waits for the writer to free
+ * the following one or, when dropping, keeps refilling the same segment.
+ */
+unsigned char *TraceWriter::Submit(unsigned int length)/*{{{*/
+{
+  if (!this->writer.joinable())
+  {
+    this->writer = std::thread(&TraceWriter::Drain, this);
+  }
+
+  unsigned int next = this->produced.load(std::memory_order_relaxed) + 1;
+
+  if (next - this->consumed.load(std::memory_order_acquire) >= this->segments)
+  {
+    if (this->policy == traceDrop)
+    {
+      this->droppedBytes += length;
+      return this->Segment();
+    }
+
+    ++this->waits;
+
+    while (next - this->consumed.load(std::memory_order_acquire) >= this->segments)
+    {
+      std::this_thread::yield();
+    }
+  }
+
+  this->Publish(length);
+  return this->Segment();
+}
+/*}}}*/
+
+// Hands over the last segment and waits until everything is on disk
+void TraceWriter::Finish(unsigned int length)/*{{{*/
+{
+  if (this->finished)
+  {
+    return;
+  }
+
+  this->Publish(length);
+  this->finished.store(true, std::memory_order_release);
+
+  if (this->writer.joinable())
+  {
+    this->writer.join();
+  }
+
+  else
+  {
+    this->Drain();
+  }
+}
+/*}}}*/
+
+void TraceWriter::Publish(unsigned int length)/*{{{*/
+{
+  unsigned int slot = this->produced.load(std::memory_order_relaxed);
+  this->lengths[slot & (this->segments - 1)] = length;
+  this->produced.store(slot + 1, std::memory_order_release);
+}
+/*}}}*/
+
+// The writer thread, runs until Finish() and the ring is empty
+void TraceWriter::Drain()/*{{{*/
+{
+  for (;;)
+  {
+    unsigned int slot = this->consumed.load(std::memory_order_relaxed);
+
+    if (slot == this->produced.load(std::memory_order_acquire))
+    {
+      // Finish() publishes before it sets finished, so nothing is left behind
+      if (this->finished.load(std::memory_order_acquire) && slot == this->produced.load(std::memory_order_acquire))
+      {
+        break;
+      }
+
+      std::this_thread::sleep_for(IDLE_WAIT);
+      continue;
+    }
+
+    unsigned int index = slot & (this->segments - 1);
+    unsigned char *segment = this->ring + index * TRACE_SEGMENT_BYTES;
+
+    if (this->compressed)
+    {
+      this->Encode(segment, this->lengths[index]);
+    }
+
+    else
+    {
+      this->file.write(reinterpret_cast<char *>(segment), this->lengths[index]);
+    }
+
+    this->consumed.store(slot + 1, std::memory_order_release);
+  }
+
+  if (this->compressed && this->records > 0)
+  {
+    this->WriteFile();
+  }
+
+  this->file.flush();
+}
+/*}}}*/
+
+// Compressed traces/*{{{*/
+
+// Appends whole records to the file being built, see traceWriter.h
+void TraceWriter::Encode(const unsigned char *records, unsigned int length)
+{
+  for (const unsigned char *record = records; record < records + length; record += this->recordBytes)
+  {
+    // Leave room for the longest encoding, an index and an address
+    if (this->encoded.size() > TRACE_FILE_BYTES - 8)
+    {
+      this->WriteFile();
+    }
+
+    if (this->records == 0)
+    {
+      this->firstIndex = this->index;
+      this->lastFetch = 0;
+      this->lastData = 0;
+      this->inRun = false;
+    }
+
+    ++this->records;
+    unsigned char type = record[0];
+    unsigned short address = record[1] | (record[2] << 8);
+
+    if (this->recordBytes > 3)
+    {
+      unsigned int index = record[3] | (record[4] << 8) | (record[5] << 16) | (static_cast<unsigned int>(record[6]) << 24);
+      unsigned int last = type == FETCH ? index - 1 : index;
+
+      // Only happens where segments were dropped
+      if (last != this->index)
+      {
+        this->encoded.push_back(TAG_RUN);
+        this->encoded.push_back(last & 0xFF);
+        this->encoded.push_back((last >> 8) & 0xFF);
+        this->encoded.push_back((last >> 16) & 0xFF);
+        this->encoded.push_back(last >> 24);
+        this->inRun = false;
+      }
+
+      this->index = index;
+    }
+
+    if (type != FETCH)
+    {
+      this->EncodeAddress(type << 6, address, this->lastData);
+      this->inRun = false;
+    }
+
+    else if (address == static_cast<unsigned short>(this->lastFetch + 2))
+    {
+      if (this->inRun && (this->encoded.back() & 077) < MAX_RUN)
+      {
+        ++this->encoded.back();
+      }
+
+      else
+      {
+        this->encoded.push_back(TAG_RUN | 1);
+        this->inRun = true;
+      }
+
+      this->lastFetch = address;
+    }
+
+    else
+    {
+      this->EncodeAddress(FETCH << 6, address, this->lastFetch);
+      this->inRun = false;
+    }
+  }
+}
+
+// Zigzags the distance from last so small steps either way fit the tag
+void TraceWriter::EncodeAddress(unsigned char tag, unsigned short address, unsigned short &last)
+{
+  unsigned short delta = address - last;
+  unsigned short zigzag = (delta << 1) ^ ((delta & 0100000) ? 0177777 : 0);
+  last = address;
+
+  if (zigzag < ESCAPE)
+  {
+    this->encoded.push_back(tag | zigzag);
+  }
+
+  else
+  {
+    this->encoded.push_back(tag | ESCAPE);
+    this->encoded.push_back(address & 0xFF);
+    this->encoded.push_back(address >> 8);
+  }
+}
+
+// Compresses the records encoded so far into the next numbered file
+void TraceWriter::WriteFile()
+{
+  uLongf size = compressBound(this->encoded.size());
+  this->packed.resize(TRACE_FILE_HEADER_BYTES + size);
+
+  if (compress2(&this->packed[TRACE_FILE_HEADER_BYTES], &size, &this->encoded[0], this->encoded.size(), LEVEL) != Z_OK)
+  {
+    std::cout << "Error compressing the trace!" << std::endl;
+    size = 0;
+  }
+
+  unsigned int fields[3] = { this->records, this->firstIndex, static_cast<unsigned int>(this->encoded.size()) };
+  std::memset(&this->packed[0], 0, TRACE_FILE_HEADER_BYTES);
+  std::memcpy(&this->packed[0], TRACE_FILE_MAGIC, 5);
+  this->packed[6] = TRACE_VERSION;
+  this->packed[7] = this->recordBytes > 3 ? TRACE_INDEXED : 0;
+
+  for (int field = 0; field < 3; ++field)
+  {
+    for (int byte = 0; byte < 4; ++byte)
+    {
+      this->packed[8 + field * 4 + byte] = (fields[field] >> (byte * 8)) & 0xFF;
+    }
+  }
+
+  std::ostringstream path;
+  path << this->name << "-" << std::setfill('0') << std::setw(4) << this->files++ << ".z";
+  std::ofstream out(path.str().c_str(), std::ios::out | std::ios::binary);
+  out.write(reinterpret_cast<char *>(&this->packed[0]), TRACE_FILE_HEADER_BYTES + size);
+
+  if (!out)
+  {
+    std::cout << "Error writing trace file " << path.str() << "!" << std::endl;
+  }
+
+  this->encoded.clear();
+  this->records = 0;
+}
+/*}}}*/
@@ -0,0 +1,112 @@
+#ifndef TRACEWRITER_H
+#define TRACEWRITER_H
+
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * trace.bin starts with an 8-byte header, TRACE_MAGIC then the format
+ * version and flags.  Each record that follows is the Transaction type in
+ * one byte and the address in two, low byte first, then with TRACE_INDEXED
+ * the index of the instruction making the access in four more.
+ */
+#define TRACE_MAGIC "P11TR"
+#define TRACE_VERSION 1
+#define TRACE_INDEXED 01
+#define TRACE_HEADER_BYTES 8
+
+/*
+ * A compressed trace is split into trace-0000.z, trace-0001.z and so on,
+ * each of which decodes on its own.  A file starts with a 20-byte header:
+ * TRACE_FILE_MAGIC, the version and the flags, then the record count, the
+ * instruction index before the first record and the length of the encoded
+ * records, four bytes each, low byte first.  The encoded records follow as
+ * one zlib stream.
+ *
+ * Every encoded record starts with a byte holding its type in the top two
+ * bits and a value in the low six.  Reads, writes and fetches have the
+ * zigzagged difference from the last data or the last fetch address, or
+ * 077 and the address itself in two more bytes.  Type 3 is a run of that
+ * many fetches, each 2 past the last, or with a value of 0 the instruction
+ * index in four more bytes where it does not follow on.
+ */
+#define TRACE_FILE_MAGIC "P11TZ"
+#define TRACE_FILE_HEADER_BYTES 20
+#define TRACE_FILE_BYTES (1U << 22)     // Cap on the encoded records in a file
+
+// The ring is handed to the writer thread a segment at a time
+#define TRACE_SEGMENT_BYTES (1U << 16)
+#define TRACE_RING_BYTES (1U << 24)
+
+// What Submit() does when the writer thread has fallen a full ring behind
+enum TraceFullPolicy
+{
+  traceBlock,                   // Wait for the writer, nothing is lost
+  traceDrop                     // Throw the segment away and count it
+};
+
+/*
+ * Writes the trace to disk on its own thread.  The emulation thread fills
+ * a segment of the ring in place and hands it over with Submit(), which
+ * returns the next one to fill.  The two threads only share the produced
+ * and consumed segment counts, so neither ever takes a lock, and a stalled
+ * write only holds up the CPU once every segment of the ring is waiting.
+ *
+ * The writer thread starts with the first segment submitted, a run that
+ * never fills one writes it from Finish() instead.  Compressing moves the
+ * encoding and zlib onto the writer thread too.
+ */
+class TraceWriter
+{
+  public:
+    TraceWriter(const char *name);
+    ~TraceWriter();
+    void Configure(unsigned int ringBytes, TraceFullPolicy policy);
+    void SetCompressed(bool compressed) { this->compressed = compressed; };
+    void SetName(const std::string &name) { this->name = name; };
+    void Begin(bool indexed);
+    unsigned char *Segment() const
+    {
+      return ring + (produced.load(std::memory_order_relaxed) & (segments - 1)) * TRACE_SEGMENT_BYTES;
+    };
+    unsigned char *Submit(unsigned int length);
+    void Finish(unsigned int length);
+    unsigned long long Waits() const { return waits; };
+    unsigned long long DroppedBytes() const { return droppedBytes; };
+
+  private:
+    void Drain();
+    void Publish(unsigned int length);
+    void Encode(const unsigned char *records, unsigned int length);
+    void EncodeAddress(unsigned char tag, unsigned short address, unsigned short &last);
+    void WriteFile();
+    std::string name;           // Output files are named after it
+    bool compressed;
+    unsigned int recordBytes;
+    std::ofstream file;
+    unsigned char *ring;
+    unsigned int *lengths;      // Bytes filled in each segment
+    unsigned int segments;      // A power of two, at least two
+    TraceFullPolicy policy;
+    std::atomic<unsigned int> produced;         // Segments handed to the writer
+    std::atomic<unsigned int> consumed;         // Segments written out
+    std::atomic<bool> finished;
+    std::thread writer;
+    unsigned long long waits;   // Submits that had to wait for the writer
+    unsigned long long droppedBytes;
+
+    // The compressed file being built, touched only by the writer thread
+    std::vector<unsigned char> encoded;
+    std::vector<unsigned char> packed;
+    unsigned int files;
+    unsigned int records;
+    unsigned int firstIndex;
+    unsigned int index;         // Of the last fetch encoded
+    unsigned short lastFetch;
+    unsigned short lastData;
+    bool inRun;                 // The last byte encoded is a run of fetches
+};
+#endif // TRACEWRITER_H
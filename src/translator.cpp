@@ -0,0 +1,950 @@
+#include <cstring>
+#include "cpu.h"
+#include "translator.h"
+
+#if TRANSLATOR_HOST
+#include <sys/mman.h>
+#endif
+
+#define Zbit 04
+#define Nbit 010
+#define Cbit 01
+#define Vbit 02
+
+// Operand fields of the instruction word
+#define SRC(instruction) (((instruction) >> 6) & 077)
+#define DST(instruction) ((instruction) & 077)
+
+#define HOT_THRESHOLD 16        // Interpreted visits before translating
+#define COLD 0xFFFF             // Heat of a word that could not be translated
+#define MAX_BLOCK_BYTES (MAX_BLOCK * 4)
+#define ARENA_SIZE (1 << 20)
+
+// Host registers
+enum
+{
+  EAX, ECX, EDX, EBX, ESP, EBP, ESI, EDI,
+  R8D, R9D, R10D, R11D, R12D, R13D, R14D, R15D
+};
+
+// Host condition codes
+#define CC_B 2
+#define CC_AE 3
+#define CC_E 4
+#define CC_NE 5
+#define ALWAYS -1
+
+// Opcodes and /digit extensions used by the encoder
+#define OP_ADD 0x01
+#define OP_OR 0x09
+#define OP_AND 0x21
+#define OP_SUB 0x29
+#define OP_XOR 0x31
+#define OP_TEST 0x85
+#define OP_MOV 0x89
+#define DIGIT_ADD 0
+#define DIGIT_OR 1
+#define DIGIT_AND 4
+#define DIGIT_SUB 5
+#define DIGIT_XOR 6
+#define DIGIT_CMP 7
+#define DIGIT_NOT 2
+#define DIGIT_NEG 3
+#define DIGIT_SHL 4
+#define DIGIT_SHR 5
+
+/*
+ * Register assignment inside a block.  Guest R0-R5 and SP sit in the
+ * callee saved registers plus R8, the PS in R9, RDI holds the RAM base and
+ * RSI the TranslatorState.  EAX, ECX, EDX, R10 and R11 are scratch.  The
+ * guest registers are loaded from and stored back to state->registers.
+ */
+static const int guest[7] = { EBX, EBP, R12D, R13D, R14D, R15D, R8D };
+#define PSW R9D
+#define RAM_BASE EDI
+
+Translator::Translator(Memory *memory, const Opcode *dispatchTable, const unsigned int *timingTable, unsigned short *registers)/*{{{*/
+{
+  this->memory = memory;
+  this->dispatchTable = dispatchTable;
+  this->timingTable = timingTable;
+  this->state.registers = registers;
+  this->blocks = new BlockEntry[IO_PAGE / 2]();
+  this->heat = new unsigned short[IO_PAGE / 2]();
+  this->arena = NULL;
+  this->arenaUsed = 0;
+  this->blocksTranslated = 0;
+  this->translatedInstructions = 0;
+
+#if TRANSLATOR_HOST
+  void *buffer = mmap(NULL, ARENA_SIZE, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (buffer != MAP_FAILED)
+  {
+    this->arena = static_cast<unsigned char *>(buffer);
+  }
+#endif
+}
+/*}}}*/
+
+Translator::~Translator()/*{{{*/
+{
+#if TRANSLATOR_HOST
+  if (this->arena)
+  {
+    munmap(this->arena, ARENA_SIZE);
+  }
+#endif
+  delete [] this->blocks;
+  delete [] this->heat;
+}
+/*}}}*/
+
+/*
+ * Runs the block translated for address, translating it first if the word
+ * has just become hot.  Returns the number of instructions retired, 0 when
+ * the caller has to interpret the instruction at address itself.  Their
+ * cycles are left in ExecutedCycles().
+ */
+unsigned long long Translator::Execute(unsigned short address, unsigned long long budget)/*{{{*/
+{
+  if (!this->arena || (address & 01) || address >= IO_PAGE)
+  {
+    return 0;
+  }
+
+  BlockEntry &block = this->blocks[address >> 1];
+
+  if (!block.entry)
+  {
+    unsigned short &visits = this->heat[address >> 1];
+
+    if (visits == COLD || ++visits < HOT_THRESHOLD)
+    {
+      return 0;
+    }
+
+    if (!this->Translate(address))
+    {
+      visits = COLD;
+      return 0;
+    }
+  }
+
+  this->state.executed = 0;
+  this->state.budget = budget;
+  this->state.cycles = 0;
+  block.entry(this->memory->RAM, &this->state);
+  this->translatedInstructions += this->state.executed;
+  return this->state.executed;
+}
+/*}}}*/
+
+// Drop every block that covers the word at address
+void Translator::Invalidate(unsigned short address)/*{{{*/
+{
+  if (address >= IO_PAGE)
+  {
+    return;
+  }
+
+  this->heat[address >> 1] = 0;
+
+  unsigned int first = address > MAX_BLOCK_BYTES ? address - MAX_BLOCK_BYTES : 0;
+  for (unsigned int start = first & ~01; start <= address; start += 2)
+  {
+    BlockEntry &block = this->blocks[start >> 1];
+
+    if (block.entry && block.start <= address && address < block.end)
+    {
+      block.entry = NULL;
+      this->heat[start >> 1] = 0;
+    }
+  }
+}
+/*}}}*/
+
+void Translator::InvalidateAll()/*{{{*/
+{
+  for (unsigned int i = 0; i < IO_PAGE / 2; ++i)
+  {
+    this->blocks[i].entry = NULL;
+    this->heat[i] = 0;
+  }
+
+  this->arenaUsed = 0;
+}
+/*}}}*/
+
+// Block translation/*{{{*/
+
+/*
+ * Compiles the block starting at address into the arena.  Layout is the
+ * prologue, one run of host code per guest instruction, the out of line
+ * side exits and finally the epilogue they all jump to with the resume
+ * address in EAX, the number of instructions retired in ECX and their
+ * cycles in EDX.
+ */
+bool Translator::Translate(unsigned short address)
+{
+#if TRANSLATOR_HOST
+  this->code.clear();
+  this->exits.clear();
+  this->returns.clear();
+  this->blockCycles.assign(1, 0);
+  this->blockStart = address;
+
+  // Prologue: save the callee saved registers and load the guest state
+  this->Push(EBX);
+  this->Push(EBP);
+  this->Push(R12D);
+  this->Push(R13D);
+  this->Push(R14D);
+  this->Push(R15D);
+  this->Byte(0x48);             // mov rdx, [rsi + 16]
+  this->Byte(0x8B);
+  this->Byte(0x56);
+  this->Byte(0x10);
+  for (int i = 0; i < 7; ++i)
+  {
+    this->LoadWord(guest[i], EDX, 2 * i);
+  }
+  this->LoadWord(PSW, EDX, 2 * 8);
+  this->blockBody = this->code.size();
+
+  unsigned short pc = address;
+  int count = 0;
+  bool ended = false;
+
+  while (!ended && count < MAX_BLOCK && pc < IO_PAGE - 4)
+  {
+    unsigned short instruction = this->memory->ReadAddress(pc);
+    this->blockCycles.push_back(this->blockCycles.back() + this->timingTable[instruction]);
+    int length = this->TranslateInstruction(pc, instruction, count, ended);
+
+    if (length == 0)
+    {
+      this->blockCycles.pop_back();
+      break;
+    }
+
+    pc += length;
+    ++count;
+  }
+
+  if (count == 0)
+  {
+    return false;
+  }
+
+  // Fell off the end of the block
+  if (!ended)
+  {
+    this->EmitExit(pc, count);
+  }
+
+  for (std::vector<Exit>::iterator it = this->exits.begin(); it != this->exits.end(); ++it)
+  {
+    this->Patch(it->patch, this->code.size());
+    this->EmitExit(it->address, it->count);
+  }
+
+  // Epilogue: account for the instructions, store the guest state, return
+  for (std::vector<size_t>::iterator it = this->returns.begin(); it != this->returns.end(); ++it)
+  {
+    this->Patch(*it, this->code.size());
+  }
+  this->Byte(0x48);             // add [rsi], rcx
+  this->Byte(0x01);
+  this->Byte(0x0E);
+  this->Byte(0x48);             // add [rsi + 24], rdx
+  this->Byte(0x01);
+  this->Byte(0x56);
+  this->Byte(0x18);
+  this->Byte(0x48);             // mov rdx, [rsi + 16]
+  this->Byte(0x8B);
+  this->Byte(0x56);
+  this->Byte(0x10);
+  for (int i = 0; i < 7; ++i)
+  {
+    this->StoreWord(EDX, 2 * i, guest[i]);
+  }
+  this->StoreWord(EDX, 2 * 8, PSW);
+  this->StoreWord(EDX, 2 * 7, EAX);
+  this->Pop(R15D);
+  this->Pop(R14D);
+  this->Pop(R13D);
+  this->Pop(R12D);
+  this->Pop(EBP);
+  this->Pop(EBX);
+  this->Byte(0xC3);             // ret
+
+  if (this->code.size() > ARENA_SIZE - this->arenaUsed)
+  {
+    this->InvalidateAll();
+  }
+
+  // Keep the arena W^X, it is only writable while a block is copied in
+  unsigned char *entry = this->arena + this->arenaUsed;
+  mprotect(this->arena, ARENA_SIZE, PROT_READ | PROT_WRITE);
+  memcpy(entry, &this->code[0], this->code.size());
+  mprotect(this->arena, ARENA_SIZE, PROT_READ | PROT_EXEC);
+  this->arenaUsed += (this->code.size() + 15) & ~static_cast<size_t>(15);
+
+  BlockEntry &block = this->blocks[address >> 1];
+  memcpy(&block.entry, &entry, sizeof(entry));
+  block.start = address;
+  block.end = pc;
+  ++this->blocksTranslated;
+
+  // Stores to any of these words now invalidate the block
+  for (unsigned short word = address; word != pc; word += 2)
+  {
+    this->memory->MarkCode(word);
+  }
+
+  return true;
+#else
+  (void)address;
+  return false;
+#endif
+}
+
+/*
+ * Emits host code for one guest instruction and returns its length in
+ * bytes, or 0 if it is not one the translator handles.  The semantics,
+ * including the condition codes, follow the interpreter's handlers exactly.
+ */
+int Translator::TranslateInstruction(unsigned short address, unsigned short instruction, int count, bool &ended)
+{
+  unsigned char src = SRC(instruction);
+  unsigned char dst = DST(instruction);
+  Opcode opcode = this->dispatchTable[instruction];
+
+  this->exitAddress = address;
+  this->exitCount = count;
+
+  switch (opcode)
+  {
+    // Double operand word operations/*{{{*/
+    case Opcode::MOV: case Opcode::CMP: case Opcode::BIT: case Opcode::BIC:
+    case Opcode::BIS: case Opcode::ADD: case Opcode::SUB:
+      {
+        if (!this->Supported(src, true) || !this->Supported(dst, false))
+        {
+          return 0;
+        }
+
+        bool store = opcode != Opcode::CMP && opcode != Opcode::BIT;
+        this->CheckOperand(src, false);
+        this->CheckOperand(dst, store);
+        this->LoadOperand(src, this->memory->ReadAddress(address + 2), ECX);
+        if (opcode != Opcode::MOV)
+        {
+          this->LoadOperand(dst, 0, EDX);
+        }
+
+        // Source in ECX, destination in EDX, result in EAX
+        switch (opcode)
+        {
+          case Opcode::MOV:
+            this->RegReg(OP_MOV, EAX, ECX);
+            this->SetFlags(Nbit | Zbit | Vbit, true, -1);
+            break;
+
+          case Opcode::CMP:
+            this->Unary(DIGIT_NEG, EDX);
+            this->RegImm(DIGIT_AND, EDX, 0xFFFF);
+            this->RegReg(OP_MOV, EAX, ECX);
+            this->RegReg(OP_ADD, EAX, EDX);
+            this->RegReg(OP_MOV, R10D, EAX);      // C = !carry out
+            this->Shift(DIGIT_SHR, R10D, 16);
+            this->RegImm(DIGIT_XOR, R10D, Cbit);
+            this->RegReg(OP_XOR, ECX, EDX);       // V = ~(src ^ dst) & (dst ^ result)
+            this->Unary(DIGIT_NOT, ECX);
+            this->RegReg(OP_XOR, EDX, EAX);
+            this->RegReg(OP_AND, ECX, EDX);
+            this->Shift(DIGIT_SHR, ECX, 14);
+            this->RegImm(DIGIT_AND, ECX, Vbit);
+            this->RegReg(OP_OR, ECX, R10D);
+            this->RegImm(DIGIT_AND, EAX, 0xFFFF);
+            this->SetFlags(Nbit | Zbit | Vbit | Cbit, true, ECX);
+            break;
+
+          case Opcode::BIT:
+            this->RegReg(OP_MOV, EAX, ECX);
+            this->RegReg(OP_AND, EAX, EDX);
+            this->SetFlags(Nbit | Zbit | Vbit, true, -1);
+            break;
+
+          case Opcode::BIC:
+            this->Unary(DIGIT_NOT, ECX);
+            this->RegReg(OP_AND, ECX, EDX);
+            this->RegReg(OP_MOV, EAX, ECX);
+            this->SetFlags(Nbit | Zbit | Vbit, true, -1);
+            break;
+
+          case Opcode::BIS:
+            this->RegReg(OP_MOV, EAX, ECX);
+            this->RegReg(OP_OR, EAX, EDX);
+            this->SetFlags(Nbit | Zbit | Vbit, true, -1);
+            break;
+
+          case Opcode::ADD:
+            this->RegReg(OP_MOV, EAX, ECX);
+            this->RegReg(OP_ADD, EAX, EDX);
+            this->RegReg(OP_XOR, ECX, EDX);       // V = ~(src ^ dst) & (dst ^ result)
+            this->Unary(DIGIT_NOT, ECX);
+            this->RegReg(OP_XOR, EDX, EAX);
+            this->RegReg(OP_AND, ECX, EDX);
+            this->Shift(DIGIT_SHR, ECX, 14);
+            this->RegImm(DIGIT_AND, ECX, Vbit);
+            this->RegReg(OP_MOV, EDX, EAX);       // C = carry out
+            this->Shift(DIGIT_SHR, EDX, 16);
+            this->RegReg(OP_OR, ECX, EDX);
+            this->RegImm(DIGIT_AND, EAX, 0xFFFF);
+            this->SetFlags(Nbit | Zbit | Vbit | Cbit, true, ECX);
+            break;
+
+          case Opcode::SUB:
+            this->RegReg(OP_XOR, R10D, R10D);
+            this->RegReg(OP_MOV, EAX, EDX);
+            this->RegReg(OP_SUB, EAX, ECX);
+            this->SetCC(CC_AE, R10D);             // C = no borrow
+            this->RegReg(OP_XOR, EDX, ECX);       // V = (src ^ dst) & ~(src ^ result)
+            this->RegReg(OP_XOR, ECX, EAX);
+            this->Unary(DIGIT_NOT, ECX);
+            this->RegReg(OP_AND, ECX, EDX);
+            this->Shift(DIGIT_SHR, ECX, 14);
+            this->RegImm(DIGIT_AND, ECX, Vbit);
+            this->RegReg(OP_OR, ECX, R10D);
+            this->RegImm(DIGIT_AND, EAX, 0xFFFF);
+            this->SetFlags(Nbit | Zbit | Vbit | Cbit, true, ECX);
+            break;
+
+          default:
+            break;
+        }
+
+        if (store)
+        {
+          this->StoreResult(dst);
+        }
+
+        return src == 027 ? 4 : 2;
+      }/*}}}*/
+
+    // Single operand word operations/*{{{*/
+    case Opcode::CLR: case Opcode::COM: case Opcode::INC:
+    case Opcode::DEC: case Opcode::NEG: case Opcode::TST:
+      {
+        if (!this->Supported(dst, false))
+        {
+          return 0;
+        }
+
+        this->CheckOperand(dst, opcode != Opcode::TST);
+        if (opcode != Opcode::CLR)
+        {
+          this->LoadOperand(dst, 0, EDX);
+        }
+
+        // Destination in EDX, result in EAX
+        switch (opcode)
+        {
+          case Opcode::CLR:
+            this->RegReg(OP_XOR, EAX, EAX);
+            this->StoreResult(dst);
+            this->RegImm(DIGIT_AND, PSW, ~(Nbit | Zbit | Vbit | Cbit));
+            this->RegImm(DIGIT_OR, PSW, Zbit);
+            break;
+
+          case Opcode::COM:
+            this->RegReg(OP_MOV, EAX, EDX);
+            this->Unary(DIGIT_NOT, EAX);
+            this->RegImm(DIGIT_AND, EAX, 0xFFFF);
+            this->StoreResult(dst);
+            this->MovImm(ECX, Cbit);
+            this->SetFlags(Nbit | Zbit | Vbit | Cbit, true, ECX);
+            break;
+
+          case Opcode::INC: case Opcode::DEC:
+            this->RegReg(OP_XOR, ECX, ECX);       // V = dst was the largest positive
+            this->RegImm(DIGIT_CMP, EDX, opcode == Opcode::INC ? 077777 : 0100000);
+            this->SetCC(CC_E, ECX);
+            this->Shift(DIGIT_SHL, ECX, 1);
+            this->RegReg(OP_MOV, EAX, EDX);
+            this->RegImm(opcode == Opcode::INC ? DIGIT_ADD : DIGIT_SUB, EAX, 1);
+            this->RegImm(DIGIT_AND, EAX, 0xFFFF);
+            this->StoreResult(dst);
+            this->SetFlags(Nbit | Zbit | Vbit, true, ECX);
+            break;
+
+          case Opcode::NEG:
+            this->RegReg(OP_MOV, EAX, EDX);
+            this->Unary(DIGIT_NEG, EAX);
+            this->RegImm(DIGIT_AND, EAX, 0xFFFF);
+            this->StoreResult(dst);
+            this->RegReg(OP_XOR, ECX, ECX);       // C = result is not zero
+            this->RegReg(OP_TEST, EAX, EAX);
+            this->SetCC(CC_NE, ECX);
+            this->RegReg(OP_XOR, EDX, EDX);       // V = result is 0100000
+            this->RegImm(DIGIT_CMP, EAX, 0100000);
+            this->SetCC(CC_E, EDX);
+            this->Shift(DIGIT_SHL, EDX, 1);
+            this->RegReg(OP_OR, ECX, EDX);
+            this->SetFlags(Nbit | Zbit | Vbit | Cbit, true, ECX);
+            break;
+
+          case Opcode::TST:
+            this->RegReg(OP_MOV, EAX, EDX);
+            this->Unary(DIGIT_NEG, EAX);
+            this->RegImm(DIGIT_AND, EAX, 0xFFFF);
+            this->SetFlags(Nbit | Zbit | Vbit | Cbit, true, -1);
+            break;
+
+          default:
+            break;
+        }
+
+        return 2;
+      }/*}}}*/
+
+    // Condition code operations/*{{{*/
+    case Opcode::CLC: this->RegImm(DIGIT_AND, PSW, ~Cbit); return 2;
+    case Opcode::CLV: this->RegImm(DIGIT_AND, PSW, ~Vbit); return 2;
+    case Opcode::CLZ: this->RegImm(DIGIT_AND, PSW, ~Zbit); return 2;
+    case Opcode::CLN: this->RegImm(DIGIT_AND, PSW, ~Nbit); return 2;
+    case Opcode::SEC: this->RegImm(DIGIT_OR, PSW, Cbit); return 2;
+    case Opcode::SEV: this->RegImm(DIGIT_OR, PSW, Vbit); return 2;
+    case Opcode::SEZ: this->RegImm(DIGIT_OR, PSW, Zbit); return 2;
+    case Opcode::SEN: this->RegImm(DIGIT_OR, PSW, Nbit); return 2;
+    /*}}}*/
+
+    // Branches end the block/*{{{*/
+    case Opcode::BR: case Opcode::BNE: case Opcode::BEQ: case Opcode::BGE:
+    case Opcode::BLT: case Opcode::BGT: case Opcode::BLE: case Opcode::BPL:
+    case Opcode::BMI: case Opcode::BHI: case Opcode::BLOS: case Opcode::BVC:
+    case Opcode::BVS: case Opcode::BCC: case Opcode::BCS:
+      {
+        short offset = static_cast<signed char>(instruction & 0x00FF);
+        unsigned short next = address + 02;
+        unsigned short target = next + offset * 2;
+        int taken = ALWAYS;
+
+        switch (opcode)
+        {
+          case Opcode::BNE: this->TestImm(PSW, Zbit); taken = CC_E; break;
+          case Opcode::BEQ: this->TestImm(PSW, Zbit); taken = CC_NE; break;
+          case Opcode::BPL: this->TestImm(PSW, Nbit); taken = CC_E; break;
+          case Opcode::BMI: this->TestImm(PSW, Nbit); taken = CC_NE; break;
+          case Opcode::BHI: this->TestImm(PSW, Zbit | Cbit); taken = CC_E; break;
+          case Opcode::BLOS: this->TestImm(PSW, Zbit | Cbit); taken = CC_NE; break;
+          case Opcode::BVC: this->TestImm(PSW, Vbit); taken = CC_E; break;
+          case Opcode::BVS: this->TestImm(PSW, Vbit); taken = CC_NE; break;
+          case Opcode::BCC: this->TestImm(PSW, Cbit); taken = CC_E; break;
+          case Opcode::BCS: this->TestImm(PSW, Cbit); taken = CC_NE; break;
+
+          case Opcode::BGE: case Opcode::BLT:
+          case Opcode::BGT: case Opcode::BLE:
+            this->RegReg(OP_MOV, EAX, PSW);       // N ^ V into bit 1
+            this->Shift(DIGIT_SHR, EAX, 2);
+            this->RegReg(OP_XOR, EAX, PSW);
+            if (opcode == Opcode::BGT || opcode == Opcode::BLE)
+            {
+              this->RegReg(OP_MOV, ECX, PSW);     // Z | (N ^ V) into bit 1
+              this->Shift(DIGIT_SHR, ECX, 1);
+              this->RegReg(OP_OR, EAX, ECX);
+            }
+            this->TestImm(EAX, Vbit);
+            taken = (opcode == Opcode::BGE || opcode == Opcode::BGT) ? CC_E : CC_NE;
+            break;
+
+          default:
+            break;
+        }
+
+        if (taken != ALWAYS)
+        {
+          size_t jump = this->Jump(taken);
+          this->EmitExit(next, count + 1);
+          this->Patch(jump, this->code.size());
+        }
+
+        if (target == this->blockStart)
+        {
+          this->BackEdge(count + 1);
+        }
+
+        else
+        {
+          this->EmitExit(target, count + 1);
+        }
+
+        ended = true;
+        return 2;
+      }/*}}}*/
+
+    default:
+      return 0;
+  }
+}
+
+// Register and register deferred operands, plus immediate sources
+bool Translator::Supported(unsigned char spec, bool immediate)
+{
+  if (immediate && spec == 027)
+  {
+    return true;
+  }
+
+  return (spec >> 3) <= 1 && (spec & 07) != 07;
+}
+
+void Translator::LoadOperand(unsigned char spec, unsigned short immediate, int host)
+{
+  if (spec == 027)
+  {
+    this->MovImm(host, immediate);
+  }
+
+  else if ((spec >> 3) == 0)
+  {
+    this->RegReg(OP_MOV, host, guest[spec & 07]);
+  }
+
+  else
+  {
+    this->LoadWordIndexed(host, guest[spec & 07]);
+  }
+}
+
+/*
+ * Leaves the block before the instruction if a deferred operand is odd or
+ * in the I/O page, either of which the interpreter turns into a trap, or if
+ * a store would overwrite code.  Clobbers EAX, ECX and R10.
+ */
+void Translator::CheckOperand(unsigned char spec, bool store)
+{
+  if ((spec >> 3) != 1)
+  {
+    return;
+  }
+
+  int reg = guest[spec & 07];
+  this->RegImm(DIGIT_CMP, reg, IO_PAGE - 1);
+  this->SideExit(CC_AE);
+  this->TestImm(reg, 01);
+  this->SideExit(CC_NE);
+
+  if (store)
+  {
+    this->Byte(0x49);           // mov r10, codeMap
+    this->Byte(0xB8 + (R10D & 07));
+    this->Qword(reinterpret_cast<unsigned long long>(this->memory->codeMap));
+    this->RegReg(OP_MOV, EAX, reg);
+    this->Shift(DIGIT_SHR, EAX, 4);
+    this->LoadByteIndexed(EAX, R10D, EAX);
+    this->RegReg(OP_MOV, ECX, reg);
+    this->Shift(DIGIT_SHR, ECX, 1);
+    this->RegImm(DIGIT_AND, ECX, 07);
+    this->BitTest(EAX, ECX);
+    this->SideExit(CC_B);
+  }
+}
+
+// Stores EAX to the operand, marking its RAM page dirty.  Clobbers R10 and R11.
+void Translator::StoreResult(unsigned char spec)
+{
+  if ((spec >> 3) == 0)
+  {
+    this->RegReg(OP_MOV, guest[spec & 07], EAX);
+  }
+
+  else
+  {
+    this->StoreWordIndexed(guest[spec & 07], EAX);
+
+    this->Byte(0x49);           // mov r10, dirtyMap
+    this->Byte(0xB8 + (R10D & 07));
+    this->Qword(reinterpret_cast<unsigned long long>(this->memory->dirtyMap));
+    this->RegReg(OP_MOV, R11D, guest[spec & 07]);
+    this->Shift(DIGIT_SHR, R11D, DIRTY_PAGE_SHIFT);
+    this->StoreByteIndexed(R10D, R11D, 1);
+  }
+}
+
+/*
+ * Replaces the PS bits in mask.  N and Z come from the result in EAX when
+ * zeroNegative is set, any other bits from the extra register.
+ */
+void Translator::SetFlags(unsigned char mask, bool zeroNegative, int extra)
+{
+  this->RegReg(OP_XOR, R11D, R11D);
+
+  if (zeroNegative)
+  {
+    this->RegReg(OP_TEST, EAX, EAX);
+    this->SetCC(CC_E, R11D);
+    this->Shift(DIGIT_SHL, R11D, 2);
+    this->RegReg(OP_MOV, R10D, EAX);
+    this->Shift(DIGIT_SHR, R10D, 12);
+    this->RegImm(DIGIT_AND, R10D, Nbit);
+    this->RegReg(OP_OR, R11D, R10D);
+  }
+
+  if (extra >= 0)
+  {
+    this->RegReg(OP_OR, R11D, extra);
+  }
+
+  this->RegImm(DIGIT_AND, PSW, ~static_cast<unsigned int>(mask));
+  this->RegReg(OP_OR, PSW, R11D);
+}
+
+// Leave the block, resuming at address with count instructions retired
+void Translator::EmitExit(unsigned short address, unsigned short count)
+{
+  this->MovImm(EAX, address);
+  this->MovImm(ECX, count);
+  this->MovImm(EDX, this->blockCycles[count]);
+  this->returns.push_back(this->Jump(ALWAYS));
+}
+
+// Leave the block before the current instruction if condition holds
+void Translator::SideExit(int condition)
+{
+  Exit exit;
+  exit.patch = this->Jump(condition);
+  exit.address = this->exitAddress;
+  exit.count = this->exitCount;
+  this->exits.push_back(exit);
+}
+
+/*
+ * A branch back to the top of the block stays in host code until the
+ * budget runs out, so a tight loop runs without ever returning.
+ */
+void Translator::BackEdge(unsigned short count)
+{
+  this->Byte(0x48);             // add qword [rsi], count
+  this->Byte(0x81);
+  this->Byte(0x06);
+  this->Dword(count);
+  this->Byte(0x48);             // add qword [rsi + 24], cycles
+  this->Byte(0x81);
+  this->Byte(0x46);
+  this->Byte(0x18);
+  this->Dword(this->blockCycles[count]);
+  this->Byte(0x48);             // mov rax, [rsi]
+  this->Byte(0x8B);
+  this->Byte(0x06);
+  this->Byte(0x48);             // cmp rax, [rsi + 8]
+  this->Byte(0x3B);
+  this->Byte(0x46);
+  this->Byte(0x08);
+  size_t out = this->Jump(CC_AE);
+  this->Patch(this->Jump(ALWAYS), this->blockBody);
+  this->Patch(out, this->code.size());
+  this->EmitExit(this->blockStart, 0);
+}
+/*}}}*/
+
+// x86-64 encoder/*{{{*/
+void Translator::Byte(unsigned char value)
+{
+  this->code.push_back(value);
+}
+
+void Translator::Dword(unsigned int value)
+{
+  for (int i = 0; i < 4; ++i)
+  {
+    this->Byte(value >> (8 * i));
+  }
+}
+
+void Translator::Qword(unsigned long long value)
+{
+  for (int i = 0; i < 8; ++i)
+  {
+    this->Byte(value >> (8 * i));
+  }
+}
+
+// REX prefix, only emitted when one of the registers needs it
+void Translator::Rex(bool wide, int reg, int index, int base, bool byteRegister)
+{
+  unsigned char rex = 0x40 | (wide << 3) | ((reg & 010) >> 1) | ((index & 010) >> 2) | ((base & 010) >> 3);
+
+  if (rex != 0x40 || byteRegister)
+  {
+    this->Byte(rex);
+  }
+}
+
+// op r/m32, r32 between two registers
+void Translator::RegReg(unsigned char op, int dst, int src)
+{
+  this->Rex(false, src, 0, dst);
+  this->Byte(op);
+  this->Byte(0xC0 | ((src & 07) << 3) | (dst & 07));
+}
+
+void Translator::RegImm(int digit, int dst, unsigned int immediate)
+{
+  this->Rex(false, 0, 0, dst);
+  this->Byte(0x81);
+  this->Byte(0xC0 | (digit << 3) | (dst & 07));
+  this->Dword(immediate);
+}
+
+void Translator::TestImm(int dst, unsigned int immediate)
+{
+  this->Rex(false, 0, 0, dst);
+  this->Byte(0xF7);
+  this->Byte(0xC0 | (dst & 07));
+  this->Dword(immediate);
+}
+
+void Translator::MovImm(int dst, unsigned int immediate)
+{
+  this->Rex(false, 0, 0, dst);
+  this->Byte(0xB8 + (dst & 07));
+  this->Dword(immediate);
+}
+
+void Translator::Shift(int digit, int dst, unsigned char count)
+{
+  this->Rex(false, 0, 0, dst);
+  this->Byte(0xC1);
+  this->Byte(0xC0 | (digit << 3) | (dst & 07));
+  this->Byte(count);
+}
+
+void Translator::Unary(int digit, int dst)
+{
+  this->Rex(false, 0, 0, dst);
+  this->Byte(0xF7);
+  this->Byte(0xC0 | (digit << 3) | (dst & 07));
+}
+
+// setcc on the low byte of dst, which must already be zero
+void Translator::SetCC(int condition, int dst)
+{
+  this->Rex(false, 0, 0, dst, dst >= ESP);
+  this->Byte(0x0F);
+  this->Byte(0x90 + condition);
+  this->Byte(0xC0 | (dst & 07));
+}
+
+// movzx dst, word [base + displacement], base must not be RSP or R12
+void Translator::LoadWord(int dst, int base, unsigned int displacement)
+{
+  this->Rex(false, dst, 0, base);
+  this->Byte(0x0F);
+  this->Byte(0xB7);
+  this->Byte(0x80 | ((dst & 07) << 3) | (base & 07));
+  this->Dword(displacement);
+}
+
+// mov word [base + displacement], src
+void Translator::StoreWord(int base, unsigned int displacement, int src)
+{
+  this->Byte(0x66);
+  this->Rex(false, src, 0, base);
+  this->Byte(0x89);
+  this->Byte(0x80 | ((src & 07) << 3) | (base & 07));
+  this->Dword(displacement);
+}
+
+// movzx dst, word [rdi + index]
+void Translator::LoadWordIndexed(int dst, int index)
+{
+  this->Rex(false, dst, index, RAM_BASE);
+  this->Byte(0x0F);
+  this->Byte(0xB7);
+  this->Byte(((dst & 07) << 3) | 04);
+  this->Byte(((index & 07) << 3) | RAM_BASE);
+}
+
+// mov word [rdi + index], src
+void Translator::StoreWordIndexed(int index, int src)
+{
+  this->Byte(0x66);
+  this->Rex(false, src, index, RAM_BASE);
+  this->Byte(0x89);
+  this->Byte(((src & 07) << 3) | 04);
+  this->Byte(((index & 07) << 3) | RAM_BASE);
+}
+
+// movzx dst, byte [base + index]
+void Translator::LoadByteIndexed(int dst, int base, int index)
+{
+  this->Rex(false, dst, index, base);
+  this->Byte(0x0F);
+  this->Byte(0xB6);
+  this->Byte(((dst & 07) << 3) | 04);
+  this->Byte(((index & 07) << 3) | (base & 07));
+}
+
+// mov byte [base + index], value
+void Translator::StoreByteIndexed(int base, int index, unsigned char value)
+{
+  this->Rex(false, 0, index, base);
+  this->Byte(0xC6);
+  this->Byte(0x04);
+  this->Byte(((index & 07) << 3) | (base & 07));
+  this->Byte(value);
+}
+
+// bt base, offset
+void Translator::BitTest(int base, int offset)
+{
+  this->Rex(false, offset, 0, base);
+  this->Byte(0x0F);
+  this->Byte(0xA3);
+  this->Byte(0xC0 | ((offset & 07) << 3) | (base & 07));
+}
+
+void Translator::Push(int reg)
+{
+  this->Rex(false, 0, 0, reg);
+  this->Byte(0x50 + (reg & 07));
+}
+
+void Translator::Pop(int reg)
+{
+  this->Rex(false, 0, 0, reg);
+  this->Byte(0x58 + (reg & 07));
+}
+
+// jmp or jcc rel32, returns where the displacement goes for Patch()
+size_t Translator::Jump(int condition)
+{
+  if (condition == ALWAYS)
+  {
+    this->Byte(0xE9);
+  }
+
+  else
+  {
+    this->Byte(0x0F);
+    this->Byte(0x80 + condition);
+  }
+
+  size_t at = this->code.size();
+  this->Dword(0);
+  return at;
+}
+
+void Translator::Patch(size_t at, size_t target)
+{
+  unsigned int displacement = target - (at + 4);
+
+  for (int i = 0; i < 4; ++i)
+  {
+    this->code[at + i] = displacement >> (8 * i);
+  }
+}
+/*}}}*/
@@ -0,0 +1,129 @@
+#ifndef TRANSLATOR_H
+#define TRANSLATOR_H
+
+#include <vector>
+#include "memory.h"
+
+enum class Opcode : unsigned char;
+
+// Only x86-64 hosts get native code, everything else always interprets
+#if defined(__x86_64__) && defined(__linux__)
+#define TRANSLATOR_HOST 1
+#else
+#define TRANSLATOR_HOST 0
+#endif
+
+// Instructions per block, Execute() can run over its budget by one block less
+#define MAX_BLOCK 32
+
+// Bookkeeping shared with the generated code, offsets are baked into it
+struct TranslatorState
+{
+  unsigned long long executed;  // Instructions retired by the current call
+  unsigned long long budget;    // Loop back-edges give up control past this
+  unsigned short *registers;    // The CPU's register file
+  unsigned long long cycles;    // Estimated 11/20 cycles for the instructions retired
+};
+
+typedef void (*TranslatedBlock)(unsigned short *RAM, TranslatorState *state);
+
+// A straight line run of PDP-11 code compiled to host code
+struct BlockEntry
+{
+  TranslatedBlock entry;        // NULL when nothing is translated here
+  unsigned short start;         // First guest byte covered
+  unsigned short end;           // One past the last guest byte covered
+};
+
+/*
+ * Dynamic binary translator.  Counts how often the interpreter reaches each
+ * word address and, once one gets hot, compiles the basic block starting
+ * there into x86-64.  Guest R0-R5, SP and the PS live in host registers for
+ * the whole block and are written back to the CPU's register file on exit,
+ * so the interpreter always sees the same state it would have produced.
+ *
+ * Only the common register and register deferred word operations, the
+ * condition code operations and branches are translated.  A block ends at
+ * the first branch or at anything else, and the interpreter picks up from
+ * there.  Accesses to the I/O page or to an odd address and stores to a
+ * word that holds code leave the block before the instruction is executed.
+ *
+ * Translated code never calls TraceDump(), so it must only be entered
+ * while tracing is switched off.
+ */
+class Translator
+{
+  public:
+    Translator(Memory *memory, const Opcode *dispatchTable, const unsigned int *timingTable, unsigned short *registers);
+    ~Translator();
+    bool Available() const { return this->arena != NULL; };
+    unsigned long long Execute(unsigned short address, unsigned long long budget);
+    unsigned long long ExecutedCycles() const { return state.cycles; };
+    void Invalidate(unsigned short address);
+    void InvalidateAll();
+    unsigned long long BlocksTranslated() const { return blocksTranslated; };
+    unsigned long long TranslatedInstructions() const { return translatedInstructions; };
+
+  private:
+    struct Exit                 // Forward jump still waiting for its target
+    {
+      size_t patch;
+      unsigned short address;
+      unsigned short count;
+    };
+
+    bool Translate(unsigned short address);
+    int TranslateInstruction(unsigned short address, unsigned short instruction, int count, bool &ended);
+    bool Supported(unsigned char spec, bool immediate);
+    void LoadOperand(unsigned char spec, unsigned short immediate, int host);
+    void CheckOperand(unsigned char spec, bool store);
+    void StoreResult(unsigned char spec);
+    void SetFlags(unsigned char mask, bool zeroNegative, int extra);
+    void EmitExit(unsigned short address, unsigned short count);
+    void SideExit(int condition);
+    void BackEdge(unsigned short count);
+
+    // x86-64 encoder
+    void Byte(unsigned char value);
+    void Dword(unsigned int value);
+    void Qword(unsigned long long value);
+    void Rex(bool wide, int reg, int index, int base, bool byteRegister = false);
+    void RegReg(unsigned char op, int dst, int src);
+    void RegImm(int digit, int dst, unsigned int immediate);
+    void TestImm(int dst, unsigned int immediate);
+    void MovImm(int dst, unsigned int immediate);
+    void Shift(int digit, int dst, unsigned char count);
+    void Unary(int digit, int dst);
+    void SetCC(int condition, int dst);
+    void LoadWord(int dst, int base, unsigned int displacement);
+    void StoreWord(int base, unsigned int displacement, int src);
+    void LoadWordIndexed(int dst, int index);
+    void StoreWordIndexed(int index, int src);
+    void LoadByteIndexed(int dst, int base, int index);
+    void StoreByteIndexed(int base, int index, unsigned char value);
+    void BitTest(int base, int offset);
+    void Push(int reg);
+    void Pop(int reg);
+    size_t Jump(int condition);
+    void Patch(size_t at, size_t target);
+
+    Memory *memory;
+    const Opcode *dispatchTable;
+    const unsigned int *timingTable;
+    BlockEntry *blocks;         // Translated blocks by word address
+    unsigned short *heat;       // Interpreted visits by word address
+    unsigned char *arena;       // Executable code buffer
+    size_t arenaUsed;
+    std::vector<unsigned char> code;   // Block under construction
+    std::vector<Exit> exits;     // Side exits out of the block
+    std::vector<size_t> returns; // Jumps to the shared epilogue
+    std::vector<unsigned int> blockCycles;  // Cycles of the first n instructions
+    unsigned short blockStart;
+    size_t blockBody;           // Host offset of the first instruction
+    unsigned short exitAddress; // Where a side exit resumes interpretation
+    unsigned short exitCount;   // Instructions retired before a side exit
+    TranslatorState state;
+    unsigned long long blocksTranslated;
+    unsigned long long translatedInstructions;
+};
+#endif // TRANSLATOR_H